@@ -0,0 +1,430 @@
+/*
+    name: cpu_simulation.hpp
+
+    usecase:
+        a second engine for the same simulation as the Simulation class (simulation/simulation_class.hpp),
+        that runs on the cpu without sycl, so it builds with plain g++ or clang and no oneapi install
+
+        the populations are stored as structure of arrays, every node's population i is next to the ones of its neighbours along x,
+        so one step streams and collides simd_width nodes of a row at a time with the vector types of simd_float.hpp,
+        and the rows are split between the threads of a ThreadPool (thread_pool.hpp)
+
+        the collision is branch free, every node type's result is computed for the whole vector and the right one is selected per lane,
+        the rules are the same as node_collide, and the starting state is the same as the Simulation class
+
+        the public interface (next_frame, advance, vector_array, density_array, get_dimensions, get_node_count)
+        is the same as the Simulation class, with cpu_float4 and cpu_range3 standing in for sycl::float4 and sycl::range<3>
+*/
+#pragma once
+
+#include <iostream> // used for debugging via std out
+#include <atomic> // the host side macroscopic arrays are swapped atomically, same as the Simulation class
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <vector>
+#include <utility> // std::swap, used to swap the two population arrays
+#include <cmath> // std::sqrt, std::fabs
+#include <cstdlib> // rand, for the starting noise
+
+#include "simd_float.hpp" // the vector types the nodes are computed with
+#include "thread_pool.hpp" // the threads the rows are split between
+#include "../simulation/lattices.hpp" // the velocity sets the simulation can use
+#include "../simulation/initial_geometry.hpp" // the node types the simulation starts with
+
+// the macroscopic velocity of a node, laid out the same as sycl::float4
+struct cpu_float4
+{
+    float values[4];
+
+    cpu_float4(float x = 0.0f, float y = 0.0f, float z = 0.0f, float w = 0.0f) : values{x, y, z, w} {}
+
+    float x() const { return values[0]; }
+    float y() const { return values[1]; }
+    float z() const { return values[2]; }
+    float w() const { return values[3]; }
+};
+
+// the dimensions of the simulation, used the same as sycl::range<3>
+struct cpu_range3
+{
+    uint64_t values[3];
+
+    cpu_range3(uint64_t width, uint64_t height, uint64_t depth) : values{width, height, depth} {}
+
+    uint64_t get(int axis) const { return values[axis]; }
+    uint64_t size() const { return values[0] * values[1] * values[2]; }
+};
+
+template <typename lattice = D3Q27>
+class CpuSimulation
+{
+    private:
+        int width;  // simulation width in number of nodes
+        int height; // simulation height in number of nodes
+        int depth;  // simulation depth in number of nodes
+
+        uint64_t node_count;
+
+        // the number of discrete velocities per node, see lattices.hpp
+        static constexpr uint8_t possible_velocities_number = lattice::count;
+
+        // the adimentional speed of sound in the lattice, the same as the Simulation class
+        static constexpr float speed_of_sound = 1.0f / 1.73205080757f;
+
+        // the relaxation multiplier of the collision, see the Simulation class
+        float tau;
+
+        const float flow_vec_x = 0.0f;
+        const float flow_vec_y = 0.0f;
+        const float flow_vec_z = 1.0f;
+
+        // the boundary type of each node, the same values as the changeable_buffer of the Simulation class
+        std::vector<uint8_t> node_types;
+
+        // the populations, as structure of arrays
+        // index = i * node_count + node_index
+        // node_index = node.x + node.y * width + node.z * width * height
+        std::vector<float> populations_1; // the values to read from
+        std::vector<float> populations_2; // the values to write to
+
+        // host side density arrays
+        float * density_array_1;
+        float * density_array_2;
+
+        // host side velocity arrays
+        cpu_float4 * vectors1;
+        cpu_float4 * vectors2;
+
+        // which array is currently pointed to by the vector_array pointer
+        // false means vectors1 is pointed to by vector_array
+        // true means vectors2 is pointed to by vector_array
+        bool which_vectors_array = false;
+
+        ThreadPool * threads;
+
+    public:
+        /////////////////////////////////////////////////////////////////////////
+        // stable host instances of the macroscopic velocity and density array //
+        /////////////////////////////////////////////////////////////////////////
+
+        // a value containing a pointer to the current macroscopic velocity array, with the density of each node in w
+        std::atomic<cpu_float4*> vector_array;
+        // a value containing a pointer to the current macroscopic density array
+        std::atomic<float*> density_array;
+
+    // the same arguments as the Simulation class,
+    // thread_count: the number of threads to split each step between, every hardware thread by default
+    CpuSimulation(int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau, int thread_count = std::thread::hardware_concurrency())
+    {
+        this->width = width;
+        this->height = height;
+        this->depth = depth;
+        this->node_count = (uint64_t) width * height * depth;
+        this->tau = tau;
+
+        this->threads = new ThreadPool(thread_count);
+
+        std::cout << "running simulation on -> the cpu, " << this->threads->get_thread_count() << " threads, " << simd_width << " floats per simd register" << std::endl;
+
+        this->node_types.resize(this->node_count);
+        for (int z = 0; z < depth; z++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    this->node_types[x + y * width + z * width * height] = initial_node_type(x, y, z, width, height, depth, cyc_radius);
+                }
+            }
+        }
+
+        // the weights plus a bit of random noise, drawn in node order, the same as the Simulation class starts with
+        this->populations_1.resize(possible_velocities_number * this->node_count);
+        this->populations_2.resize(possible_velocities_number * this->node_count);
+
+        for (uint64_t i = 0; i < this->node_count * possible_velocities_number; i++)
+        {
+            uint64_t node_index = i / possible_velocities_number;
+            uint8_t velocity = i % possible_velocities_number;
+
+            this->populations_1[velocity * this->node_count + node_index] = lattice::velocities_weights[velocity] + (rand() % 100) / 1000.0f; // + 0.00, 0.01, 0.02, to 0.99f
+        }
+
+        this->density_array_1 = new float[this->node_count];
+        this->density_array_2 = new float[this->node_count];
+
+        this->vectors1 = new cpu_float4[this->node_count];
+        this->vectors2 = new cpu_float4[this->node_count];
+
+        // the starting macroscopic variables, the density of the populations and the velocity of the weights
+        float vec_x = 0.0f;
+        float vec_y = 0.0f;
+        float vec_z = 0.0f;
+        for (uint8_t i = 0; i < possible_velocities_number; i++)
+        {
+            vec_x += lattice::velocities_weights[i] * lattice::possible_velocities[i * 3];
+            vec_y += lattice::velocities_weights[i] * lattice::possible_velocities[i * 3 + 1];
+            vec_z += lattice::velocities_weights[i] * lattice::possible_velocities[i * 3 + 2];
+        }
+
+        for (uint64_t node_index = 0; node_index < this->node_count; node_index++)
+        {
+            float node_density = 0.0f;
+            for (uint8_t i = 0; i < possible_velocities_number; i++)
+            {
+                node_density += this->populations_1[i * this->node_count + node_index];
+            }
+
+            this->density_array_1[node_index] = node_density;
+            this->density_array_2[node_index] = node_density;
+
+            this->vectors1[node_index] = cpu_float4(vec_x, vec_y, vec_z, node_density);
+            this->vectors2[node_index] = cpu_float4(vec_x, vec_y, vec_z, node_density);
+        }
+
+        this->density_array.store(this->density_array_1);
+        this->vector_array.store(this->vectors1);
+    }
+
+    ~CpuSimulation()
+    {
+        delete this->threads;
+
+        delete[] this->density_array_1;
+        delete[] this->density_array_2;
+        delete[] this->vectors1;
+        delete[] this->vectors2;
+    }
+
+    /**
+     * calculate the next state of the simulation
+     */
+    void next_frame()
+    {
+        advance(1);
+    }
+
+    /**
+     * calculate the state of the simulation n_steps steps ahead, the same as calling next_frame n_steps times,
+     * the macroscopic variables are written straight to the host arrays that aren't public, which are made public after the last step
+     */
+    void advance(int n_steps)
+    {
+        if(n_steps <= 0)
+        {
+            return;
+        }
+
+        float * next_density_array = this->which_vectors_array ? this->density_array_1 : this->density_array_2;
+        cpu_float4 * next_vector_array = this->which_vectors_array ? this->vectors1 : this->vectors2;
+
+        for (int step = 0; step < n_steps; step++)
+        {
+            // one row of nodes along x per y and z
+            this->threads->parallel_for((uint64_t) this->height * this->depth, [&](uint64_t first_row, uint64_t end_row)
+            {
+                for (uint64_t row = first_row; row < end_row; row++)
+                {
+                    stream_and_collide_row(row % this->height, row / this->height, next_density_array, next_vector_array);
+                }
+            });
+
+            // the newly written populations become the ones to read from next step
+            std::swap(this->populations_1, this->populations_2);
+        }
+
+        this->density_array.store(next_density_array);
+        this->vector_array.store(next_vector_array);
+        this->which_vectors_array = !this->which_vectors_array;
+    }
+
+    // returns population i of the node at node_index
+    float read_population(uint64_t node_index, uint8_t i)
+    {
+        return this->populations_1[i * this->node_count + node_index];
+    }
+
+    // returns the boundary type of the node at node_index, the same values as the changeable_buffer of the Simulation class
+    uint8_t get_node_type(uint64_t node_index)
+    {
+        return this->node_types[node_index];
+    }
+
+    // returns a copy of the dimensions of this simulation
+    cpu_range3 get_dimensions()
+    {
+        return cpu_range3(this->width, this->height, this->depth);
+    }
+
+    // returns the number of nodes in this simulation
+    int get_node_count()
+    {
+        return this->node_count;
+    }
+
+    private:
+
+    /**
+     * streams and collides the row of nodes at y, z, pulling each population from the row it streams from,
+     * simd_width nodes at a time where none of them wrap around along x,
+     * the nodes at the ends of the row gather their populations one by one into a vector first
+     */
+    void stream_and_collide_row(int y, int z, float * next_density_array, cpu_float4 * next_vector_array)
+    {
+        // where the row each population streams from starts, wrapping around along y and z
+        uint64_t from_row[possible_velocities_number];
+        for (uint8_t i = 0; i < possible_velocities_number; i++)
+        {
+            int from_y = (y - lattice::possible_velocities[i * 3 + 1] + this->height) % this->height;
+            int from_z = (z - lattice::possible_velocities[i * 3 + 2] + this->depth) % this->depth;
+
+            from_row[i] = i * this->node_count + (uint64_t) from_y * this->width + (uint64_t) from_z * this->width * this->height;
+        }
+
+        uint64_t row = (uint64_t) y * this->width + (uint64_t) z * this->width * this->height;
+
+        simd_float populations[possible_velocities_number];
+        simd_float collided[possible_velocities_number];
+
+        int x = 0;
+        while(x < this->width)
+        {
+            // the x velocities are at most one node long, so the nodes from 1 to width - 2 never wrap around
+            bool interior = x > 0 && x + simd_width < this->width;
+            int lanes = interior ? simd_width : 1;
+
+            simd_int types;
+
+            if(interior)
+            {
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    populations[i] = simd_load(&this->populations_1[from_row[i] + x - lattice::possible_velocities[i * 3]]);
+                }
+
+                for (int lane = 0; lane < simd_width; lane++)
+                {
+                    types[lane] = this->node_types[row + x + lane];
+                }
+            }
+            else
+            {
+                // one node that wraps around, in every lane so the unused ones compute something valid
+                int from_x[possible_velocities_number];
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    from_x[i] = (x - lattice::possible_velocities[i * 3] + this->width) % this->width;
+                }
+
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    populations[i] = this->populations_1[from_row[i] + from_x[i]] + simd_float{};
+                }
+
+                types = this->node_types[row + x] + simd_int{};
+            }
+
+            simd_float node_density;
+            simd_float macro_velocity_x;
+            simd_float macro_velocity_y;
+            simd_float macro_velocity_z;
+
+            collide(types, populations, collided, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z);
+
+            if(interior)
+            {
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    simd_store(&this->populations_2[i * this->node_count + row + x], collided[i]);
+                }
+            }
+            else
+            {
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    this->populations_2[i * this->node_count + row + x] = collided[i][0];
+                }
+            }
+
+            for (int lane = 0; lane < lanes; lane++)
+            {
+                next_density_array[row + x + lane] = node_density[lane];
+                next_vector_array[row + x + lane] = cpu_float4(macro_velocity_x[lane], macro_velocity_y[lane], macro_velocity_z[lane], node_density[lane]);
+            }
+
+            x += lanes;
+        }
+    }
+
+    /**
+     * computes the macroscopic variables of simd_width nodes from their streamed populations,
+     * and collides them by the same rules as node_collide, without branching on the node type
+     */
+    void collide(simd_int types, const simd_float * populations, simd_float * collided,
+                 simd_float & node_density, simd_float & macro_velocity_x, simd_float & macro_velocity_y, simd_float & macro_velocity_z)
+    {
+        node_density = simd_float{};
+        macro_velocity_x = simd_float{};
+        macro_velocity_y = simd_float{};
+        macro_velocity_z = simd_float{};
+
+        for (uint8_t i = 0; i < possible_velocities_number; i++)
+        {
+            node_density += simd_abs(populations[i]); // absoulute value of density
+
+            macro_velocity_x += populations[i] * (float) lattice::possible_velocities[i * 3];
+            macro_velocity_y += populations[i] * (float) lattice::possible_velocities[i * 3 + 1];
+            macro_velocity_z += populations[i] * (float) lattice::possible_velocities[i * 3 + 2];
+        }
+
+        macro_velocity_x /= node_density;
+        macro_velocity_y /= node_density;
+        macro_velocity_z /= node_density;
+
+        // clamp the velocity to the speed of sound
+        simd_float macro_velocity_len_squared = macro_velocity_x * macro_velocity_x + macro_velocity_y * macro_velocity_y + macro_velocity_z * macro_velocity_z;
+        for (int lane = 0; lane < simd_width; lane++)
+        {
+            float macro_velocity_len = std::sqrt(macro_velocity_len_squared[lane]);
+            if(macro_velocity_len > speed_of_sound)
+            {
+                macro_velocity_x[lane] = (macro_velocity_x[lane] / macro_velocity_len) * speed_of_sound;
+                macro_velocity_y[lane] = (macro_velocity_y[lane] / macro_velocity_len) * speed_of_sound;
+                macro_velocity_z[lane] = (macro_velocity_z[lane] / macro_velocity_len) * speed_of_sound;
+            }
+        }
+
+        simd_float udotu = macro_velocity_x * macro_velocity_x + macro_velocity_y * macro_velocity_y + macro_velocity_z * macro_velocity_z;
+
+        simd_int is_fluid      = types == 0;
+        simd_int is_reflective = types == 1;
+        simd_int is_inflow     = types == 2;
+        simd_int is_sink       = types == 3;
+
+        for (uint8_t i = 0; i < possible_velocities_number; i++)
+        {
+            float weight = lattice::velocities_weights[i];
+
+            float velocity_i_x = lattice::possible_velocities[i * 3];
+            float velocity_i_y = lattice::possible_velocities[i * 3 + 1];
+            float velocity_i_z = lattice::possible_velocities[i * 3 + 2];
+
+            // the equlibrium density, see f_eq in simulation_class.hpp
+            simd_float vdotu = velocity_i_x * macro_velocity_x + velocity_i_y * macro_velocity_y + velocity_i_z * macro_velocity_z;
+            simd_float equlibrium_density = weight * node_density * (1.0f + (3.0f * vdotu) + ((9.0f * vdotu * vdotu) / 2.0f) - ((3.0f * udotu) / 2.0f));
+
+            // the in flow's equlibrium density, the same for every node
+            float flow_vdotu = velocity_i_x * flow_vec_x + velocity_i_y * flow_vec_y + velocity_i_z * flow_vec_z;
+            float flow_udotu = flow_vec_x * flow_vec_x + flow_vec_y * flow_vec_y + flow_vec_z * flow_vec_z;
+            float inflow_density = weight * (1.0f + (3.0f * flow_vdotu) + ((9.0f * flow_vdotu * flow_vdotu) / 2.0f) - ((3.0f * flow_udotu) / 2.0f));
+
+            simd_float fluid      = populations[i] - (this->tau * (populations[i] - equlibrium_density));
+            simd_float reflective = populations[lattice::relective_index_table[i]];
+
+            // unknown node types pass their populations through unchanged
+            collided[i] = simd_select(is_fluid, fluid,
+                          simd_select(is_reflective, reflective,
+                          simd_select(is_inflow, inflow_density + simd_float{},
+                          simd_select(is_sink, weight + simd_float{}, populations[i]))));
+        }
+    }
+};
@@ -0,0 +1,55 @@
+/*
+    name: simd_float.hpp
+
+    usecase:
+        the vector types the native cpu engine (cpu_simulation.hpp) computes simd_width nodes at a time with,
+        using the gcc / clang vector extensions, which both compilers turn into the widest simd instructions the target has
+        (avx-512 with -mavx512f, avx2 with -mavx2, sse / neon otherwise), without any intrinsics or a oneapi install
+
+        arithmetic and comparisons work lane by lane, and a scalar in an expression is used for every lane,
+        comparisons give a simd_int with every bit of a lane set where the comparison is true
+
+    see:
+        https://gcc.gnu.org/onlinedocs/gcc/Vector-Extensions.html
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+
+// the number of floats in one simd register of the target
+#if defined(__AVX512F__)
+constexpr int simd_width = 16;
+#elif defined(__AVX__)
+constexpr int simd_width = 8;
+#else
+constexpr int simd_width = 4;
+#endif
+
+typedef float simd_float __attribute__((vector_size(simd_width * sizeof(float))));
+typedef int32_t simd_int __attribute__((vector_size(simd_width * sizeof(int32_t))));
+
+// loads simd_width floats starting at values, values doesn't have to be aligned
+inline simd_float simd_load(const float * values)
+{
+    simd_float loaded;
+    __builtin_memcpy(&loaded, values, sizeof(loaded));
+    return loaded;
+}
+
+// stores simd_width floats starting at values, values doesn't have to be aligned
+inline void simd_store(float * values, simd_float stored)
+{
+    __builtin_memcpy(values, &stored, sizeof(stored));
+}
+
+// returns a where the lanes of mask are set, b everywhere else, mask has to come from a comparison
+inline simd_float simd_select(simd_int mask, simd_float a, simd_float b)
+{
+    return (simd_float) (((simd_int) a & mask) | ((simd_int) b & ~mask));
+}
+
+// the absolute value of every lane, by clearing the sign bits
+inline simd_float simd_abs(simd_float value)
+{
+    return (simd_float) ((simd_int) value & 0x7fffffff);
+}
@@ -0,0 +1,150 @@
+/*
+    name: thread_pool.hpp
+
+    usecase:
+        a fixed set of worker threads the native cpu engine (cpu_simulation.hpp) splits each step between,
+        started once so the steps don't pay for starting threads
+
+        parallel_for splits a range of work into one contiguous part per thread, the calling thread takes the first part,
+        and returns once every part is done
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional> // std::function, the work handed to the workers
+#include <algorithm> // std::max, std::min
+
+class ThreadPool
+{
+    private:
+        std::vector<std::thread> workers;
+
+        std::mutex lock;
+        // signals the workers that there is new work, or that they should stop
+        std::condition_variable work_ready;
+        // signals parallel_for that a worker finished its part
+        std::condition_variable work_done;
+
+        // the work of the current parallel_for, called with the begin and end of a part
+        std::function<void(uint64_t, uint64_t)> work;
+        uint64_t work_count = 0;
+
+        // counts the parallel_for calls, so a worker can tell new work from the work it already did
+        uint64_t generation = 0;
+        // the workers that haven't finished their part of the current work yet
+        int workers_busy = 0;
+
+        bool stopping = false;
+
+    public:
+
+    // thread_count: the number of threads running the work, including the one calling parallel_for
+    ThreadPool(int thread_count = std::thread::hardware_concurrency())
+    {
+        thread_count = std::max(thread_count, 1);
+
+        for (int worker = 1; worker < thread_count; worker++)
+        {
+            this->workers.push_back(std::thread([this, worker]()
+            {
+                run_worker(worker);
+            }));
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->stopping = true;
+        }
+
+        this->work_ready.notify_all();
+
+        for (std::thread & worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    // returns the number of threads running the work, including the one calling parallel_for
+    int get_thread_count()
+    {
+        return this->workers.size() + 1;
+    }
+
+    // calls work(begin, end) on every thread with its own contiguous part of 0 to count, returns once all of them are done
+    void parallel_for(uint64_t count, const std::function<void(uint64_t, uint64_t)> & work)
+    {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->work = work;
+            this->work_count = count;
+            this->workers_busy = this->workers.size();
+            ++this->generation;
+        }
+
+        this->work_ready.notify_all();
+
+        run_part(0, work, count);
+
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->work_done.wait(guard, [this]() { return this->workers_busy == 0; });
+    }
+
+    private:
+
+    // runs the part of thread thread out of get_thread_count()
+    void run_part(int thread, const std::function<void(uint64_t, uint64_t)> & work, uint64_t count)
+    {
+        uint64_t thread_count = get_thread_count();
+
+        uint64_t begin = count * thread / thread_count;
+        uint64_t end = count * (thread + 1) / thread_count;
+
+        if(begin < end)
+        {
+            work(begin, end);
+        }
+    }
+
+    void run_worker(int thread)
+    {
+        uint64_t done_generation = 0;
+
+        while(true)
+        {
+            std::function<void(uint64_t, uint64_t)> current_work;
+            uint64_t current_count;
+            {
+                std::unique_lock<std::mutex> guard(this->lock);
+                this->work_ready.wait(guard, [&]() { return this->stopping || this->generation != done_generation; });
+
+                if(this->stopping)
+                {
+                    return;
+                }
+
+                done_generation = this->generation;
+                current_work = this->work;
+                current_count = this->work_count;
+            }
+
+            run_part(thread, current_work, current_count);
+
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                --this->workers_busy;
+            }
+
+            this->work_done.notify_one();
+        }
+    }
+};
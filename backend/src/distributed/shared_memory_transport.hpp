@@ -0,0 +1,204 @@
+/*
+    name: shared_memory_transport.hpp
+
+    usecase:
+        a Transport (transport.hpp) between processes on the same machine, through one POSIX shared memory segment
+
+        the segment holds a ring buffer (channel) for every ordered pair of ranks,
+        each channel has one writer and one reader, which only share two counters:
+            written -> the total number of bytes written to the channel
+            read    -> the total number of bytes read from the channel
+
+        the segment is made by the launching process with create before the ranks start, and removed with remove once they're done
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <atomic> // the channel counters, lock free so they work across processes
+#include <string>
+#include <cstring> // std::memcpy, std::strerror
+#include <cerrno>
+#include <stdexcept> // std::runtime_error, thrown if the segment can't be made or opened
+#include <algorithm> // std::min
+#include <thread> // std::this_thread::yield, while waiting on the other rank
+#include <new> // placement new, to start the channel counters in the segment
+
+#include <fcntl.h> // O_* constants
+#include <sys/mman.h> // shm_open, mmap
+#include <unistd.h> // ftruncate, close
+
+#include "transport.hpp"
+
+class SharedMemoryTransport : public Transport
+{
+    private:
+        // the number of bytes each channel can hold before the writer has to wait for the reader
+        static constexpr uint64_t channel_capacity = 1 << 20;
+
+        struct channel
+        {
+            // on their own cache lines, so the writer and reader don't slow each other down
+            alignas(64) std::atomic<uint64_t> written;
+            alignas(64) std::atomic<uint64_t> read;
+
+            alignas(64) char data[channel_capacity];
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "the channel counters have to be lock free to be shared between processes");
+
+        int rank;
+        int size;
+
+        // the mapped segment, size * size channels, the channel from rank a to rank b is at a * size + b
+        channel * channels;
+        uint64_t segment_bytes;
+
+        static uint64_t get_segment_bytes(int size)
+        {
+            return sizeof(channel) * size * size;
+        }
+
+    public:
+
+    /**
+     * makes the shared memory segment for size ranks, named name (which has to start with a /),
+     * call once, before any rank opens it
+     */
+    static void create(const std::string & name, int size)
+    {
+        int file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if(file < 0)
+        {
+            throw std::runtime_error("SharedMemoryTransport: could not create " + name + ": " + std::strerror(errno));
+        }
+
+        uint64_t segment_bytes = get_segment_bytes(size);
+        if(ftruncate(file, segment_bytes) != 0)
+        {
+            close(file);
+            throw std::runtime_error("SharedMemoryTransport: could not size " + name + ": " + std::strerror(errno));
+        }
+
+        void * segment = mmap(nullptr, segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        close(file);
+
+        if(segment == MAP_FAILED)
+        {
+            throw std::runtime_error("SharedMemoryTransport: could not map " + name + ": " + std::strerror(errno));
+        }
+
+        // start every channel empty
+        channel * channels = static_cast<channel *>(segment);
+        for (int i = 0; i < size * size; i++)
+        {
+            new (&channels[i].written) std::atomic<uint64_t>(0);
+            new (&channels[i].read) std::atomic<uint64_t>(0);
+        }
+
+        munmap(segment, segment_bytes);
+    }
+
+    // removes the shared memory segment, ranks that still have it open keep it until they're done
+    static void remove(const std::string & name)
+    {
+        shm_unlink(name.c_str());
+    }
+
+    // opens the segment made by create as rank rank of size ranks
+    SharedMemoryTransport(const std::string & name, int rank, int size)
+    {
+        this->rank = rank;
+        this->size = size;
+        this->segment_bytes = get_segment_bytes(size);
+
+        int file = shm_open(name.c_str(), O_RDWR, 0600);
+        if(file < 0)
+        {
+            throw std::runtime_error("SharedMemoryTransport: could not open " + name + ": " + std::strerror(errno));
+        }
+
+        void * segment = mmap(nullptr, this->segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        close(file);
+
+        if(segment == MAP_FAILED)
+        {
+            throw std::runtime_error("SharedMemoryTransport: could not map " + name + ": " + std::strerror(errno));
+        }
+
+        this->channels = static_cast<channel *>(segment);
+    }
+
+    ~SharedMemoryTransport()
+    {
+        munmap(this->channels, this->segment_bytes);
+    }
+
+    int get_rank() override
+    {
+        return this->rank;
+    }
+
+    int get_size() override
+    {
+        return this->size;
+    }
+
+    void send(int to_rank, const void * data, uint64_t bytes) override
+    {
+        channel & to = this->channels[this->rank * this->size + to_rank];
+        const char * from_data = static_cast<const char *>(data);
+
+        uint64_t written = to.written.load(std::memory_order_relaxed);
+
+        while(bytes > 0)
+        {
+            uint64_t free_bytes = channel_capacity - (written - to.read.load(std::memory_order_acquire));
+            if(free_bytes == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // up to the end of the ring, the rest goes to the start on the next pass
+            uint64_t offset = written % channel_capacity;
+            uint64_t chunk = std::min(std::min(free_bytes, bytes), channel_capacity - offset);
+
+            std::memcpy(to.data + offset, from_data, chunk);
+
+            written += chunk;
+            to.written.store(written, std::memory_order_release);
+
+            from_data += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    void receive(int from_rank, void * data, uint64_t bytes) override
+    {
+        channel & from = this->channels[from_rank * this->size + this->rank];
+        char * to_data = static_cast<char *>(data);
+
+        uint64_t read = from.read.load(std::memory_order_relaxed);
+
+        while(bytes > 0)
+        {
+            uint64_t available_bytes = from.written.load(std::memory_order_acquire) - read;
+            if(available_bytes == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            uint64_t offset = read % channel_capacity;
+            uint64_t chunk = std::min(std::min(available_bytes, bytes), channel_capacity - offset);
+
+            std::memcpy(to_data, from.data + offset, chunk);
+
+            read += chunk;
+            from.read.store(read, std::memory_order_release);
+
+            to_data += chunk;
+            bytes -= chunk;
+        }
+    }
+};
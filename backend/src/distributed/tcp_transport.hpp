@@ -0,0 +1,143 @@
+/*
+    name: tcp_transport.hpp
+
+    usecase:
+        a Transport (transport.hpp) between processes through one tcp connection per pair of ranks,
+        on one machine it runs over the loopback interface, with the ranks spread over several machines it needs their addresses
+
+        rank r listens on base_port + r,
+        it connects to every lower rank, and accepts a connection from every higher rank,
+        the first 4 bytes sent over each new connection are the rank of the one that connected
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread> // std::this_thread::sleep_for, while waiting for lower ranks to start listening
+#include <stdexcept> // std::runtime_error, thrown if a connection closes while data is still expected
+#include <algorithm> // std::min
+
+#include "Poco/Net/ServerSocket.h"
+#include "Poco/Net/StreamSocket.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Net/NetException.h"
+
+#include "transport.hpp"
+
+class TcpTransport : public Transport
+{
+    private:
+        int rank;
+        int size;
+
+        // the connection to every other rank, the one at this rank's own index is unused
+        std::vector<Poco::Net::StreamSocket> peers;
+
+        // the most bytes handed to one sendBytes / receiveBytes call
+        static constexpr int max_chunk_bytes = 1 << 20;
+
+    public:
+
+    // connects rank rank to the other size - 1 ranks, all listening on host from base_port to base_port + size - 1
+    TcpTransport(int rank, int size, Poco::UInt16 base_port, const std::string & host = "127.0.0.1")
+    {
+        this->rank = rank;
+        this->size = size;
+        this->peers.resize(size);
+
+        Poco::Net::ServerSocket server(Poco::Net::SocketAddress(host, base_port + rank));
+
+        // the lower ranks may not be listening yet, keep trying until they are
+        for (int peer = 0; peer < rank; peer++)
+        {
+            while(true)
+            {
+                try {
+                    this->peers[peer].connect(Poco::Net::SocketAddress(host, base_port + peer));
+                    break;
+                }
+                catch (Poco::Net::ConnectionRefusedException const &e) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+
+            int32_t own_rank = rank;
+            send_all(this->peers[peer], &own_rank, sizeof(own_rank));
+        }
+
+        for (int i = rank + 1; i < size; i++)
+        {
+            Poco::Net::StreamSocket connection = server.acceptConnection();
+
+            int32_t peer;
+            receive_all(connection, &peer, sizeof(peer));
+
+            this->peers[peer] = connection;
+        }
+
+        // the halos are sent once per step and waited on right away, so don't hold them back to fill up packets
+        for (int peer = 0; peer < size; peer++)
+        {
+            if(peer != rank)
+            {
+                this->peers[peer].setNoDelay(true);
+            }
+        }
+    }
+
+    int get_rank() override
+    {
+        return this->rank;
+    }
+
+    int get_size() override
+    {
+        return this->size;
+    }
+
+    void send(int to_rank, const void * data, uint64_t bytes) override
+    {
+        send_all(this->peers[to_rank], data, bytes);
+    }
+
+    void receive(int from_rank, void * data, uint64_t bytes) override
+    {
+        receive_all(this->peers[from_rank], data, bytes);
+    }
+
+    private:
+
+    // sendBytes may send less than asked, so keep going until everything is sent
+    static void send_all(Poco::Net::StreamSocket & socket, const void * data, uint64_t bytes)
+    {
+        const char * from_data = static_cast<const char *>(data);
+
+        while(bytes > 0)
+        {
+            int sent = socket.sendBytes(from_data, std::min<uint64_t>(bytes, max_chunk_bytes));
+
+            from_data += sent;
+            bytes -= sent;
+        }
+    }
+
+    // receiveBytes may receive less than asked, so keep going until everything arrived
+    static void receive_all(Poco::Net::StreamSocket & socket, void * data, uint64_t bytes)
+    {
+        char * to_data = static_cast<char *>(data);
+
+        while(bytes > 0)
+        {
+            int received = socket.receiveBytes(to_data, std::min<uint64_t>(bytes, max_chunk_bytes));
+            if(received <= 0)
+            {
+                throw std::runtime_error("TcpTransport: connection closed while receiving");
+            }
+
+            to_data += received;
+            bytes -= received;
+        }
+    }
+};
@@ -0,0 +1,75 @@
+/*
+    name: transport.hpp
+
+    usecase:
+        how the processes (ranks) of a distributed simulation talk to each other, see DistributedSimulation (simulation/distributed_simulation.hpp)
+
+        a transport connects every rank to every other rank,
+        the bytes sent from one rank to another arrive in the order they were sent,
+        there are no message boundaries, a receive has to ask for exactly the number of bytes the matching send sent
+
+        implementations:
+            SharedMemoryTransport (shared_memory_transport.hpp) -> ranks on the same machine, through a POSIX shared memory segment
+            TcpTransport (tcp_transport.hpp)                    -> ranks anywhere, through one tcp connection per pair of ranks
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <thread> // std::thread, sends on a second thread during an exchange
+#include <exception> // std::exception_ptr, carries an error of the send out of its thread
+
+class Transport
+{
+    public:
+
+    virtual ~Transport() {}
+
+    // returns the number of this process, from 0 to get_size() - 1
+    virtual int get_rank() = 0;
+
+    // returns the number of processes connected by the transport
+    virtual int get_size() = 0;
+
+    // sends bytes bytes of data to to_rank, returns once all of them are handed off, to_rank must not be this rank
+    virtual void send(int to_rank, const void * data, uint64_t bytes) = 0;
+
+    // receives bytes bytes of data from from_rank, returns once all of them arrived, from_rank must not be this rank
+    virtual void receive(int from_rank, void * data, uint64_t bytes) = 0;
+
+    /**
+     * sends to one rank while receiving from another (they can be the same rank),
+     * when every rank sends and receives at once, a plain send could wait forever for its receiver to make room,
+     * so the send runs on a second thread while this one receives
+     *
+     * if the send or the receive throws, the exception is rethrown here once the send thread is done
+     */
+    void exchange(int to_rank, const void * send_data, uint64_t send_bytes, int from_rank, void * receive_data, uint64_t receive_bytes)
+    {
+        std::exception_ptr send_error;
+
+        std::thread sender([&]()
+        {
+            try {
+                send(to_rank, send_data, send_bytes);
+            }
+            catch (...) {
+                send_error = std::current_exception();
+            }
+        });
+
+        try {
+            receive(from_rank, receive_data, receive_bytes);
+        }
+        catch (...) {
+            sender.join();
+            throw;
+        }
+
+        sender.join();
+
+        if(send_error)
+        {
+            std::rethrow_exception(send_error);
+        }
+    }
+};
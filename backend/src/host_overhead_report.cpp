@@ -0,0 +1,112 @@
+/*
+    name: host_overhead_report.cpp
+
+    usecase:
+        measures how long the host spends submitting each step with the sycl::buffer state of the Simulation class,
+        and with the USM state of the UsmSimulation class (simulation/usm_simulation.hpp), in the reference and fused kernel modes,
+        and with the USM state replaying each step from a recorded command graph
+
+        submit is the time submit_steps takes to return, which is all host work (making accessors, building the dependencies, enqueuing),
+        total is the time until every step is done, both per step
+*/
+#include "simulation/simulation_class.hpp"
+#include "simulation/usm_simulation.hpp"
+
+#include <string>
+#include <iostream>
+#include <iomanip> // std::setw, for the table
+#include <chrono> // time the submits and the steps
+
+////////////
+//  SYCL  //
+////////////
+#include<sycl/sycl.hpp>
+
+
+// the host time per step of one run, in microseconds
+struct step_times
+{
+    double submit;
+    double total;
+};
+
+template <typename simulation>
+step_times time_steps(simulation & sim, int number_of_frames)
+{
+    // the first steps pay for compiling and loading the kernels
+    sim.submit_steps(10);
+    sim.snapshot();
+
+    auto start = std::chrono::steady_clock::now();
+
+    sim.submit_steps(number_of_frames);
+
+    auto submitted = std::chrono::steady_clock::now();
+
+    sim.snapshot();
+
+    auto done = std::chrono::steady_clock::now();
+
+    step_times times;
+    times.submit = std::chrono::duration<double, std::micro>(submitted - start).count() / number_of_frames;
+    times.total = std::chrono::duration<double, std::micro>(done - start).count() / number_of_frames;
+    return times;
+}
+
+// prints one row of the report
+void report(const std::string & state, const std::string & mode, step_times times)
+{
+    std::cout << std::setw(8) << state
+              << std::setw(11) << mode
+              << std::setw(16) << times.submit
+              << std::setw(16) << times.total << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc != 1 && argc != 5)
+    {
+        std::cout << "usage: " << argv[0] << " [number_of_frames_to_compute sim_width sim_height sim_depth]" << std::endl;
+        return 0;
+    }
+
+    // the small grid of main.cpp by default, where the host overhead matters most
+    int number_of_frames = argc == 5 ? std::stoi(argv[1]) : 1000;
+    int width            = argc == 5 ? std::stoi(argv[2]) : 10;
+    int height           = argc == 5 ? std::stoi(argv[3]) : 10;
+    int depth            = argc == 5 ? std::stoi(argv[4]) : 10;
+
+    std::cout << width << " x " << height << " x " << depth << ", " << number_of_frames << " frames\n\n";
+
+    //                                                          unused   unused    unused          unused
+    //                                       width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    Simulation<D3Q27> buffer_reference(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, 2.0f, 0.8f, kernel_mode::reference);
+    Simulation<D3Q27> buffer_fused(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, 2.0f, 0.8f, kernel_mode::fused);
+    UsmSimulation<D3Q27> usm_reference(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, 2.0f, 0.8f, kernel_mode::reference);
+    UsmSimulation<D3Q27> usm_fused(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, 2.0f, 0.8f, kernel_mode::fused);
+    UsmSimulation<D3Q27> graph_reference(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, 2.0f, 0.8f, kernel_mode::reference);
+    UsmSimulation<D3Q27> graph_fused(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, 2.0f, 0.8f, kernel_mode::fused);
+
+    graph_reference.set_graph_replay(true);
+    graph_fused.set_graph_replay(true);
+
+    std::cout << "\n" << std::setw(8) << "state"
+              << std::setw(11) << "mode"
+              << std::setw(16) << "submit us/step"
+              << std::setw(16) << "total us/step" << "\n";
+
+    report("buffer", "reference", time_steps(buffer_reference, number_of_frames));
+    report("usm", "reference", time_steps(usm_reference, number_of_frames));
+    if(graph_reference.get_graph_replay())
+    {
+        report("graph", "reference", time_steps(graph_reference, number_of_frames));
+    }
+    report("buffer", "fused", time_steps(buffer_fused, number_of_frames));
+    report("usm", "fused", time_steps(usm_fused, number_of_frames));
+    if(graph_fused.get_graph_replay())
+    {
+        report("graph", "fused", time_steps(graph_fused, number_of_frames));
+    }
+
+    return 0;
+}
@@ -0,0 +1,610 @@
+/*
+    name: lbm_bench.cpp
+
+    usecase:
+        times next_frame (no file output) on the cylinder case over a matrix of grid sizes, lattices, kernel modes,
+        population layouts, storage types, collision operators and engines, and prints the throughput of each run, 
+        optionally writing the results as json so runs on different commits or devices can be compared
+
+        every kernel mode runs with the aos layout, 32 bit floats and bgk collision, 
+        the other layouts, storage types and collision operators run with the fused mode,
+        the macroscopic variables are never copied to the host, so a step is only the kernels that advance the populations
+
+        the other engines run the fused mode with the aos layout, 32 bit floats and bgk collision, and do copy the macroscopic variables:
+            advance     -> Simulation::advance, timed per call of time_block_depth steps, which copies them to the host once per call
+            usm         -> UsmSimulation (usm_simulation.hpp), one step at a time, never copying them
+            usm graph   -> the same, replaying each step from a recorded command graph, left out without sycl_ext_oneapi_graph
+            slabs       -> one z-slab per device (multi_device_simulation.hpp), which copies them every step
+            cpu engine  -> CpuSimulation (cpu/cpu_simulation.hpp) on the host's threads, which writes them every step,
+                           built with the flags of this bench, not the -march=native of save_to_file_cpu
+
+        the distributed (--ranks) and refined (--refine) simulations of save_to_file aren't part of the bench
+
+        for each run:
+            nodes       -> the nodes a step updates, every node except in the sparse mode, where it's only the stored nodes
+            mlups       -> million lattice (node) updates per second, from the median step time
+            bandwidth   -> the populations every updated node reads and writes once per step plus its node type, over the median step time,
+                           the least memory traffic a step can get away with, so it reads as the bandwidth the kernels achieved
+            step times  -> the min, 50th, 90th and 99th percentile and max time of one step, in microseconds
+
+        the json file has the device, the settings, and one object per run with the fields of the table
+*/
+#include "simulation/simulation_class.hpp"
+#include "simulation/autotuner.hpp" // simulation_device, kernel_mode_name
+#include "simulation/multi_device_simulation.hpp"
+#include "simulation/usm_simulation.hpp"
+#include "cpu/cpu_simulation.hpp"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <iomanip> // std::setw, for the table
+#include <sstream>
+#include <vector>
+#include <algorithm> // std::sort
+#include <chrono> // time the steps
+#include <cmath> // std::ceil
+#include <stdexcept> // std::invalid_argument, thrown by the modes that can't run a grid
+#include <cstdio> // std::snprintf, for the json escapes
+
+////////////
+//  SYCL  //
+////////////
+#include<sycl/sycl.hpp>
+
+
+// one grid size of the matrix
+struct grid_size
+{
+    int width;
+    int height;
+    int depth;
+};
+
+// the timings of one run
+struct bench_result
+{
+    std::string lattice;
+    std::string mode;
+    std::string layout;
+    std::string storage;
+    std::string collision;
+    int width;
+    int height;
+    int depth;
+    int node_count;
+
+    double mlups;
+    double bandwidth; // in GB/s
+
+    // the time of one step, in microseconds
+    double min;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+// the settings every run of the matrix shares
+struct bench_settings
+{
+    int warm_up_steps;
+    int timed_steps;
+
+    // the radius of the cylinder as a fraction of the width
+    float radius_fraction;
+
+    float tau;
+};
+
+const kernel_mode all_kernel_modes[] = {kernel_mode::reference, kernel_mode::fused, kernel_mode::in_place, kernel_mode::tiled,
+                                        kernel_mode::sparse, kernel_mode::split_boundaries, kernel_mode::padded, kernel_mode::bricked};
+
+/**
+ * returns the p-th percentile (0 to 1) of sorted_times, the nearest rank
+ */
+double percentile(const std::vector<double> & sorted_times, double p)
+{
+    int rank = int(std::ceil(p * sorted_times.size())) - 1;
+    return sorted_times[std::min(std::max(rank, 0), int(sorted_times.size()) - 1)];
+}
+
+/**
+ * runs the warm up steps, then times each of the timed steps, in microseconds,
+ * step: runs steps_per_call steps and waits for them, a call is timed as a whole and counted as that many steps of its average time
+ */
+template <typename step_function>
+void time_steps(const bench_settings & settings, step_function step, int steps_per_call, std::vector<double> & step_times)
+{
+    // the first steps pay for compiling and loading the kernels
+    for(int done_steps = 0; done_steps < settings.warm_up_steps; done_steps += steps_per_call)
+    {
+        step();
+    }
+
+    // step waits for its steps, so each call can be timed on its own
+    for(int done_steps = 0; done_steps < settings.timed_steps; done_steps += steps_per_call)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        step();
+
+        auto done = std::chrono::steady_clock::now();
+
+        step_times.push_back(std::chrono::duration<double, std::micro>(done - start).count() / steps_per_call);
+    }
+}
+
+/**
+ * runs one run of the matrix, returns false if it threw, after printing why,
+ * std::invalid_argument when a mode can't run the grid, sycl::exception when the device can't, for example when it runs out of memory
+ */
+template <typename run_function>
+bool run_guarded(const std::string & name, run_function run)
+{
+    try
+    {
+        run();
+        return true;
+    }
+    catch (std::invalid_argument const &e)
+    {
+        std::cerr << name << ": " << e.what() << std::endl;
+    }
+    catch (sycl::exception const &e)
+    {
+        std::cerr << name << ": " << e.what() << std::endl;
+    }
+
+    return false;
+}
+
+// fills in the fields of a result that describe the run
+void describe(bench_result & result, const std::string & lattice_name, const std::string & mode, const std::string & layout_name, 
+              const std::string & storage_name, const std::string & collision_name, grid_size size)
+{
+    result.lattice = lattice_name;
+    result.mode = mode;
+    result.layout = layout_name;
+    result.storage = storage_name;
+    result.collision = collision_name;
+    result.width = size.width;
+    result.height = size.height;
+    result.depth = size.depth;
+}
+
+/**
+ * fills in the step time percentiles, the mlups and the bandwidth of a result from its step times,
+ * bytes_per_node: the least memory a step moves per node
+ */
+void summarize(std::vector<double> step_times, double bytes_per_node, bench_result & result)
+{
+    std::sort(step_times.begin(), step_times.end());
+
+    result.min = step_times.front();
+    result.p50 = percentile(step_times, 0.5);
+    result.p90 = percentile(step_times, 0.9);
+    result.p99 = percentile(step_times, 0.99);
+    result.max = step_times.back();
+
+    // nodes per microsecond is millions of nodes per second
+    result.mlups = result.node_count / result.p50;
+
+    // bytes per microsecond is MB/s, so divided by 1000 is GB/s
+    result.bandwidth = result.node_count * bytes_per_node / result.p50 / 1000.0;
+}
+
+/**
+ * times one run of the matrix, returns false if the mode can't run the grid
+ */
+template <typename lattice, typename layout, typename storage, typename collision = bgk_collision>
+bool bench(const bench_settings & settings, kernel_mode mode, grid_size size, const std::string & lattice_name, 
+           const std::string & layout_name, const std::string & storage_name, const std::string & collision_name, bench_result & result)
+{
+    std::vector<double> step_times;
+
+    describe(result, lattice_name, kernel_mode_name(mode), layout_name, storage_name, collision_name, size);
+
+    bool ran = run_guarded(lattice_name + " " + kernel_mode_name(mode), [&]
+    {
+        //                                                                       unused   unused    unused          unused
+        //                                               width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+        Simulation<lattice, layout, storage, collision> sim(size.width, size.height, size.depth, 1.225f, 0.00001f, 343, 0.02f,
+                                                            settings.radius_fraction * size.width, settings.tau, mode);
+
+        // never reached, so no step copies the macroscopic variables to the host
+        sim.set_macroscopic_variables_interval(settings.warm_up_steps + settings.timed_steps + 1);
+
+        time_steps(settings, [&] { sim.next_frame(); }, 1, step_times);
+
+        // the sparse mode only updates the stored nodes
+        result.node_count = mode == kernel_mode::sparse ? sim.get_stored_node_count() : sim.get_node_count();
+    });
+
+    if(!ran)
+    {
+        return false;
+    }
+
+    summarize(step_times, 2.0 * lattice::count * sizeof(typename storage::type) + sizeof(uint8_t), result);
+
+    return true;
+}
+
+/**
+ * times Simulation::advance in the fused mode, one call of time_block_depth steps at a time, 
+ * each call copies the macroscopic variables to the host after its last step
+ */
+template <typename lattice>
+bool bench_advance(const bench_settings & settings, grid_size size, const std::string & lattice_name, bench_result & result)
+{
+    std::vector<double> step_times;
+
+    bool ran = run_guarded(lattice_name + " advance", [&]
+    {
+        //                                                  unused   unused    unused          unused
+        //                              width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+        Simulation<lattice> sim(size.width, size.height, size.depth, 1.225f, 0.00001f, 343, 0.02f,
+                                settings.radius_fraction * size.width, settings.tau, kernel_mode::fused);
+
+        int depth = sim.get_time_block_depth();
+
+        time_steps(settings, [&] { sim.advance(depth); }, depth, step_times);
+
+        // the depth the blocks actually ran, lower when the block doesn't fit in local memory
+        describe(result, lattice_name, "advance x" + std::to_string(sim.get_used_time_block_depth()), "aos", "fp32", "bgk", size);
+        result.node_count = sim.get_node_count();
+    });
+
+    if(!ran)
+    {
+        return false;
+    }
+
+    summarize(step_times, 2.0 * lattice::count * sizeof(float) + sizeof(uint8_t), result);
+
+    return true;
+}
+
+/**
+ * times the fused mode of UsmSimulation, one step at a time, with each step replayed from a recorded command graph when graph_replay is true,
+ * returns false without a run if graph_replay is true but the graph extension isn't there
+ */
+template <typename lattice>
+bool bench_usm(const bench_settings & settings, grid_size size, bool graph_replay, const std::string & lattice_name, bench_result & result)
+{
+    std::vector<double> step_times;
+
+    describe(result, lattice_name, graph_replay ? "usm graph" : "usm", "aos", "fp32", "bgk", size);
+
+    bool ran = run_guarded(lattice_name + " " + result.mode, [&]
+    {
+        //                                                      unused   unused    unused          unused
+        //                                  width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+        UsmSimulation<lattice> sim(size.width, size.height, size.depth, 1.225f, 0.00001f, 343, 0.02f,
+                                   settings.radius_fraction * size.width, settings.tau, kernel_mode::fused);
+
+        sim.set_graph_replay(graph_replay);
+        if(sim.get_graph_replay() != graph_replay)
+        {
+            throw std::invalid_argument("command graphs need the sycl_ext_oneapi_graph extension");
+        }
+
+        // no host copies, the same as the runs of the Simulation class
+        time_steps(settings, [&] { sim.submit_steps(1).wait(); }, 1, step_times);
+
+        result.node_count = sim.get_node_count();
+    });
+
+    if(!ran)
+    {
+        return false;
+    }
+
+    summarize(step_times, 2.0 * lattice::count * sizeof(float) + sizeof(uint8_t), result);
+
+    return true;
+}
+
+/**
+ * times one run of the simulation split into one z-slab per queue of slab_queues (see MultiDeviceSimulation),
+ * it copies the macroscopic variables to the host every step, so its steps include that copy
+ */
+template <typename lattice>
+bool bench_multi_device(const bench_settings & settings, grid_size size, const std::string & lattice_name, bench_result & result)
+{
+    std::vector<double> step_times;
+
+    bool ran = run_guarded(lattice_name + " slabs", [&]
+    {
+        //                                                  unused   unused    unused          unused
+        //                          width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+        MultiDeviceSimulation<lattice> sim(size.width, size.height, size.depth, 1.225f, 0.00001f, 343, 0.02f,
+                                           settings.radius_fraction * size.width, settings.tau);
+
+        time_steps(settings, [&] { sim.next_frame(); }, 1, step_times);
+
+        describe(result, lattice_name, "slabs x" + std::to_string(sim.get_slab_count()), "aos", "fp32", "bgk", size);
+        result.node_count = sim.get_node_count();
+    });
+
+    if(!ran)
+    {
+        return false;
+    }
+
+    summarize(step_times, 2.0 * lattice::count * sizeof(float) + sizeof(uint8_t), result);
+
+    return true;
+}
+
+/**
+ * times the native cpu engine (CpuSimulation) on every thread of the host, it writes the macroscopic variables every step
+ */
+template <typename lattice>
+bool bench_cpu(const bench_settings & settings, grid_size size, const std::string & lattice_name, bench_result & result)
+{
+    std::vector<double> step_times;
+
+    describe(result, lattice_name, "cpu engine", "soa", "fp32", "bgk", size);
+
+    //                                                 unused   unused    unused          unused
+    //                             width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    CpuSimulation<lattice> sim(size.width, size.height, size.depth, 1.225f, 0.00001f, 343, 0.02f,
+                               settings.radius_fraction * size.width, settings.tau);
+
+    time_steps(settings, [&] { sim.next_frame(); }, 1, step_times);
+
+    result.node_count = sim.get_node_count();
+
+    summarize(step_times, 2.0 * lattice::count * sizeof(float) + sizeof(uint8_t), result);
+
+    return true;
+}
+
+// prints one row of the table
+void report(const bench_result & result)
+{
+    std::cout << std::setw(7) << result.lattice
+              << std::setw(16) << (std::to_string(result.width) + "x" + std::to_string(result.height) + "x" + std::to_string(result.depth))
+              << std::setw(18) << result.mode
+              << std::setw(8) << result.layout
+              << std::setw(9) << result.storage
+              << std::setw(14) << result.collision
+              << std::fixed << std::setprecision(2)
+              << std::setw(12) << result.mlups
+              << std::setw(12) << result.bandwidth
+              << std::setw(12) << result.min
+              << std::setw(12) << result.p50
+              << std::setw(12) << result.p90
+              << std::setw(12) << result.p99
+              << std::setw(12) << result.max << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+/**
+ * runs every kernel mode, layout and storage type of one lattice on one grid size
+ */
+template <typename lattice>
+void bench_lattice(const bench_settings & settings, grid_size size, const std::string & lattice_name, std::vector<bench_result> & results)
+{
+    bench_result result;
+
+    for(kernel_mode mode : all_kernel_modes)
+    {
+        if(bench<lattice, aos_layout, fp32_storage>(settings, mode, size, lattice_name, "aos", "fp32", "bgk", result)) { report(result); results.push_back(result); }
+    }
+
+    if(bench<lattice, soa_layout, fp32_storage>(settings, kernel_mode::fused, size, lattice_name, "soa", "fp32", "bgk", result)) { report(result); results.push_back(result); }
+    if(bench<lattice, aosoa_layout<>, fp32_storage>(settings, kernel_mode::fused, size, lattice_name, "aosoa", "fp32", "bgk", result)) { report(result); results.push_back(result); }
+    if(bench<lattice, aos_layout, fp16_storage>(settings, kernel_mode::fused, size, lattice_name, "aos", "fp16", "bgk", result)) { report(result); results.push_back(result); }
+    if(bench<lattice, aos_layout, bf16_storage>(settings, kernel_mode::fused, size, lattice_name, "aos", "bf16", "bgk", result)) { report(result); results.push_back(result); }
+    if(bench<lattice, aos_layout, fixed16_storage<>>(settings, kernel_mode::fused, size, lattice_name, "aos", "fixed16", "bgk", result)) { report(result); results.push_back(result); }
+
+    if(bench<lattice, aos_layout, fp32_storage, regularized_collision>(settings, kernel_mode::fused, size, lattice_name, "aos", "fp32", "regularized", result)) { report(result); results.push_back(result); }
+    if(bench<lattice, aos_layout, fp32_storage, mrt_collision>(settings, kernel_mode::fused, size, lattice_name, "aos", "fp32", "mrt", result)) { report(result); results.push_back(result); }
+
+    if(bench_advance<lattice>(settings, size, lattice_name, result)) { report(result); results.push_back(result); }
+    if(bench_usm<lattice>(settings, size, false, lattice_name, result)) { report(result); results.push_back(result); }
+    if(bench_usm<lattice>(settings, size, true, lattice_name, result)) { report(result); results.push_back(result); }
+    if(bench_multi_device<lattice>(settings, size, lattice_name, result)) { report(result); results.push_back(result); }
+    if(bench_cpu<lattice>(settings, size, lattice_name, result)) { report(result); results.push_back(result); }
+}
+
+/**
+ * returns text as a json string, in quotes, with the quotes, backslashes and control characters escaped
+ */
+std::string json_string(const std::string & text)
+{
+    std::string escaped = "\"";
+
+    for(char character : text)
+    {
+        switch(character)
+        {
+        case '"':  escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if((unsigned char) character < 0x20)
+            {
+                char code[7];
+                std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char) character);
+                escaped += code;
+            }
+            else
+            {
+                escaped += character;
+            }
+        }
+    }
+
+    return escaped + "\"";
+}
+
+/**
+ * writes the results as json
+ */
+void write_json(const std::string & json_filename, const std::string & device_name, const bench_settings & settings, const std::vector<bench_result> & results)
+{
+    std::ofstream file(json_filename);
+
+    if(!file.is_open())
+    {
+        std::cerr << json_filename << " could not be opened" << std::endl;
+        return;
+    }
+
+    file << "{\n";
+    file << "  \"device\": " << json_string(device_name) << ",\n";
+    file << "  \"warm_up_steps\": " << settings.warm_up_steps << ",\n";
+    file << "  \"timed_steps\": " << settings.timed_steps << ",\n";
+    file << "  \"radius_fraction\": " << settings.radius_fraction << ",\n";
+    file << "  \"tau\": " << settings.tau << ",\n";
+    file << "  \"results\": [\n";
+
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const bench_result & result = results[i];
+
+        file << "    {\"lattice\": " << json_string(result.lattice) << ", \"mode\": " << json_string(result.mode)
+             << ", \"layout\": " << json_string(result.layout) << ", \"storage\": " << json_string(result.storage)
+             << ", \"collision\": " << json_string(result.collision) << ", "
+             << "\"width\": " << result.width << ", \"height\": " << result.height << ", \"depth\": " << result.depth << ", "
+             << "\"node_count\": " << result.node_count << ", \"mlups\": " << result.mlups << ", \"bandwidth_gb_s\": " << result.bandwidth << ", "
+             << "\"step_us\": {\"min\": " << result.min << ", \"p50\": " << result.p50 << ", \"p90\": " << result.p90
+             << ", \"p99\": " << result.p99 << ", \"max\": " << result.max << "}}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    file << "  ]\n";
+    file << "}\n";
+}
+
+/**
+ * reads a comma separated list of grid sizes, each width x height x depth (e.g. 32x32x32,64x64x64)
+ */
+std::vector<grid_size> parse_sizes(const std::string & list)
+{
+    std::vector<grid_size> sizes;
+
+    std::istringstream entries(list);
+    std::string entry;
+    while(std::getline(entries, entry, ','))
+    {
+        grid_size size;
+        char separator_1, separator_2;
+
+        std::istringstream fields(entry);
+        if(!(fields >> size.width >> separator_1 >> size.height >> separator_2 >> size.depth) || separator_1 != 'x' || separator_2 != 'x'
+           || size.width < 1 || size.height < 1 || size.depth < 1)
+        {
+            throw std::invalid_argument("--sizes: " + entry + " is not width x height x depth");
+        }
+
+        sizes.push_back(size);
+    }
+
+    return sizes;
+}
+
+int main(int argc, char *argv[])
+{
+    bench_settings settings = {5, 100, 0.125f, 1.3f};
+    std::string size_list = "32x32x32,64x64x64,128x128x128";
+    std::string lattice_list = "d3q27,d3q19,d3q15,d2q9";
+    std::string json_filename = "";
+
+    for(int i = 1; i < argc; i += 2)
+    {
+        std::string option = argv[i];
+
+        if(i + 1 >= argc)
+        {
+            std::cout << "usage: " << argv[0] << " [--sizes 32x32x32,64x64x64] [--lattices d3q27,d3q19,d3q15,d2q9] [--frames number_of_timed_frames]"
+                      << " [--warm-up number_of_untimed_frames] [--radius cylinder_radius_over_width] [--tau tau_value] [--json results.json]" << std::endl;
+            std::cout << "    d2q9 runs each size with a height of 1" << std::endl;
+            std::cout << "    runs every kernel mode, layout, storage type and collision operator of the Simulation class, its advance,"
+                      << " the usm (and command graph) and multi device engines and the native cpu engine,"
+                      << " the distributed and refined simulations aren't included" << std::endl;
+            return 0;
+        }
+
+        if(option == "--sizes")         { size_list = argv[i + 1]; }
+        else if(option == "--lattices") { lattice_list = argv[i + 1]; }
+        else if(option == "--frames")   { settings.timed_steps = std::stoi(argv[i + 1]); }
+        else if(option == "--warm-up")  { settings.warm_up_steps = std::stoi(argv[i + 1]); }
+        else if(option == "--radius")   { settings.radius_fraction = std::stof(argv[i + 1]); }
+        else if(option == "--tau")      { settings.tau = std::stof(argv[i + 1]); }
+        else if(option == "--json")     { json_filename = argv[i + 1]; }
+        else
+        {
+            std::cout << "unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    if(settings.timed_steps < 1 || settings.warm_up_steps < 0)
+    {
+        std::cout << "--frames must be at least 1 and --warm-up at least 0" << std::endl;
+        return 1;
+    }
+
+    std::vector<grid_size> sizes;
+    try
+    {
+        sizes = parse_sizes(size_list);
+    }
+    catch (std::invalid_argument const &e)
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    std::string device_name = simulation_device().get_info<sycl::info::device::name>();
+
+    std::cout << "device: " << device_name << ", " << settings.warm_up_steps << " warm up and " << settings.timed_steps << " timed frames per run\n\n";
+
+    std::cout << std::setw(7) << "lattice"
+              << std::setw(16) << "grid"
+              << std::setw(18) << "mode"
+              << std::setw(8) << "layout"
+              << std::setw(9) << "storage"
+              << std::setw(14) << "collision"
+              << std::setw(12) << "MLUPS"
+              << std::setw(12) << "GB/s"
+              << std::setw(12) << "min us"
+              << std::setw(12) << "p50 us"
+              << std::setw(12) << "p90 us"
+              << std::setw(12) << "p99 us"
+              << std::setw(12) << "max us" << std::endl;
+
+    std::vector<bench_result> results;
+
+    for(grid_size size : sizes)
+    {
+        std::istringstream lattices(lattice_list);
+        std::string lattice_name;
+        while(std::getline(lattices, lattice_name, ','))
+        {
+            if(lattice_name == "d3q27")      { bench_lattice<D3Q27>(settings, size, lattice_name, results); }
+            else if(lattice_name == "d3q19") { bench_lattice<D3Q19>(settings, size, lattice_name, results); }
+            else if(lattice_name == "d3q15") { bench_lattice<D3Q15>(settings, size, lattice_name, results); }
+            else if(lattice_name == "d2q9")  { bench_lattice<D2Q9>(settings, {size.width, 1, size.depth}, lattice_name, results); }
+            else
+            {
+                std::cout << "unknown lattice: " << lattice_name << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    if(!json_filename.empty())
+    {
+        write_json(json_filename, device_name, settings, results);
+        std::cout << "\nresults written to " << json_filename << std::endl;
+    }
+
+    return 0;
+}
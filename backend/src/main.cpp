@@ -28,6 +28,7 @@ int main()
 
     sycl::range<3> tempDims = sim.get_dimensions();
     
+    // the velocity messenger sends 4 floats per node, the velocity in x, y and z then the density in w (the same value as the density messenger)
     //                                                     port #, data pointer,   width,           height,          depth
     Messenger velocity_messenger = Messenger<sycl::float4>(4000, sim.vector_array, tempDims.get(0), tempDims.get(1), tempDims.get(2));
     Messenger density_messenger = Messenger<float>(4001, sim.density_array, tempDims.get(0), tempDims.get(1), tempDims.get(2));
@@ -0,0 +1,300 @@
+/*
+    name: precision_report.cpp
+
+    usecase:
+        runs the cylinder case once with 32 bit float populations and once with each of the 16 bit storage types (see population_storage.hpp),
+        then prints how far the macroscopic density and velocity of each 16 bit run drifted from the 32 bit run
+
+        then runs the case once in every kernel mode (and with advance instead of next_frame in the time blocked modes),
+        and split into z-slabs (see multi_device_simulation.hpp), and prints how far the populations of each run are from the fused run, node by node
+
+        exits with 1 if the populations of any of those runs are further than mode_tolerance from the fused run,
+        the modes load and add up the populations in different orders, so with a fast floating point model (the icpx default)
+        they can round differently, the tolerance leaves room for that but not for a mode that streams or collides differently
+*/
+#include "simulation/simulation_class.hpp"
+#include "simulation/autotuner.hpp" // kernel_mode_name
+#include "simulation/multi_device_simulation.hpp"
+
+#include <string>
+#include <iostream>
+#include <iomanip> // std::setw, for the table
+#include <vector>
+#include <cmath>
+#include <cstdlib> // srand
+
+////////////
+//  SYCL  //
+////////////
+#include<sycl/sycl.hpp>
+
+
+// the largest difference between a population of a kernel mode (or slab) run and the fused run that still counts as the same result
+const double mode_tolerance = 1e-4;
+
+// the macroscopic state of a finished run
+struct macroscopic_fields
+{
+    std::vector<float> density;
+    std::vector<sycl::float4> velocity;
+};
+
+template <typename storage>
+macroscopic_fields run(int number_of_frames, int width, int height, int depth, float tau, float cylinder_radius)
+{
+    // every run starts from the same random noise
+    srand(0);
+
+    //                                               unused   unused    unused          unused
+    //                            width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    Simulation<D3Q27, aos_layout, storage> sim(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, cylinder_radius, tau);
+
+    for(int i = 0; i < number_of_frames; ++i)
+    {
+        sim.next_frame();
+    }
+
+    macroscopic_fields fields;
+
+    float * density_array = sim.density_array.load();
+    sycl::float4 * vector_array = sim.vector_array.load();
+
+    fields.density.assign(density_array, density_array + sim.get_node_count());
+    fields.velocity.assign(vector_array, vector_array + sim.get_node_count());
+
+    return fields;
+}
+
+// prints one row of the report, comparing the fields of a 16 bit run to the 32 bit reference run
+void report(const std::string & name, int bytes_per_population, const macroscopic_fields & reference, const macroscopic_fields & fields)
+{
+    double max_density_error = 0.0;
+    double density_error_squared = 0.0;
+
+    double max_velocity_error = 0.0;
+    double velocity_error_squared = 0.0;
+    double velocity_squared = 0.0;
+
+    for(size_t i = 0; i < reference.density.size(); ++i)
+    {
+        double density_error = std::fabs(fields.density[i] - reference.density[i]);
+
+        max_density_error = std::max(max_density_error, density_error);
+        density_error_squared += density_error * density_error;
+
+        double error_x = fields.velocity[i].x() - reference.velocity[i].x();
+        double error_y = fields.velocity[i].y() - reference.velocity[i].y();
+        double error_z = fields.velocity[i].z() - reference.velocity[i].z();
+
+        double velocity_error = error_x * error_x + error_y * error_y + error_z * error_z;
+
+        max_velocity_error = std::max(max_velocity_error, std::sqrt(velocity_error));
+        velocity_error_squared += velocity_error;
+        velocity_squared += magnitude(reference.velocity[i]) * magnitude(reference.velocity[i]);
+    }
+
+    double rms_density_error = std::sqrt(density_error_squared / reference.density.size());
+    double relative_velocity_error = velocity_squared > 0.0 ? std::sqrt(velocity_error_squared / velocity_squared) : 0.0;
+
+    std::cout << std::setw(10) << name
+              << std::setw(8) << bytes_per_population
+              << std::setw(16) << max_density_error
+              << std::setw(16) << rms_density_error
+              << std::setw(16) << max_velocity_error
+              << std::setw(16) << relative_velocity_error << "\n";
+}
+
+// the populations and node types of a finished run, node by node
+struct population_fields
+{
+    std::vector<float> populations;
+    std::vector<uint8_t> node_types;
+
+    // the steps per temporally blocked kernel advance ran, 0 when the run didn't call advance
+    int time_block_depth = 0;
+};
+
+// advanced: run the frames with one call to advance instead of a call to next_frame per frame
+population_fields run_mode(kernel_mode mode, bool advanced, int number_of_frames, int width, int height, int depth, float tau, float cylinder_radius)
+{
+    // every run starts from the same random noise
+    srand(0);
+
+    //                                                  unused   unused    unused          unused
+    //                              width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    Simulation<D3Q27> sim(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, cylinder_radius, tau, mode);
+
+    if(advanced)
+    {
+        sim.advance(number_of_frames);
+    }
+    else
+    {
+        for(int i = 0; i < number_of_frames; ++i)
+        {
+            sim.next_frame();
+        }
+    }
+
+    population_fields fields;
+
+    if(advanced)
+    {
+        fields.time_block_depth = sim.get_used_time_block_depth();
+    }
+
+    auto density_accessor = sim.get_accessor_for_discrete_density_buffer_1();
+    auto changeable_accessor = sim.get_accessor_for_changeable_buffer();
+    for(int i = 0; i < sim.get_node_count(); ++i)
+    {
+        for(uint8_t j = 0; j < D3Q27::count; ++j)
+        {
+            fields.populations.push_back(sim.read_population(density_accessor, i, j));
+        }
+
+        fields.node_types.push_back(changeable_accessor[i]);
+    }
+
+    return fields;
+}
+
+// the same as run_mode, split along z into slab_count slabs spread over the queues of slab_queues
+population_fields run_slabs(int slab_count, int number_of_frames, int width, int height, int depth, float tau, float cylinder_radius)
+{
+    // the same noise as run_mode, the slabs draw it in node order
+    srand(0);
+
+    std::vector<sycl::queue> devices = slab_queues();
+    std::vector<sycl::queue> queues;
+    for(int slab = 0; slab < slab_count; ++slab)
+    {
+        queues.push_back(devices[slab % devices.size()]);
+    }
+
+    //                                                        unused   unused    unused          unused
+    //                                    width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    MultiDeviceSimulation<D3Q27> sim(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, cylinder_radius, tau, queues);
+
+    for(int i = 0; i < number_of_frames; ++i)
+    {
+        sim.next_frame();
+    }
+
+    population_fields fields;
+
+    fields.populations.resize(sim.get_node_count() * D3Q27::count);
+    fields.node_types.resize(sim.get_node_count());
+
+    sim.copy_populations_to_host(fields.populations.data());
+    sim.copy_node_types_to_host(fields.node_types.data());
+
+    return fields;
+}
+
+// prints one row of the kernel mode report, comparing the populations of a run to the fused run,
+// with a second max error that leaves out the reflective nodes (node type 1), the split boundaries mode only claims to match off them
+// returns true if the run is within mode_tolerance of the fused run, off the reflective nodes only when walls_differ
+bool report_mode(const std::string & name, const population_fields & reference, const population_fields & fields, bool walls_differ = false)
+{
+    double max_error = 0.0;
+    double max_error_off_reflective = 0.0;
+    uint64_t differing = 0;
+
+    for(size_t i = 0; i < reference.populations.size(); ++i)
+    {
+        double error = std::fabs(fields.populations[i] - reference.populations[i]);
+
+        max_error = std::max(max_error, error);
+        if(reference.node_types[i / D3Q27::count] != 1)
+        {
+            max_error_off_reflective = std::max(max_error_off_reflective, error);
+        }
+
+        differing += fields.populations[i] != reference.populations[i];
+    }
+
+    bool within_tolerance = (walls_differ ? max_error_off_reflective : max_error) <= mode_tolerance;
+
+    std::cout << std::setw(24) << name
+              << std::setw(16) << max_error
+              << std::setw(20) << max_error_off_reflective
+              << std::setw(12) << differing
+              << std::setw(12) << (differing == 0 ? "yes" : "no")
+              << std::setw(12) << (within_tolerance ? "ok" : "FAILED") << "\n";
+
+    return within_tolerance;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc != 1 && argc != 7)
+    {
+        std::cout << "usage: " << argv[0] << " [number_of_frames_to_compute sim_width sim_height sim_depth tau_value cylinder_radius]" << std::endl;
+        return 0;
+    }
+
+    // the 2d cylinder case by default
+    int number_of_frames = argc == 7 ? std::stoi(argv[1]) : 500;
+    int width            = argc == 7 ? std::stoi(argv[2]) : 20;
+    int height           = argc == 7 ? std::stoi(argv[3]) : 1;
+    int depth            = argc == 7 ? std::stoi(argv[4]) : 80;
+    float tau            = argc == 7 ? std::stof(argv[5]) : 0.8f;
+    float cylinder_radius = argc == 7 ? std::stof(argv[6]) : 4.0f;
+
+    std::cout << "cylinder case: " << width << " x " << height << " x " << depth << ", tau " << tau << ", radius " << cylinder_radius << ", " << number_of_frames << " frames\n\n";
+
+    macroscopic_fields reference = run<fp32_storage>(number_of_frames, width, height, depth, tau, cylinder_radius);
+
+    std::cout << "\n" << std::setw(10) << "storage"
+              << std::setw(8) << "bytes"
+              << std::setw(16) << "max |drho|"
+              << std::setw(16) << "rms |drho|"
+              << std::setw(16) << "max |du|"
+              << std::setw(16) << "rel l2 du" << "\n";
+
+    report("fp32", sizeof(fp32_storage::type), reference, reference);
+    report("fp16", sizeof(fp16_storage::type), reference, run<fp16_storage>(number_of_frames, width, height, depth, tau, cylinder_radius));
+    report("bf16", sizeof(bf16_storage::type), reference, run<bf16_storage>(number_of_frames, width, height, depth, tau, cylinder_radius));
+    report("fixed16", sizeof(fixed16_storage<>::type), reference, run<fixed16_storage<>>(number_of_frames, width, height, depth, tau, cylinder_radius));
+
+    // the sparse mode is left out, the nodes it doesn't store report the resting state instead of their populations
+    population_fields fused = run_mode(kernel_mode::fused, false, number_of_frames, width, height, depth, tau, cylinder_radius);
+
+    std::cout << "\n" << std::setw(24) << "kernel mode"
+              << std::setw(16) << "max |df|"
+              << std::setw(20) << "max |df| off walls"
+              << std::setw(12) << "differing"
+              << std::setw(12) << "identical"
+              << std::setw(12) << "within " << mode_tolerance << "\n";
+
+    bool modes_match = true;
+
+    const kernel_mode modes[] = {kernel_mode::reference, kernel_mode::in_place, kernel_mode::tiled, kernel_mode::split_boundaries, kernel_mode::padded, kernel_mode::bricked};
+    for (kernel_mode mode : modes)
+    {
+        modes_match &= report_mode(kernel_mode_name(mode), fused, run_mode(mode, false, number_of_frames, width, height, depth, tau, cylinder_radius), mode == kernel_mode::split_boundaries);
+    }
+
+    // advance time blocks these modes, the name shows the steps per block it ran, x1 is one kernel per step
+    const kernel_mode advanced_modes[] = {kernel_mode::fused, kernel_mode::tiled};
+    for (kernel_mode mode : advanced_modes)
+    {
+        population_fields advanced = run_mode(mode, true, number_of_frames, width, height, depth, tau, cylinder_radius);
+        modes_match &= report_mode(kernel_mode_name(mode) + " advance x" + std::to_string(advanced.time_block_depth), fused, advanced);
+    }
+
+    // a slab count that splits the depth evenly, and one that doesn't
+    const int slab_counts[] = {2, 3};
+    for (int slab_count : slab_counts)
+    {
+        modes_match &= report_mode("slabs x" + std::to_string(slab_count), fused, run_slabs(slab_count, number_of_frames, width, height, depth, tau, cylinder_radius));
+    }
+
+    if(!modes_match)
+    {
+        std::cout << "\nsome runs are further than " << mode_tolerance << " from the fused run" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
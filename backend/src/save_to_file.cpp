@@ -7,51 +7,201 @@
         a secondary main file that saves data to a file to be read in later
 */ 
 #include "simulation/simulation_class.hpp"
+#include "simulation/multi_device_simulation.hpp" // MultiDeviceSimulation, and slab_queues to pick a device per rank
+#include "simulation/distributed_simulation.hpp"
+#include "simulation/refined_simulation.hpp"
+#include "simulation/autotuner.hpp"
+#include "distributed/shared_memory_transport.hpp"
+#include "distributed/tcp_transport.hpp"
 #include "socket/sockets.hpp"
+#include "simulation_file.hpp" // write_node_to_file
 
 #include <string>
 #include <iostream>
 #include <atomic>
+#include <vector>
+#include <algorithm> // std::replace
+#include <memory> // std::unique_ptr, for the transport of a rank
+#include <cstdlib> // srand, so the starting noise doesn't depend on the autotuner
 
 #include <fstream> // write to files
 #include <chrono> // get the time it took to run the simulation
 
+#include <unistd.h> // fork, getpid
+#include <sys/wait.h> // waitpid
+#include <signal.h> // kill, to stop the other ranks once one fails
+
 ////////////
 //  SYCL  //
 ////////////
 #include<sycl/sycl.hpp>
 
 
-void write_to_file(std::ofstream & file, Simulation & sim) 
+// the file always holds the populations of the 27 D3Q27 velocities per node, so the frontend can read any lattice,
+// the velocities the lattice does not have are written as 0
+template <typename lattice, typename layout, typename storage>
+void write_to_file(std::ofstream & file, Simulation<lattice, layout, storage> & sim) 
 {
     auto density_accessor = sim.get_accessor_for_discrete_density_buffer_1();
     auto changeable_accessor = sim.get_accessor_for_changeable_buffer();
     for(int i = 0; i < sim.get_node_count(); ++i) 
     {
-        file << (int) changeable_accessor[i] << " ";
+        float values[D3Q27::count] = {};
+        for(uint8_t j = 0; j < lattice::count; ++j)
+        {
+            values[lattice::d3q27_index[j]] = sim.read_population(density_accessor, i, j);
+        }
 
-        float density = sim.density_array.load()[i];
-        file << int(density * 100.0f) / 100.0f << " ";
+        write_node_to_file(file, changeable_accessor[i], sim.density_array.load()[i], values);
+    }
+    file << "\n";
+}
 
-        for(uint8_t j = 0; j < 27; ++j)
+// the same as write_to_file, from the node types, densities and populations gathered from the ranks of a distributed run
+template <typename lattice>
+void write_gathered_to_file(std::ofstream & file, const std::vector<uint8_t> & node_types, const std::vector<float> & density, const std::vector<float> & populations) 
+{
+    for(size_t i = 0; i < node_types.size(); ++i) 
+    {
+        float values[D3Q27::count] = {};
+        for(uint8_t j = 0; j < lattice::count; ++j)
         {
-            float val = density_accessor[i * 27 + j];
-            val = int(val * 1000.0f) / 1000.0f;
-            file << val << " ";
+            values[lattice::d3q27_index[j]] = populations[i * lattice::count + j];
         }
+
+        write_node_to_file(file, node_types[i], density[i], values);
     }
     file << "\n";
 }
 
+template <typename lattice>
+int run(float smagorinsky_constant, bool autotune_mode, bool retune, int argc, char *argv[]);
+
+template <typename lattice>
+int run_distributed(int rank_count, const std::string & transport_name, int argc, char *argv[]);
+
+template <typename lattice>
+int run_refined(int refinement_margin, int argc, char *argv[]);
+
+template <typename lattice>
+int run_multi_device(int slab_count, int argc, char *argv[]);
+
+// the first port the ranks of a distributed run listen on with the tcp transport, one port per rank
+const Poco::UInt16 distributed_base_port = 4100;
+
 std::string filename = "test.txt";
 int main(int argc, char *argv[])
 {
-    if(argc < 7 || argc > 7)
+    // the options for a distributed, multi device, refined, turbulent or autotuned run come before the other arguments, in any order
+    int rank_count = 0;
+    int slab_count = 0;
+    std::string transport_name = "shm";
+    int refinement_margin = 0;
+    float smagorinsky_constant = 0.0f;
+    bool autotune_mode = false;
+    bool retune = false;
+
+    while(argc > 1 && (std::string(argv[1]) == "--autotune" || std::string(argv[1]) == "--retune" || (argc > 2 && (std::string(argv[1]) == "--ranks" || std::string(argv[1]) == "--devices" || std::string(argv[1]) == "--transport" || std::string(argv[1]) == "--refine" || std::string(argv[1]) == "--smagorinsky"))))
     {
-        std::cout << "usage: " << argv[0] << " number_of_frames_to_compute sim_width sim_height sim_depth tau_value cylinder_radius" << std::endl;
+        // --autotune and --retune are the only options without a value
+        int option_length = 2;
+
+        if(std::string(argv[1]) == "--autotune") { autotune_mode = true; option_length = 1; }
+        else if(std::string(argv[1]) == "--retune") { autotune_mode = true; retune = true; option_length = 1; }
+        else if(std::string(argv[1]) == "--ranks") { rank_count = std::stoi(argv[2]); }
+        else if(std::string(argv[1]) == "--devices") { slab_count = std::stoi(argv[2]); }
+        else if(std::string(argv[1]) == "--refine") { refinement_margin = std::stoi(argv[2]); }
+        else if(std::string(argv[1]) == "--smagorinsky") { smagorinsky_constant = std::stof(argv[2]); }
+        else { transport_name = argv[2]; }
+
+        // drop the option and its value, so the rest of the arguments are where run expects them
+        argv[option_length] = argv[0];
+        argv += option_length;
+        argc -= option_length;
+    }
+
+    if(argc < 7 || argc > 8)
+    {
+        std::cout << "usage: " << argv[0] << " [--ranks number_of_processes [--transport shm|tcp]] [--devices number_of_slabs] [--refine margin] [--smagorinsky constant] [--autotune [--retune]] number_of_frames_to_compute sim_width sim_height sim_depth tau_value cylinder_radius [lattice]" << std::endl;
+        std::cout << "    lattice: d3q27 (default), d3q19, d3q15 or d2q9 (for a sim_height of 1)" << std::endl;
+        std::cout << "    --ranks: split the simulation along z between this many processes, gathered into one file" << std::endl;
+        std::cout << "    --transport: how the processes talk, shared memory (default) or tcp over the loopback interface" << std::endl;
+        std::cout << "    --devices: split the simulation along z into this many slabs in one process, spread over the devices (or the NUMA domains of the cpu)" << std::endl;
+        std::cout << "    --refine: refine the nodes within margin nodes of the cylinder to half the spacing, written resampled to a grid of half the spacing" << std::endl;
+        std::cout << "    --autotune: run a single process run with the fastest kernel mode for this device and grid, timed once and cached in " << autotune_cache_filename << " (the modes may round differently, so the file can change)" << std::endl;
+        std::cout << "    --retune: --autotune, timing the kernel modes again instead of using the cached one" << std::endl;
+        std::cout << "    --smagorinsky: model the turbulence the grid can't resolve with the smagorinsky subgrid model and this constant (0.1 to 0.2 is usual)" << std::endl;
         return 0;
     }
 
+    if(transport_name != "shm" && transport_name != "tcp")
+    {
+        std::cerr << "unknown transport: " << transport_name << std::endl;
+        return 1;
+    }
+
+    std::string lattice_name = argc == 8 ? argv[7] : "d3q27";
+
+    if(rank_count > 0 && refinement_margin > 0)
+    {
+        std::cerr << "--ranks and --refine can't be used together" << std::endl;
+        return 1;
+    }
+
+    if(slab_count > 0 && (rank_count > 0 || refinement_margin > 0 || smagorinsky_constant != 0.0f))
+    {
+        std::cerr << "--devices can't be used with --ranks, --refine or --smagorinsky" << std::endl;
+        return 1;
+    }
+
+    if(smagorinsky_constant != 0.0f && (rank_count > 0 || refinement_margin > 0))
+    {
+        std::cerr << "--smagorinsky can't be used with --ranks or --refine" << std::endl;
+        return 1;
+    }
+
+    if(autotune_mode && (rank_count > 0 || slab_count > 0 || refinement_margin > 0))
+    {
+        std::cerr << "--autotune and --retune can't be used with --ranks, --devices or --refine" << std::endl;
+        return 1;
+    }
+
+    if(refinement_margin > 0)
+    {
+        if(lattice_name == "d3q27") { return run_refined<D3Q27>(refinement_margin, argc, argv); }
+        if(lattice_name == "d3q19") { return run_refined<D3Q19>(refinement_margin, argc, argv); }
+        if(lattice_name == "d3q15") { return run_refined<D3Q15>(refinement_margin, argc, argv); }
+        if(lattice_name == "d2q9")  { return run_refined<D2Q9>(refinement_margin, argc, argv); }
+    }
+    else if(slab_count > 0)
+    {
+        if(lattice_name == "d3q27") { return run_multi_device<D3Q27>(slab_count, argc, argv); }
+        if(lattice_name == "d3q19") { return run_multi_device<D3Q19>(slab_count, argc, argv); }
+        if(lattice_name == "d3q15") { return run_multi_device<D3Q15>(slab_count, argc, argv); }
+        if(lattice_name == "d2q9")  { return run_multi_device<D2Q9>(slab_count, argc, argv); }
+    }
+    else if(rank_count > 0)
+    {
+        if(lattice_name == "d3q27") { return run_distributed<D3Q27>(rank_count, transport_name, argc, argv); }
+        if(lattice_name == "d3q19") { return run_distributed<D3Q19>(rank_count, transport_name, argc, argv); }
+        if(lattice_name == "d3q15") { return run_distributed<D3Q15>(rank_count, transport_name, argc, argv); }
+        if(lattice_name == "d2q9")  { return run_distributed<D2Q9>(rank_count, transport_name, argc, argv); }
+    }
+    else
+    {
+        if(lattice_name == "d3q27") { return run<D3Q27>(smagorinsky_constant, autotune_mode, retune, argc, argv); }
+        if(lattice_name == "d3q19") { return run<D3Q19>(smagorinsky_constant, autotune_mode, retune, argc, argv); }
+        if(lattice_name == "d3q15") { return run<D3Q15>(smagorinsky_constant, autotune_mode, retune, argc, argv); }
+        if(lattice_name == "d2q9")  { return run<D2Q9>(smagorinsky_constant, autotune_mode, retune, argc, argv); }
+    }
+
+    std::cerr << "unknown lattice: " << lattice_name << std::endl;
+    return 1;
+}
+
+template <typename lattice>
+int run(float smagorinsky_constant, bool autotune_mode, bool retune, int argc, char *argv[])
+{
     std::cout << "writing to file: " << filename << std::endl;
 
     std::ofstream file;
@@ -66,14 +216,28 @@ int main(int argc, char *argv[])
     // get the total number of frames to compute from the command line arguments
     int number_of_frames_to_compute = std::stoi(argv[1]);
 
+    // the fused mode, or the fastest kernel mode for this device and grid when autotuning
+    tuned_config config = {kernel_mode::fused, 1, 1, 1, -1.0};
+    if(autotune_mode)
+    {
+        config = autotune<lattice>(std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), std::stof(argv[6]), std::stof(argv[5]), retune);
+
+        // timing the candidates draws from rand(), start the noise from the seed rand() starts with (1),
+        // so a run gives the same file whether or not the configuration was cached
+        srand(1);
+    }
+
     // set up memory
     // initilize the simulation          unused   unused    unused          unused
     //             width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
-    Simulation sim(std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), 1.225f, 0.00001f, 343, 0.02f, std::stof(argv[6]), std::stof(argv[5]));
+    Simulation<lattice> sim(std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), 1.225f, 0.00001f, 343, 0.02f, std::stof(argv[6]), std::stof(argv[5]), config.mode);
+    config.apply(sim);
+    sim.set_smagorinsky_constant(smagorinsky_constant);
 
     sycl::range<3> temp_dims = sim.get_dimensions();
     
     std::cout << "simulation: width is " << temp_dims.get(0) << ", height is " << temp_dims.get(1) << ", depth is " << temp_dims.get(2) << "\n";
+    std::cout << "memory: " << sim.get_device_memory_bytes() / (1024 * 1024) << " MiB on the device, " << sim.get_host_memory_bytes() / (1024 * 1024) << " MiB on the host\n";
 
     // write the dimentions to the top line in the file
     file << temp_dims.get(0) << " " << temp_dims.get(1) << " " << temp_dims.get(2) << "\n"; 
@@ -112,3 +276,307 @@ int main(int argc, char *argv[])
     return 0;
 }
 
+/**
+ * the same as run, with the nodes around the cylinder refined (see RefinedSimulation),
+ * every frame is resampled to a uniform grid at the spacing of the refined nodes, so the file reads the same as a uniform run of that size
+ */
+template <typename lattice>
+int run_refined(int refinement_margin, int argc, char *argv[])
+{
+    std::cout << "writing to file: " << filename << std::endl;
+
+    std::ofstream file;
+    file.open(filename, std::ofstream::out | std::ofstream::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "file: " << filename << "could not be opened" << std::endl;
+        return 1;
+    }
+
+    int number_of_frames_to_compute = std::stoi(argv[1]);
+
+    // set up memory
+    // initilize the simulation                 unused   unused    unused          unused
+    //                    width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    RefinedSimulation<lattice> sim(std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), 1.225f, 0.00001f, 343, 0.02f, std::stof(argv[6]), std::stof(argv[5]), refinement_margin);
+
+    sycl::range<3> temp_dims = sim.get_uniform_dimensions(2);
+
+    std::cout << "written at: width is " << temp_dims.get(0) << ", height is " << temp_dims.get(1) << ", depth is " << temp_dims.get(2) << "\n";
+
+    // write the dimentions to the top line in the file
+    file << temp_dims.get(0) << " " << temp_dims.get(1) << " " << temp_dims.get(2) << "\n"; 
+
+    std::vector<uint8_t> node_types(temp_dims.size());
+    std::vector<float> density(temp_dims.size());
+    std::vector<sycl::float4> velocity(temp_dims.size());
+    std::vector<float> populations(temp_dims.size() * lattice::count);
+
+    long sec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // the same frames as run
+    for (int current_frame_number = 0; current_frame_number <= number_of_frames_to_compute + 1; current_frame_number++)
+    {
+        sim.resample(2, node_types.data(), density.data(), velocity.data(), populations.data());
+        write_gathered_to_file<lattice>(file, node_types, density, populations);
+
+        sim.next_frame();
+    }
+
+    file.close();
+
+    sec = std::chrono::duration_cast<std::chrono::milliseconds> ( std::chrono::system_clock::now().time_since_epoch() ).count() - sec;
+
+    std::cout << "\ntook " << sec / 1000.0f << " seconds\n";
+    std::cout << "\n---data written successfully---\n\n";
+
+    return 0;
+}
+
+/**
+ * the same as run, split along z into slab_count slabs in one process (see MultiDeviceSimulation),
+ * the slabs are spread over the queues of slab_queues, several slabs share a queue when there are more slabs than queues
+ */
+template <typename lattice>
+int run_multi_device(int slab_count, int argc, char *argv[])
+{
+    std::cout << "writing to file: " << filename << std::endl;
+
+    std::ofstream file;
+    file.open(filename, std::ofstream::out | std::ofstream::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "file: " << filename << "could not be opened" << std::endl;
+        return 1;
+    }
+
+    int number_of_frames_to_compute = std::stoi(argv[1]);
+
+    std::vector<sycl::queue> devices = slab_queues();
+    std::vector<sycl::queue> queues;
+    for(int slab = 0; slab < slab_count; ++slab)
+    {
+        queues.push_back(devices[slab % devices.size()]);
+    }
+
+    // set up memory
+    // initilize the simulation                     unused   unused    unused          unused
+    //                        width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    MultiDeviceSimulation<lattice> sim(std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), 1.225f, 0.00001f, 343, 0.02f, std::stof(argv[6]), std::stof(argv[5]), queues);
+
+    sycl::range<3> temp_dims = sim.get_dimensions();
+
+    std::cout << "simulation: width is " << temp_dims.get(0) << ", height is " << temp_dims.get(1) << ", depth is " << temp_dims.get(2) << ", " << sim.get_slab_count() << " slabs\n";
+
+    // write the dimentions to the top line in the file
+    file << temp_dims.get(0) << " " << temp_dims.get(1) << " " << temp_dims.get(2) << "\n"; 
+
+    std::vector<uint8_t> node_types(sim.get_node_count());
+    std::vector<float> density(sim.get_node_count());
+    std::vector<float> populations(sim.get_node_count() * lattice::count);
+
+    sim.copy_node_types_to_host(node_types.data());
+
+    long sec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // the same frames as run
+    for (int current_frame_number = 0; current_frame_number <= number_of_frames_to_compute + 1; current_frame_number++)
+    {
+        float * density_array = sim.density_array.load();
+        density.assign(density_array, density_array + sim.get_node_count());
+        sim.copy_populations_to_host(populations.data());
+
+        write_gathered_to_file<lattice>(file, node_types, density, populations);
+
+        sim.next_frame();
+    }
+
+    file.close();
+
+    sec = std::chrono::duration_cast<std::chrono::milliseconds> ( std::chrono::system_clock::now().time_since_epoch() ).count() - sec;
+
+    std::cout << "\ntook " << sec / 1000.0f << " seconds\n";
+    std::cout << "\n---data written successfully---\n\n";
+
+    return 0;
+}
+
+/**
+ * one process (rank) of a distributed run, 
+ * rank 0 gathers every frame from the others and writes it to file, opened by the launcher before the ranks were forked
+ */
+template <typename lattice>
+int run_rank(int rank, int rank_count, const std::string & transport_name, const std::string & shared_memory_name, std::ofstream & file, int argc, char *argv[])
+{
+    std::unique_ptr<Transport> transport;
+    if(transport_name == "shm")
+    {
+        transport.reset(new SharedMemoryTransport(shared_memory_name, rank, rank_count));
+    }
+    else
+    {
+        transport.reset(new TcpTransport(rank, rank_count, distributed_base_port));
+    }
+
+    // spread the ranks over the devices (or the NUMA domains of the cpu)
+    std::vector<sycl::queue> queues = slab_queues();
+
+    int number_of_frames_to_compute = std::stoi(argv[1]);
+
+    // set up memory
+    // initilize the simulation                                    unused   unused    unused          unused
+    //                                         width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    DistributedSimulation<lattice> sim(transport.get(), std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), 1.225f, 0.00001f, 343, 0.02f, std::stof(argv[6]), std::stof(argv[5]), queues[rank % queues.size()]);
+
+    sycl::range<3> temp_dims = sim.get_dimensions();
+
+    // only rank 0 holds the whole simulation
+    std::vector<uint8_t> node_types;
+    std::vector<float> density;
+    std::vector<sycl::float4> velocity;
+    std::vector<float> populations;
+
+    if(rank == 0)
+    {
+        std::cout << "simulation: width is " << temp_dims.get(0) << ", height is " << temp_dims.get(1) << ", depth is " << temp_dims.get(2) << "\n";
+
+        // write the dimentions to the top line in the file
+        file << temp_dims.get(0) << " " << temp_dims.get(1) << " " << temp_dims.get(2) << "\n"; 
+
+        node_types.resize(sim.get_node_count());
+        density.resize(sim.get_node_count());
+        velocity.resize(sim.get_node_count());
+        populations.resize(sim.get_node_count() * lattice::count);
+    }
+
+    sim.gather_node_types(node_types.data());
+
+    int current_frame_number = 0;
+
+    while(true)
+    {
+        sim.gather_macroscopic_variables(density.data(), velocity.data());
+        sim.gather_populations(populations.data());
+
+        if(rank == 0)
+        {
+            write_gathered_to_file<lattice>(file, node_types, density, populations);
+        }
+        
+        sim.next_frame();
+
+        if(current_frame_number > number_of_frames_to_compute)
+        {
+            // quit the fun loop
+            break;
+        }
+
+        ++current_frame_number;
+    }
+
+    if(rank == 0)
+    {
+        file.close();
+    }
+
+    return 0;
+}
+
+/**
+ * the launcher of a distributed run,
+ * starts rank_count processes (ranks) that each simulate one slab of the simulation, see DistributedSimulation,
+ * and waits for all of them, rank 0 writes the file
+ */
+template <typename lattice>
+int run_distributed(int rank_count, const std::string & transport_name, int argc, char *argv[])
+{
+    // opened before the ranks start, so a file that can't be opened stops the run before any rank waits on rank 0
+    std::cout << "writing to file: " << filename << std::endl;
+
+    std::ofstream file;
+    file.open(filename, std::ofstream::out | std::ofstream::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "file: " << filename << "could not be opened" << std::endl;
+        return 1;
+    }
+
+    // unique per launch, so two runs on the same machine don't share a segment
+    std::string shared_memory_name = "/water_sim_" + std::to_string(getpid());
+
+    if(transport_name == "shm")
+    {
+        SharedMemoryTransport::create(shared_memory_name, rank_count);
+    }
+
+    long sec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // the ranks are forked before anything touches sycl, so every rank sets up its own runtime
+    std::vector<pid_t> ranks;
+    for(int rank = 0; rank < rank_count; ++rank)
+    {
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            int result = 1;
+            try {
+                result = run_rank<lattice>(rank, rank_count, transport_name, shared_memory_name, file, argc, argv);
+            }
+            catch (std::exception const &e) {
+                std::cerr << "rank " << rank << ": " << e.what() << std::endl;
+            }
+            std::cout.flush();
+            _exit(result);
+        }
+
+        ranks.push_back(pid);
+    }
+
+    // the ranks wait on each other without a timeout, so once one fails the others are stopped instead of waiting forever
+    int failed_ranks = 0;
+    for(size_t finished = 0; finished < ranks.size(); ++finished)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+
+        // so the stopped ranks below are only the ones still running
+        std::replace(ranks.begin(), ranks.end(), pid, pid_t(0));
+
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            if(failed_ranks == 0)
+            {
+                for(pid_t rank : ranks)
+                {
+                    if(rank != 0)
+                    {
+                        kill(rank, SIGKILL);
+                    }
+                }
+            }
+
+            ++failed_ranks;
+        }
+    }
+
+    if(transport_name == "shm")
+    {
+        SharedMemoryTransport::remove(shared_memory_name);
+    }
+
+    if(failed_ranks > 0)
+    {
+        std::cerr << failed_ranks << " of " << rank_count << " ranks failed or were stopped after another failed" << std::endl;
+        return 1;
+    }
+
+    sec = std::chrono::duration_cast<std::chrono::milliseconds> ( std::chrono::system_clock::now().time_since_epoch() ).count() - sec;
+
+    std::cout << "\ntook " << sec / 1000.0f << " seconds\n";
+    std::cout << "\n---data written successfully---\n\n";
+
+    return 0;
+}
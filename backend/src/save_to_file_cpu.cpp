@@ -0,0 +1,107 @@
+/*
+    name: save_to_file_cpu.cpp
+
+    usecase:
+        save_to_file.cpp for the native cpu engine (cpu/cpu_simulation.hpp),
+        writes the same file from the same arguments, and builds without sycl or oneapi
+*/
+#include "cpu/cpu_simulation.hpp"
+#include "simulation_file.hpp" // write_node_to_file
+
+#include <string>
+#include <iostream>
+
+#include <fstream> // write to files
+#include <chrono> // get the time it took to run the simulation
+
+
+// the file always holds the populations of the 27 D3Q27 velocities per node, so the frontend can read any lattice,
+// the velocities the lattice does not have are written as 0
+template <typename lattice>
+void write_to_file(std::ofstream & file, CpuSimulation<lattice> & sim)
+{
+    for(int i = 0; i < sim.get_node_count(); ++i)
+    {
+        float values[D3Q27::count] = {};
+        for(uint8_t j = 0; j < lattice::count; ++j)
+        {
+            values[lattice::d3q27_index[j]] = sim.read_population(i, j);
+        }
+
+        write_node_to_file(file, sim.get_node_type(i), sim.density_array.load()[i], values);
+    }
+    file << "\n";
+}
+
+template <typename lattice>
+int run(int argc, char *argv[]);
+
+std::string filename = "test.txt";
+int main(int argc, char *argv[])
+{
+    if(argc < 7 || argc > 8)
+    {
+        std::cout << "usage: " << argv[0] << " number_of_frames_to_compute sim_width sim_height sim_depth tau_value cylinder_radius [lattice]" << std::endl;
+        std::cout << "    lattice: d3q27 (default), d3q19, d3q15 or d2q9 (for a sim_height of 1)" << std::endl;
+        return 0;
+    }
+
+    std::string lattice_name = argc == 8 ? argv[7] : "d3q27";
+
+    if(lattice_name == "d3q27") { return run<D3Q27>(argc, argv); }
+    if(lattice_name == "d3q19") { return run<D3Q19>(argc, argv); }
+    if(lattice_name == "d3q15") { return run<D3Q15>(argc, argv); }
+    if(lattice_name == "d2q9")  { return run<D2Q9>(argc, argv); }
+
+    std::cerr << "unknown lattice: " << lattice_name << std::endl;
+    return 1;
+}
+
+template <typename lattice>
+int run(int argc, char *argv[])
+{
+    std::cout << "writing to file: " << filename << std::endl;
+
+    std::ofstream file;
+    file.open(filename, std::ofstream::out | std::ofstream::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "file: " << filename << "could not be opened" << std::endl;
+        return 1;
+    }
+
+    // get the total number of frames to compute from the command line arguments
+    int number_of_frames_to_compute = std::stoi(argv[1]);
+
+    // set up memory
+    // initilize the simulation             unused   unused    unused          unused
+    //                width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    CpuSimulation<lattice> sim(std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), 1.225f, 0.00001f, 343, 0.02f, std::stof(argv[6]), std::stof(argv[5]));
+
+    cpu_range3 temp_dims = sim.get_dimensions();
+
+    std::cout << "simulation: width is " << temp_dims.get(0) << ", height is " << temp_dims.get(1) << ", depth is " << temp_dims.get(2) << "\n";
+
+    // write the dimentions to the top line in the file
+    file << temp_dims.get(0) << " " << temp_dims.get(1) << " " << temp_dims.get(2) << "\n";
+
+    long sec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // the same frames as save_to_file
+    for (int current_frame_number = 0; current_frame_number <= number_of_frames_to_compute + 1; current_frame_number++)
+    {
+        write_to_file(file, sim);
+
+        sim.next_frame();
+    }
+
+    file.close();
+
+    sec = std::chrono::duration_cast<std::chrono::milliseconds> ( std::chrono::system_clock::now().time_since_epoch() ).count() - sec;
+
+    std::cout << "\ntook " << sec / 1000.0f << " seconds\n";
+    std::cout << "\n---data written successfully---\n\n";
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+    name: autotuner.hpp
+
+    usecase:
+        picks the fastest kernel mode (and tile shape for the tiled mode) for a simulation on the device Simulation runs on,
+        by timing a short run of each candidate, the winner is kept in a cache file so later runs with the same device and grid reuse it
+
+        only the kernel modes that run the same per node step as the fused path are candidates (fused, in place, tiled, padded and bricked),
+        they load and add up the populations in different orders, so with a fast floating point model (the icpx default) they can round differently,
+        which is why save_to_file only tunes when asked to (--autotune), precision_report shows how far apart the modes are
+
+        the candidates are timed with the default layout, storage type and collision operator (aos, fp32 and bgk),
+        so the cache only holds configurations tuned for them
+
+        the cache file has one line per tuned configuration, with tab separated fields:
+            device name, width, height, depth, lattice velocity count, kernel mode, tile width, tile height, tile depth, microseconds per step
+*/
+#pragma once
+
+#include "simulation_class.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono> // time the candidates
+#include <stdexcept> // std::invalid_argument, thrown by set_tile_shape for tiles that don't fit
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+// the file the tuned configurations are kept in, in the working directory
+const std::string autotune_cache_filename = "autotune_cache.txt";
+
+/**
+ * a kernel mode and the tile shape it runs with, the tile shape is only used by the tiled mode
+ */
+struct tuned_config
+{
+    kernel_mode mode;
+    int tile_width;
+    int tile_height;
+    int tile_depth;
+
+    // the time one step took while tuning, in microseconds
+    double step_time;
+
+    /**
+     * sets the tile shape of a simulation made with this config's mode
+     */
+    template <typename simulation>
+    void apply(simulation & sim) const
+    {
+        if(this->mode == kernel_mode::tiled)
+        {
+            sim.set_tile_shape(sycl::range<3>(this->tile_width, this->tile_height, this->tile_depth));
+        }
+    }
+};
+
+/**
+ * returns the name of a kernel mode, as written to the cache file
+ */
+inline std::string kernel_mode_name(kernel_mode mode)
+{
+    switch (mode)
+    {
+    case kernel_mode::reference:        return "reference";
+    case kernel_mode::fused:            return "fused";
+    case kernel_mode::in_place:         return "in_place";
+    case kernel_mode::tiled:            return "tiled";
+    case kernel_mode::sparse:           return "sparse";
+    case kernel_mode::split_boundaries: return "split_boundaries";
+    case kernel_mode::padded:           return "padded";
+    case kernel_mode::bricked:          return "bricked";
+    }
+    return "unknown";
+}
+
+/**
+ * finds the kernel mode with the given name,
+ * returns false if there is none
+ */
+inline bool kernel_mode_from_name(const std::string & name, kernel_mode & mode)
+{
+    const kernel_mode modes[] = {kernel_mode::reference, kernel_mode::fused, kernel_mode::in_place, kernel_mode::tiled,
+                                 kernel_mode::sparse, kernel_mode::split_boundaries, kernel_mode::padded, kernel_mode::bricked};
+
+    for (kernel_mode candidate : modes)
+    {
+        if(kernel_mode_name(candidate) == name)
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * the start of the cache line of a device and grid, every field before the tuned configuration
+ */
+template <typename lattice>
+std::string autotune_cache_key(const std::string & device_name, int width, int height, int depth)
+{
+    return device_name + "\t" + std::to_string(width) + "\t" + std::to_string(height) + "\t" + std::to_string(depth) + "\t" + std::to_string(lattice::count) + "\t";
+}
+
+/**
+ * looks for the tuned configuration of a device and grid in the cache file,
+ * returns false if there is none (or no cache file)
+ */
+template <typename lattice>
+bool read_autotune_cache(const std::string & cache_filename, const std::string & device_name, int width, int height, int depth, tuned_config & config)
+{
+    std::ifstream file(cache_filename);
+
+    std::string key = autotune_cache_key<lattice>(device_name, width, height, depth);
+
+    // the last line of a key wins, so a retune only has to append
+    bool found = false;
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        if(line.compare(0, key.size(), key) != 0)
+        {
+            continue;
+        }
+
+        std::istringstream fields(line.substr(key.size()));
+
+        std::string mode_name;
+        tuned_config cached;
+        if(fields >> mode_name >> cached.tile_width >> cached.tile_height >> cached.tile_depth >> cached.step_time
+           && kernel_mode_from_name(mode_name, cached.mode))
+        {
+            config = cached;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * appends the tuned configuration of a device and grid to the cache file
+ */
+template <typename lattice>
+void write_autotune_cache(const std::string & cache_filename, const std::string & device_name, int width, int height, int depth, const tuned_config & config)
+{
+    std::ofstream file(cache_filename, std::ofstream::out | std::ofstream::app);
+
+    if(!file.is_open())
+    {
+        std::cerr << "autotune: " << cache_filename << " could not be opened, the tuned configuration won't be kept" << std::endl;
+        return;
+    }
+
+    file << autotune_cache_key<lattice>(device_name, width, height, depth)
+         << kernel_mode_name(config.mode) << "\t"
+         << config.tile_width << "\t" << config.tile_height << "\t" << config.tile_depth << "\t"
+         << config.step_time << "\n";
+}
+
+/**
+ * times warm_up_steps + timed_steps steps of a simulation made with config,
+ * returns the time of one of the timed steps in microseconds, or a negative time if the config can't run on the device
+ *
+ * the simulation draws its starting noise from rand(), so this moves the rand() stream on
+ */
+template <typename lattice>
+double time_config(const tuned_config & config, int width, int height, int depth, float cyc_radius, float tau, int warm_up_steps, int timed_steps)
+{
+    //                                              unused   unused    unused          unused
+    //                      width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    Simulation<lattice> sim(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, cyc_radius, tau, config.mode);
+
+    try
+    {
+        config.apply(sim);
+    }
+    catch (std::invalid_argument const &e)
+    {
+        return -1.0;
+    }
+
+    // the first steps pay for compiling and loading the kernels
+    for(int step = 0; step < warm_up_steps; ++step)
+    {
+        sim.next_frame();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(int step = 0; step < timed_steps; ++step)
+    {
+        sim.next_frame();
+    }
+
+    auto done = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(done - start).count() / timed_steps;
+}
+
+/**
+ * returns the fastest configuration for a simulation of the given size on the device Simulation runs on (see simulation_device),
+ * from the cache file if it has one for the device and grid, otherwise timing every candidate and adding the winner to the cache file
+ *
+ * retune: time the candidates even if the cache file has a configuration, replacing it
+ *
+ * timing the candidates draws from rand() (see time_config), so a caller that wants the same starting noise
+ * whether or not the cache had a configuration should seed rand() after this returns
+ */
+template <typename lattice>
+tuned_config autotune(int width, int height, int depth, float cyc_radius, float tau, bool retune = false,
+                      const std::string & cache_filename = autotune_cache_filename, int warm_up_steps = 3, int timed_steps = 10)
+{
+    std::string device_name = simulation_device().get_info<sycl::info::device::name>();
+
+    tuned_config best = {kernel_mode::fused, 1, 1, 1, -1.0};
+
+    if(!retune && read_autotune_cache<lattice>(cache_filename, device_name, width, height, depth, best))
+    {
+        std::cout << "autotune: using the cached " << kernel_mode_name(best.mode) << " mode for " << device_name << std::endl;
+        return best;
+    }
+
+    std::vector<tuned_config> candidates = {
+        {kernel_mode::fused, 1, 1, 1, 0.0},
+        {kernel_mode::in_place, 1, 1, 1, 0.0},
+        {kernel_mode::padded, 1, 1, 1, 0.0},
+        {kernel_mode::bricked, 1, 1, 1, 0.0},
+    };
+
+    // the tile shapes of the tiled mode, cut down to the size of the simulation, skipping the ones that end up the same
+    const int tile_shapes[][3] = {{4, 4, 4}, {8, 4, 4}, {8, 8, 4}, {8, 8, 8}, {16, 4, 4}, {16, 8, 2}, {32, 4, 2}};
+    for (const auto & shape : tile_shapes)
+    {
+        tuned_config tiled = {kernel_mode::tiled, std::min(shape[0], width), std::min(shape[1], height), std::min(shape[2], depth), 0.0};
+
+        bool seen = false;
+        for (const tuned_config & candidate : candidates)
+        {
+            seen = seen || (candidate.mode == kernel_mode::tiled && candidate.tile_width == tiled.tile_width
+                            && candidate.tile_height == tiled.tile_height && candidate.tile_depth == tiled.tile_depth);
+        }
+
+        if(!seen)
+        {
+            candidates.push_back(tiled);
+        }
+    }
+
+    std::cout << "autotune: timing " << candidates.size() << " configurations on " << device_name << std::endl;
+
+    for (tuned_config & candidate : candidates)
+    {
+        candidate.step_time = time_config<lattice>(candidate, width, height, depth, cyc_radius, tau, warm_up_steps, timed_steps);
+
+        if(candidate.step_time < 0.0)
+        {
+            continue;
+        }
+
+        std::cout << "autotune: " << kernel_mode_name(candidate.mode);
+        if(candidate.mode == kernel_mode::tiled)
+        {
+            std::cout << " " << candidate.tile_width << "x" << candidate.tile_height << "x" << candidate.tile_depth;
+        }
+        std::cout << ", " << candidate.step_time << " us per step" << std::endl;
+
+        if(best.step_time < 0.0 || candidate.step_time < best.step_time)
+        {
+            best = candidate;
+        }
+    }
+
+    // the fused mode always runs, so there is a best config
+    write_autotune_cache<lattice>(cache_filename, device_name, width, height, depth, best);
+
+    std::cout << "autotune: picked the " << kernel_mode_name(best.mode) << " mode" << std::endl;
+
+    return best;
+}
@@ -0,0 +1,291 @@
+/*
+    name: collision_operators.hpp
+
+    usecase:
+        the collision operators the fluid nodes can use,
+        passed to the Simulation class as a template parameter so the choice is made at compile time
+
+        each collision operator provides:
+            collide<lattice>(populations, collided, tau, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z, parameters)
+                -> relaxes the (already streamed) populations of one fluid node towards the equilibrium into collided
+
+        where tau is the relaxation rate the simulation is made with, (f - tau * (f - f_eq)) for bgk_collision,
+        and parameters holds the settings that can change between frames, see collision_parameters
+
+        all three keep the density and velocity of the node and relax the viscous stress at tau, so they model the same fluid,
+        they differ in what happens to the rest of the non equilibrium part of the populations,
+        which bgk_collision keeps relaxing at tau, and is what goes unstable first as tau gets close to 2 (low viscosity),
+        see stability_report.cpp for how close each one gets
+
+    see:
+        Latt and Chopard, "Lattice Boltzmann method with regularized pre-collision distribution functions", for regularized_collision
+        Hou et al., "A lattice Boltzmann subgrid model for high Reynolds number flows", for smagorinsky_rate
+        Krüger et al., "The Lattice Boltzmann Method: Principles and Practice", sections 10.4 and 10.5, for the moments mrt_collision relaxes
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+// the equilibrium populations, defined in simulation_class.hpp
+inline float f_eq(float weight, float density, float velocity_i_x, float velocity_i_y, float velocity_i_z, float macro_velocity_x, float macro_velocity_y, float macro_velocity_z);
+
+/**
+ * the settings of the collision operators that can change between any two frames, see Simulation::set_smagorinsky_constant and set_mrt_rates
+ *
+ * smagorinsky_constant turns on the smagorinsky subgrid model when above 0, see smagorinsky_rate, every operator uses it,
+ * bulk_rate and ghost_rate are the relaxation rates of the bulk and ghost moments of mrt_collision, the other operators ignore them
+ */
+struct collision_parameters
+{
+    float smagorinsky_constant = 0.0f;
+
+    float bulk_rate = 1.0f;
+    float ghost_rate = 1.0f;
+};
+
+/**
+ * returns the number of axes any velocity of the lattice moves along, 2 for D2Q9 and 3 for the others
+ */
+template <typename lattice>
+constexpr int lattice_dimensions()
+{
+    int dimensions = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        bool moves = false;
+        for (int i = 0; i < lattice::count; i++)
+        {
+            moves = moves || lattice::possible_velocities[i * 3 + axis] != 0;
+        }
+        dimensions += moves ? 1 : 0;
+    }
+    return dimensions;
+}
+
+/**
+ * the second order hermite moments of the non equilibrium populations (the non equilibrium stress)
+ *
+ * non_equilibrium[i] = populations[i] - f_eq_i, and the stress is the sum of non_equilibrium[i] * e_i * e_i,
+ * stored as xx, yy, zz, xy, xz, yz
+ */
+template <typename lattice>
+inline void non_equilibrium_stress(const float * non_equilibrium, float * stress)
+{
+    #pragma unroll
+    for (int j = 0; j < 6; j++)
+    {
+        stress[j] = 0.0f;
+    }
+
+    #pragma unroll
+    for (uint8_t i = 0; i < lattice::count; i++)
+    {
+        float e_x = lattice::possible_velocities[i * 3];
+        float e_y = lattice::possible_velocities[i * 3 + 1];
+        float e_z = lattice::possible_velocities[i * 3 + 2];
+
+        stress[0] += non_equilibrium[i] * e_x * e_x;
+        stress[1] += non_equilibrium[i] * e_y * e_y;
+        stress[2] += non_equilibrium[i] * e_z * e_z;
+        stress[3] += non_equilibrium[i] * e_x * e_y;
+        stress[4] += non_equilibrium[i] * e_x * e_z;
+        stress[5] += non_equilibrium[i] * e_y * e_z;
+    }
+}
+
+/**
+ * returns the part of population i that the stress accounts for, w_i / (2 c_s^4) * (e_i e_i - c_s^2 I) : stress
+ */
+template <typename lattice>
+inline float stress_population(uint8_t i, const float * stress)
+{
+    float e_x = lattice::possible_velocities[i * 3];
+    float e_y = lattice::possible_velocities[i * 3 + 1];
+    float e_z = lattice::possible_velocities[i * 3 + 2];
+
+    // c_s^2 is 1 / 3
+    float contraction = (e_x * e_x - 1.0f / 3.0f) * stress[0]
+                      + (e_y * e_y - 1.0f / 3.0f) * stress[1]
+                      + (e_z * e_z - 1.0f / 3.0f) * stress[2]
+                      + 2.0f * (e_x * e_y * stress[3] + e_x * e_z * stress[4] + e_y * e_z * stress[5]);
+
+    return lattice::velocities_weights[i] * 4.5f * contraction;
+}
+
+/**
+ * returns the relaxation rate of the viscous stress of a node with the smagorinsky subgrid model,
+ * which adds the eddy viscosity (smagorinsky_constant * node size)^2 * |S| of the scales the grid can't resolve to the viscosity tau sets
+ *
+ * the strain rate S of the node is proportional to its non equilibrium stress, so it is found from the populations the node already has,
+ * solving for the relaxation time 1 / rate gives (1 / tau + sqrt(1 / tau^2 + 18 sqrt(2) smagorinsky_constant^2 |stress| / density)) / 2,
+ * in lattice units (node size and time step of 1)
+ */
+inline float smagorinsky_rate(float tau, float smagorinsky_constant, float node_density, const float * stress)
+{
+    // |stress| = sqrt(stress : stress), the off diagonal terms appear twice in the full tensor
+    float stress_norm = sycl::sqrt(stress[0] * stress[0] + stress[1] * stress[1] + stress[2] * stress[2]
+                                   + 2.0f * (stress[3] * stress[3] + stress[4] * stress[4] + stress[5] * stress[5]));
+
+    float relaxation_time = 1.0f / tau;
+    float turbulent_relaxation_time = 0.5f * (relaxation_time + sycl::sqrt(relaxation_time * relaxation_time
+                                      + 18.0f * sycl::sqrt(2.0f) * smagorinsky_constant * smagorinsky_constant * stress_norm / node_density));
+
+    return 1.0f / turbulent_relaxation_time;
+}
+
+/**
+ * single relaxation time (BGK), every population relaxes towards its equilibrium at tau
+ */
+struct bgk_collision
+{
+    template <typename lattice>
+    static inline void collide(const float * populations, float * collided,
+                               float tau, float node_density, float macro_velocity_x, float macro_velocity_y, float macro_velocity_z,
+                               const collision_parameters & parameters)
+    {
+        float equlibrium_densities[lattice::count];
+
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            equlibrium_densities[i] = f_eq
+            (
+                lattice::velocities_weights[i], node_density,
+                lattice::possible_velocities[i * 3],
+                lattice::possible_velocities[i * 3 + 1],
+                lattice::possible_velocities[i * 3 + 2],
+                macro_velocity_x, macro_velocity_y, macro_velocity_z
+            );
+        }
+
+        float rate = tau;
+        if (parameters.smagorinsky_constant > 0.0f)
+        {
+            float non_equilibrium[lattice::count];
+
+            #pragma unroll
+            for (uint8_t i = 0; i < lattice::count; i++)
+            {
+                non_equilibrium[i] = populations[i] - equlibrium_densities[i];
+            }
+
+            float stress[6];
+            non_equilibrium_stress<lattice>(non_equilibrium, stress);
+            rate = smagorinsky_rate(tau, parameters.smagorinsky_constant, node_density, stress);
+        }
+
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            collided[i] = populations[i] - (rate * (populations[i] - equlibrium_densities[i]));
+        }
+    }
+};
+
+/**
+ * regularized BGK, the non equilibrium part of the populations is replaced by the part the non equilibrium stress accounts for
+ * before relaxing at tau, the higher order (ghost) moments that don't take part in the flow are dropped every step
+ */
+struct regularized_collision
+{
+    template <typename lattice>
+    static inline void collide(const float * populations, float * collided,
+                               float tau, float node_density, float macro_velocity_x, float macro_velocity_y, float macro_velocity_z,
+                               const collision_parameters & parameters)
+    {
+        float equlibrium_densities[lattice::count];
+        float non_equilibrium[lattice::count];
+
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            equlibrium_densities[i] = f_eq
+            (
+                lattice::velocities_weights[i], node_density,
+                lattice::possible_velocities[i * 3],
+                lattice::possible_velocities[i * 3 + 1],
+                lattice::possible_velocities[i * 3 + 2],
+                macro_velocity_x, macro_velocity_y, macro_velocity_z
+            );
+            non_equilibrium[i] = populations[i] - equlibrium_densities[i];
+        }
+
+        float stress[6];
+        non_equilibrium_stress<lattice>(non_equilibrium, stress);
+
+        float rate = parameters.smagorinsky_constant > 0.0f ? smagorinsky_rate(tau, parameters.smagorinsky_constant, node_density, stress) : tau;
+
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            collided[i] = equlibrium_densities[i] + (1.0f - rate) * stress_population<lattice>(i, stress);
+        }
+    }
+};
+
+/**
+ * multiple relaxation times, on the hermite moments of the populations, so it works on every lattice
+ *
+ * the non equilibrium part of the populations is split into three, each relaxing at its own rate:
+ *      the traceless (shear) stress        -> tau (or the smagorinsky rate), which sets the viscosity, the same as bgk_collision
+ *      the trace of the stress (bulk)      -> parameters.bulk_rate, which sets the bulk viscosity and damps pressure waves
+ *      everything else (ghost moments)     -> parameters.ghost_rate, moments that don't take part in the flow
+ *
+ * both rates are 1 by default, set with Simulation::set_mrt_rates,
+ * with bulk_rate and ghost_rate equal to tau this is bgk_collision,
+ * with bulk_rate equal to tau and ghost_rate equal to 1 it's regularized_collision
+ */
+struct mrt_collision
+{
+    template <typename lattice>
+    static inline void collide(const float * populations, float * collided,
+                               float tau, float node_density, float macro_velocity_x, float macro_velocity_y, float macro_velocity_z,
+                               const collision_parameters & parameters)
+    {
+        constexpr float dimensions = lattice_dimensions<lattice>();
+
+        float equlibrium_densities[lattice::count];
+        float non_equilibrium[lattice::count];
+
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            equlibrium_densities[i] = f_eq
+            (
+                lattice::velocities_weights[i], node_density,
+                lattice::possible_velocities[i * 3],
+                lattice::possible_velocities[i * 3 + 1],
+                lattice::possible_velocities[i * 3 + 2],
+                macro_velocity_x, macro_velocity_y, macro_velocity_z
+            );
+            non_equilibrium[i] = populations[i] - equlibrium_densities[i];
+        }
+
+        float stress[6];
+        non_equilibrium_stress<lattice>(non_equilibrium, stress);
+
+        float rate = parameters.smagorinsky_constant > 0.0f ? smagorinsky_rate(tau, parameters.smagorinsky_constant, node_density, stress) : tau;
+
+        // the trace spread evenly over the axes the lattice moves along
+        float bulk_stress = (stress[0] + stress[1] + stress[2]) / dimensions;
+
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            float e_x = lattice::possible_velocities[i * 3];
+            float e_y = lattice::possible_velocities[i * 3 + 1];
+            float e_z = lattice::possible_velocities[i * 3 + 2];
+
+            float stress_part = stress_population<lattice>(i, stress);
+            float bulk_part = lattice::velocities_weights[i] * 4.5f * bulk_stress * (e_x * e_x + e_y * e_y + e_z * e_z - dimensions / 3.0f);
+            float ghost_part = non_equilibrium[i] - stress_part;
+
+            collided[i] = equlibrium_densities[i]
+                        + (1.0f - rate) * (stress_part - bulk_part)
+                        + (1.0f - parameters.bulk_rate) * bulk_part
+                        + (1.0f - parameters.ghost_rate) * ghost_part;
+        }
+    }
+};
@@ -0,0 +1,234 @@
+/*
+    name: distributed_simulation.hpp
+
+    usecase:
+        the same simulation as the Simulation class (simulation_class.hpp), split along z between several processes (ranks),
+        each rank owns one slab (see simulation_slab.hpp) on its own device,
+        and sends the populations leaving its slab to the ranks above and below it every step through a Transport (see distributed/transport.hpp),
+        so a simulation can use the memory and bandwidth of more than one machine
+
+        every rank makes a DistributedSimulation with the same arguments and calls next_frame the same number of times,
+        the gather functions collect the whole simulation on rank 0, every rank has to call them in the same order
+
+        the ranks run the same per node step as the fused kernel of the Simulation class
+*/
+#pragma once
+
+#include <iostream> // used for debugging via std out
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <vector>
+#include <algorithm> // std::copy
+#include <cstdlib> // rand, for the starting noise
+#include <stdexcept> // std::invalid_argument, thrown when there are more ranks than layers
+
+#include "simulation_slab.hpp" // one z-slab of the simulation
+#include "../distributed/transport.hpp" // how the ranks talk to each other
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+template <typename lattice = D3Q27, typename layout = aos_layout, typename storage = fp32_storage>
+class DistributedSimulation
+{
+    private:
+        int width;  // simulation width in number of nodes
+        int height; // simulation height in number of nodes
+        int depth;  // simulation depth in number of nodes
+
+        // the number of discrete velocities per node, see lattices.hpp
+        static constexpr uint8_t possible_velocities_number = lattice::count;
+
+        Transport * transport;
+
+        // this rank's slab, and the ranks owning the slabs below and above it,
+        // the simulation wraps around along z so the first and last rank are neighbours
+        SimulationSlab<lattice, layout, storage> * slab;
+        int rank_below;
+        int rank_above;
+
+        // the populations leaving this slab, and the ones coming into it, see SimulationSlab::read_send_layers
+        std::vector<typename storage::type> sent_below;
+        std::vector<typename storage::type> sent_above;
+        std::vector<typename storage::type> received_below;
+        std::vector<typename storage::type> received_above;
+
+        // the macroscopic variables of this rank's slab
+        float * density_array;
+        sycl::float4 * vector_array; // the velocity of each node, with its density in w
+
+    public:
+
+    // the same arguments as the Simulation class,
+    // transport: connects this rank to the others, the slabs are split between transport->get_size() ranks
+    // q: the queue this rank's slab runs on
+    DistributedSimulation(Transport * transport, int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau, sycl::queue q = sycl::queue())
+    {
+        this->width = width;
+        this->height = height;
+        this->depth = depth;
+        this->transport = transport;
+
+        int rank = transport->get_rank();
+        int rank_count = transport->get_size();
+
+        if(rank_count > depth)
+        {
+            throw std::invalid_argument("DistributedSimulation: more ranks than layers to split between them");
+        }
+
+        this->rank_below = (rank + rank_count - 1) % rank_count;
+        this->rank_above = (rank + 1) % rank_count;
+
+        int first_z = slab_first_layer(rank, rank_count, depth);
+        int layer_count = slab_depth(rank, rank_count, depth);
+
+        uint64_t layer_node_count = width * height;
+
+        std::cout << "rank " << rank << " of " << rank_count << " (layers " << first_z << " to " << first_z + layer_count - 1 << ") running on -> "
+                  << q.get_device().template get_info<sycl::info::device::name>() << std::endl;
+
+        // every rank draws the noise of the layers before its own as well,
+        // so the slabs start from the same populations as the Simulation class
+        for (uint64_t i = 0; i < first_z * layer_node_count * possible_velocities_number; i++)
+        {
+            rand();
+        }
+
+        // the weights plus a bit of random noise, in node order
+        std::vector<float> initial_populations(layer_node_count * layer_count * possible_velocities_number);
+        for (uint64_t i = 0; i < initial_populations.size(); i++)
+        {
+            initial_populations[i] = lattice::velocities_weights[i % possible_velocities_number] + (rand() % 100) / 1000.0f; // + 0.00, 0.01, 0.02, to 0.99f
+        }
+
+        this->slab = new SimulationSlab<lattice, layout, storage>(q, width, height, depth, first_z, layer_count, cyc_radius, tau, initial_populations.data());
+
+        this->sent_below.resize(layer_node_count * SimulationSlab<lattice, layout, storage>::get_down_count());
+        this->sent_above.resize(layer_node_count * SimulationSlab<lattice, layout, storage>::get_up_count());
+        this->received_below.resize(layer_node_count * SimulationSlab<lattice, layout, storage>::get_up_count());
+        this->received_above.resize(layer_node_count * SimulationSlab<lattice, layout, storage>::get_down_count());
+
+        this->density_array = new float[this->slab->get_node_count()];
+        this->vector_array = new sycl::float4[this->slab->get_node_count()];
+
+        this->slab->copy_macroscopic_variables_to_host(this->density_array, this->vector_array);
+        this->slab->wait();
+    }
+
+    ~DistributedSimulation()
+    {
+        // waits for the slab's copies into the host arrays
+        delete this->slab;
+
+        delete[] this->density_array;
+        delete[] this->vector_array;
+    }
+
+    DistributedSimulation(const DistributedSimulation &) = delete;
+    DistributedSimulation & operator=(const DistributedSimulation &) = delete;
+
+    /**
+     * calculate the next state of the simulation,
+     * the same step as Simulation::next_frame, with the halos exchanged while the slab's interior computes
+     */
+    void next_frame()
+    {
+        this->slab->submit_interior();
+
+        this->slab->read_send_layers(this->sent_below.data(), this->sent_above.data());
+
+        if(this->transport->get_size() == 1)
+        {
+            // the only slab is its own neighbour
+            this->slab->write_halo_layers(this->sent_above.data(), this->sent_below.data());
+        }
+        else
+        {
+            // everything moving up first, then everything moving down,
+            // with two ranks the rank below is also the rank above, the order keeps the two apart
+            this->transport->exchange(this->rank_above, this->sent_above.data(), this->sent_above.size() * sizeof(typename storage::type),
+                                      this->rank_below, this->received_below.data(), this->received_below.size() * sizeof(typename storage::type));
+
+            this->transport->exchange(this->rank_below, this->sent_below.data(), this->sent_below.size() * sizeof(typename storage::type),
+                                      this->rank_above, this->received_above.data(), this->received_above.size() * sizeof(typename storage::type));
+
+            this->slab->write_halo_layers(this->received_below.data(), this->received_above.data());
+        }
+
+        this->slab->submit_boundary();
+        this->slab->finish_step();
+
+        this->slab->copy_macroscopic_variables_to_host(this->density_array, this->vector_array);
+        this->slab->wait();
+    }
+
+    // collects the macroscopic density and velocity of every node on rank 0, in node order, the velocity has the density of the node in w,
+    // the arguments are only used on rank 0
+    void gather_macroscopic_variables(float * density, sycl::float4 * velocity)
+    {
+        gather(this->density_array, density, 1);
+        gather(this->vector_array, velocity, 1);
+    }
+
+    // collects the populations of every node as floats on rank 0, in node order, possible_velocities_number per node,
+    // the argument is only used on rank 0
+    void gather_populations(float * populations)
+    {
+        std::vector<float> slab_populations(this->slab->get_node_count() * possible_velocities_number);
+        this->slab->copy_populations_to_host(slab_populations.data());
+
+        gather(slab_populations.data(), populations, possible_velocities_number);
+    }
+
+    // collects the node types (the changeable_buffer values) of every node on rank 0, in node order, the argument is only used on rank 0
+    void gather_node_types(uint8_t * node_types)
+    {
+        std::vector<uint8_t> slab_node_types(this->slab->get_node_count());
+        this->slab->copy_node_types_to_host(slab_node_types.data());
+
+        gather(slab_node_types.data(), node_types, 1);
+    }
+
+    // returns the number of this process
+    int get_rank()
+    {
+        return this->transport->get_rank();
+    }
+
+    // returns a copy of the dimensions of the whole simulation as a 3 dimensional sycl::range object
+    sycl::range<3> get_dimensions()
+    {
+        return sycl::range<3>(this->width, this->height, this->depth);
+    }
+
+    // returns the number of nodes in the whole simulation
+    int get_node_count()
+    {
+        return this->width * this->height * this->depth;
+    }
+
+    private:
+
+    // collects values_per_node values per node of every rank's slab into destination on rank 0
+    template <typename T>
+    void gather(const T * slab_values, T * destination, uint64_t values_per_node)
+    {
+        int rank_count = this->transport->get_size();
+        uint64_t layer_values = this->width * this->height * values_per_node;
+
+        if(this->transport->get_rank() != 0)
+        {
+            this->transport->send(0, slab_values, this->slab->get_node_count() * values_per_node * sizeof(T));
+            return;
+        }
+
+        // rank 0 owns the first slab
+        std::copy(slab_values, slab_values + this->slab->get_node_count() * values_per_node, destination);
+
+        for (int rank = 1; rank < rank_count; rank++)
+        {
+            T * rank_destination = destination + slab_first_layer(rank, rank_count, this->depth) * layer_values;
+
+            this->transport->receive(rank, rank_destination, slab_depth(rank, rank_count, this->depth) * layer_values * sizeof(T));
+        }
+    }
+};
@@ -0,0 +1,47 @@
+/*
+    name: initial_geometry.hpp
+
+    usecase:
+        the boundary node types (changeable_buffer values) every simulation starts with,
+        shared by the sycl simulations and the native cpu engine (see cpu/cpu_simulation.hpp), so it doesn't include sycl
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+
+/**
+ * returns the changeable_buffer value a node starts with
+ * 
+ * currently a cylinder aligned along the y axis with radius r with the center at (width / 2), y, (depth / 6),
+ * with an in flow at the front (z = 0) and a sink at the back (z = depth - 1)
+ */
+inline uint8_t initial_node_type(int node_x, int node_y, int node_z, int width, int height, int depth, float cyc_radius)
+{
+    uint8_t node_type = 0;
+
+    float r_square = cyc_radius * cyc_radius;
+
+    float x = node_x - (width / 2.0f);
+    float z = node_z - (depth / 6.0f);
+
+    if( x*x + z*z < r_square )
+    {
+        node_type = 1;
+    }
+
+    if(node_x == 0 || node_x == width - 1)
+    {
+        // node_type = 1;
+    }
+    
+    if(node_z == 0)
+    {
+        node_type = 2;
+    }
+    if(node_z == depth - 1)
+    {
+        node_type = 3;
+    }
+
+    return node_type;
+}
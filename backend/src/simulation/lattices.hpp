@@ -0,0 +1,288 @@
+/*
+    name: lattices.hpp
+
+    usecase:
+        the velocity sets (lattices) the simulation can use,
+        passed to the Simulation class as a template parameter so the tables are known at compile time
+
+        each lattice provides:
+            count                   -> the number of discrete velocities per node
+            possible_velocities     -> the velocities stored in sequential groups of three (x, y, z), sorted from highest weight to lowest weight
+            velocities_weights      -> the weight of each velocity, they add up to 1
+            relective_index_table   -> the index of the velocity pointing the opposite way, used for reflective (bounce back) boundaries
+            d3q27_index             -> the index of the same velocity in D3Q27,
+                                       used to write every lattice to the same file format
+
+    see:
+        Krüger et al., "The Lattice Boltzmann Method: Principles and Practice", section 3.4.7, for the velocity sets and weights
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+
+/**
+ * 3 dimensional, 27 discrete velocities
+ * the rest velocity, the 6 unit vectors, the 12 plane corners and the 8 3d corners
+ */
+struct D3Q27
+{
+    static constexpr uint8_t count = 27;
+
+    // each componenet has a min value of -128, max value of 127
+    static constexpr int8_t possible_velocities[count * 3] = {
+// vec #     value         dir      name
+/* 0 */      0,  0,  0, //          origin
+
+/* 1 */      1,  0,  0, // x+       unit vectors
+/* 2 */      0,  1,  0, //    y+
+/* 3 */      0,  0,  1, //       z+
+/* 4 */     -1,  0,  0, // x-       inverse unit vectors
+/* 5 */      0, -1,  0, //    y-
+/* 6 */      0,  0, -1, //       z-
+
+/* 7  */     1,  1,  0, // x+ y+    xy plane corners
+/* 8  */    -1,  1,  0, // x- y+
+/* 9  */     1, -1,  0, // x+ y-
+/* 10 */    -1, -1,  0, // x- y-
+/* 11 */     0,  1,  1, //    y+ z+ yz plane corners
+/* 12 */     0, -1,  1, //    y- z+
+/* 13 */     0,  1, -1, //    y+ z-
+/* 14 */     0, -1, -1, //    y- z-
+/* 15 */     1,  0,  1, // x+    z+ xz plane corners
+/* 16 */    -1,  0,  1, // x-    z+
+/* 17 */     1,  0, -1, // x+    z-
+/* 18 */    -1,  0, -1, // x-    z-
+
+/* 19 */     1,  1,  1, // x+ y+ z+ 3d corners
+/* 20 */     1,  1, -1, // x+ y+ z-
+/* 21 */     1, -1,  1, // x+ y- z+
+/* 22 */     1, -1, -1, // x+ y- z-
+/* 23 */    -1,  1,  1, // x- y+ z+
+/* 24 */    -1,  1, -1, // x- y+ z-
+/* 25 */    -1, -1,  1, // x- y- z+
+/* 26 */    -1, -1, -1, // x- y- z-
+    };
+
+    static constexpr float velocities_weights[count] = {
+        8.0f / 27.0f, // for 1, (8 / 27)
+
+        2.0f / 27.0f, // for 6, (2 / 27)
+        2.0f / 27.0f,
+        2.0f / 27.0f,
+        2.0f / 27.0f,
+        2.0f / 27.0f,
+        2.0f / 27.0f,
+
+        1.0f / 54.0f, // for 12, (1 / 54)
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+        1.0f / 54.0f,
+
+        1.0f / 216.0f, // for 8, (1 / 216)
+        1.0f / 216.0f,
+        1.0f / 216.0f,
+        1.0f / 216.0f,
+        1.0f / 216.0f,
+        1.0f / 216.0f,
+        1.0f / 216.0f,
+        1.0f / 216.0f,
+    };
+
+    static constexpr uint8_t relective_index_table[count] = {
+        0,
+        4, 5, 6, 1, 2, 3,
+        10, 9, 8, 7, 14, 13, 12, 11, 18, 17, 16, 15,
+        26, 25, 24, 23, 22, 21, 20, 19
+    };
+
+    static constexpr uint8_t d3q27_index[count] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+        14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26
+    };
+};
+
+/**
+ * 3 dimensional, 19 discrete velocities
+ * D3Q27 without the 8 3d corners, moves 30% less data per node
+ */
+struct D3Q19
+{
+    static constexpr uint8_t count = 19;
+
+    static constexpr int8_t possible_velocities[count * 3] = {
+/* 0 */      0,  0,  0, //          origin
+
+/* 1 */      1,  0,  0, // x+       unit vectors
+/* 2 */      0,  1,  0, //    y+
+/* 3 */      0,  0,  1, //       z+
+/* 4 */     -1,  0,  0, // x-       inverse unit vectors
+/* 5 */      0, -1,  0, //    y-
+/* 6 */      0,  0, -1, //       z-
+
+/* 7  */     1,  1,  0, // x+ y+    xy plane corners
+/* 8  */    -1,  1,  0, // x- y+
+/* 9  */     1, -1,  0, // x+ y-
+/* 10 */    -1, -1,  0, // x- y-
+/* 11 */     0,  1,  1, //    y+ z+ yz plane corners
+/* 12 */     0, -1,  1, //    y- z+
+/* 13 */     0,  1, -1, //    y+ z-
+/* 14 */     0, -1, -1, //    y- z-
+/* 15 */     1,  0,  1, // x+    z+ xz plane corners
+/* 16 */    -1,  0,  1, // x-    z+
+/* 17 */     1,  0, -1, // x+    z-
+/* 18 */    -1,  0, -1, // x-    z-
+    };
+
+    static constexpr float velocities_weights[count] = {
+        1.0f / 3.0f,  // for 1, (1 / 3)
+
+        1.0f / 18.0f, // for 6, (1 / 18)
+        1.0f / 18.0f,
+        1.0f / 18.0f,
+        1.0f / 18.0f,
+        1.0f / 18.0f,
+        1.0f / 18.0f,
+
+        1.0f / 36.0f, // for 12, (1 / 36)
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+    };
+
+    static constexpr uint8_t relective_index_table[count] = {
+        0,
+        4, 5, 6, 1, 2, 3,
+        10, 9, 8, 7, 14, 13, 12, 11, 18, 17, 16, 15
+    };
+
+    static constexpr uint8_t d3q27_index[count] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+        14, 15, 16, 17, 18
+    };
+};
+
+/**
+ * 3 dimensional, 15 discrete velocities
+ * the rest velocity, the 6 unit vectors and the 8 3d corners
+ */
+struct D3Q15
+{
+    static constexpr uint8_t count = 15;
+
+    static constexpr int8_t possible_velocities[count * 3] = {
+/* 0 */      0,  0,  0, //          origin
+
+/* 1 */      1,  0,  0, // x+       unit vectors
+/* 2 */      0,  1,  0, //    y+
+/* 3 */      0,  0,  1, //       z+
+/* 4 */     -1,  0,  0, // x-       inverse unit vectors
+/* 5 */      0, -1,  0, //    y-
+/* 6 */      0,  0, -1, //       z-
+
+/* 7  */     1,  1,  1, // x+ y+ z+ 3d corners
+/* 8  */     1,  1, -1, // x+ y+ z-
+/* 9  */     1, -1,  1, // x+ y- z+
+/* 10 */     1, -1, -1, // x+ y- z-
+/* 11 */    -1,  1,  1, // x- y+ z+
+/* 12 */    -1,  1, -1, // x- y+ z-
+/* 13 */    -1, -1,  1, // x- y- z+
+/* 14 */    -1, -1, -1, // x- y- z-
+    };
+
+    static constexpr float velocities_weights[count] = {
+        2.0f / 9.0f,  // for 1, (2 / 9)
+
+        1.0f / 9.0f,  // for 6, (1 / 9)
+        1.0f / 9.0f,
+        1.0f / 9.0f,
+        1.0f / 9.0f,
+        1.0f / 9.0f,
+        1.0f / 9.0f,
+
+        1.0f / 72.0f, // for 8, (1 / 72)
+        1.0f / 72.0f,
+        1.0f / 72.0f,
+        1.0f / 72.0f,
+        1.0f / 72.0f,
+        1.0f / 72.0f,
+        1.0f / 72.0f,
+        1.0f / 72.0f,
+    };
+
+    static constexpr uint8_t relective_index_table[count] = {
+        0,
+        4, 5, 6, 1, 2, 3,
+        14, 13, 12, 11, 10, 9, 8, 7
+    };
+
+    static constexpr uint8_t d3q27_index[count] = {
+        0, 1, 2, 3, 4, 5, 6,
+        19, 20, 21, 22, 23, 24, 25, 26
+    };
+};
+
+/**
+ * 2 dimensional, 9 discrete velocities
+ *
+ * lies in the x z plane, the plane the cylinder and the in/out flow of the simulation are in,
+ * so a 2d run is a simulation with a height of 1
+ */
+struct D2Q9
+{
+    static constexpr uint8_t count = 9;
+
+    static constexpr int8_t possible_velocities[count * 3] = {
+/* 0 */      0,  0,  0, //          origin
+
+/* 1 */      1,  0,  0, // x+       unit vectors
+/* 2 */      0,  0,  1, //       z+
+/* 3 */     -1,  0,  0, // x-       inverse unit vectors
+/* 4 */      0,  0, -1, //       z-
+
+/* 5 */      1,  0,  1, // x+    z+ xz plane corners
+/* 6 */     -1,  0,  1, // x-    z+
+/* 7 */      1,  0, -1, // x+    z-
+/* 8 */     -1,  0, -1, // x-    z-
+    };
+
+    static constexpr float velocities_weights[count] = {
+        4.0f / 9.0f,  // for 1, (4 / 9)
+
+        1.0f / 9.0f,  // for 4, (1 / 9)
+        1.0f / 9.0f,
+        1.0f / 9.0f,
+        1.0f / 9.0f,
+
+        1.0f / 36.0f, // for 4, (1 / 36)
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+        1.0f / 36.0f,
+    };
+
+    static constexpr uint8_t relective_index_table[count] = {
+        0,
+        3, 4, 1, 2,
+        8, 7, 6, 5
+    };
+
+    static constexpr uint8_t d3q27_index[count] = {
+        0, 1, 3, 4, 6,
+        15, 16, 17, 18
+    };
+};
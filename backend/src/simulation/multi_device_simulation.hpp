@@ -0,0 +1,291 @@
+/*
+    name: multi_device_simulation.hpp
+
+    usecase:
+        the same simulation as the Simulation class (simulation_class.hpp), split along z into one slab per queue,
+        so it can use several devices, or the sub-devices of one device (for example one per NUMA node of a multi socket cpu)
+
+        each step every slab first streams and collides the layers that don't need its neighbours,
+        while those run the host exchanges the one layer halos between the slabs, then the first and last layer of each slab run,
+        see simulation_slab.hpp
+
+        the public interface (next_frame, vector_array, density_array, get_dimensions, get_node_count)
+        is the same as the Simulation class, and shows the slabs as one simulation,
+        the slabs run the same per node step as the fused kernel of the Simulation class, precision_report compares the two for 2 and 3 slabs
+*/
+#pragma once
+
+#include <iostream> // used for debugging via std out
+#include <atomic> // the host side macroscopic arrays are swapped atomically, same as the Simulation class
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <vector>
+#include <algorithm> // std::min
+#include <cstdlib> // rand, for the starting noise
+
+#include "simulation_slab.hpp" // one z-slab of the simulation
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+/**
+ * returns one queue per device to split a simulation between
+ *
+ * every gpu if there is more than one,
+ * otherwise the NUMA domains of the cpu as sub-devices if it can be partitioned into more than one,
+ * otherwise the one device the Simulation class would pick
+ */
+inline std::vector<sycl::queue> slab_queues()
+{
+    std::vector<sycl::queue> queues;
+
+    std::vector<sycl::device> gpus = sycl::device::get_devices(sycl::info::device_type::gpu);
+    if(gpus.size() > 1)
+    {
+        for (sycl::device & gpu : gpus)
+        {
+            queues.push_back(sycl::queue(gpu));
+        }
+        return queues;
+    }
+
+    try {
+        sycl::device cpu = sycl::device(sycl::cpu_selector_v);
+
+        std::vector<sycl::device> numa_domains = cpu.create_sub_devices<sycl::info::partition_property::partition_by_affinity_domain>(sycl::info::partition_affinity_domain::numa);
+        if(numa_domains.size() > 1)
+        {
+            for (sycl::device & numa_domain : numa_domains)
+            {
+                queues.push_back(sycl::queue(numa_domain));
+            }
+            return queues;
+        }
+    }
+    catch (sycl::exception const &e) {
+        // no cpu, or it can't be partitioned
+    }
+
+    sycl::device d;
+    try {
+        d = sycl::device(sycl::gpu_selector_v);
+    }
+    catch (sycl::exception const &e) {
+        d = sycl::device(sycl::cpu_selector_v);
+    }
+
+    queues.push_back(sycl::queue(d));
+    return queues;
+}
+
+template <typename lattice = D3Q27, typename layout = aos_layout, typename storage = fp32_storage>
+class MultiDeviceSimulation
+{
+    private:
+        int width;  // simulation width in number of nodes
+        int height; // simulation height in number of nodes
+        int depth;  // simulation depth in number of nodes
+
+        // the number of discrete velocities per node, see lattices.hpp
+        static constexpr uint8_t possible_velocities_number = lattice::count;
+
+        // the slabs, from the front (z = 0) to the back of the simulation
+        std::vector<SimulationSlab<lattice, layout, storage> *> slabs;
+
+        // the index of the first node of each slab in the full simulation
+        std::vector<uint64_t> slab_first_node;
+
+        // the host side copies of each slab's send layers, see SimulationSlab::read_send_layers
+        std::vector<std::vector<typename storage::type>> sent_below;
+        std::vector<std::vector<typename storage::type>> sent_above;
+
+        // host side density arrays
+        float * density_array_1;
+        float * density_array_2;
+
+        // host side velocity arrays
+        sycl::float4 * vectors1;
+        sycl::float4 * vectors2;
+
+        // which array is currently pointed to by the vector_array pointer
+        // false means vectors1 is pointed to by vector_array
+        // true means vectors2 is pointed to by vector_array
+        bool which_vectors_array = false;
+
+    public:
+        /////////////////////////////////////////////////////////////////////////
+        // stable host instances of the macroscopic velocity and density array //
+        /////////////////////////////////////////////////////////////////////////
+
+        // a value containing a pointer to the current macroscopic velocity array, with the density of each node in w
+        std::atomic<sycl::float4*> vector_array;
+        // a value containing a pointer to the current macroscopic density array
+        std::atomic<float*> density_array;
+
+    // the same arguments as the Simulation class,
+    // queues: the queues to split the simulation between, one slab each, at most one per layer
+    MultiDeviceSimulation(int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau, std::vector<sycl::queue> queues = slab_queues())
+    {
+        this->width = width;
+        this->height = height;
+        this->depth = depth;
+
+        int slab_count = std::min<int>(queues.size(), depth);
+
+        uint64_t layer_node_count = width * height;
+        uint64_t node_count = layer_node_count * depth;
+
+        for (int slab = 0; slab < slab_count; slab++)
+        {
+            int first_z = slab_first_layer(slab, slab_count, depth);
+            int layer_count = slab_depth(slab, slab_count, depth);
+
+            std::cout << "slab " << slab << " (layers " << first_z << " to " << first_z + layer_count - 1 << ") running on -> "
+                      << queues[slab].get_device().template get_info<sycl::info::device::name>() << std::endl;
+
+            // the weights plus a bit of random noise, in node order, the same as the Simulation class starts with
+            std::vector<float> initial_populations(layer_node_count * layer_count * possible_velocities_number);
+            for (uint64_t i = 0; i < initial_populations.size(); i++)
+            {
+                initial_populations[i] = lattice::velocities_weights[i % possible_velocities_number] + (rand() % 100) / 1000.0f; // + 0.00, 0.01, 0.02, to 0.99f
+            }
+
+            this->slabs.push_back(new SimulationSlab<lattice, layout, storage>(queues[slab], width, height, depth, first_z, layer_count, cyc_radius, tau, initial_populations.data()));
+            this->slab_first_node.push_back(first_z * layer_node_count);
+
+            this->sent_below.push_back(std::vector<typename storage::type>(layer_node_count * SimulationSlab<lattice, layout, storage>::get_down_count()));
+            this->sent_above.push_back(std::vector<typename storage::type>(layer_node_count * SimulationSlab<lattice, layout, storage>::get_up_count()));
+        }
+
+        this->density_array_1 = new float[node_count];
+        this->density_array_2 = new float[node_count];
+
+        this->vectors1 = new sycl::float4[node_count];
+        this->vectors2 = new sycl::float4[node_count];
+
+        // prime both sets of host arrays
+        for (int slab = 0; slab < slab_count; slab++)
+        {
+            this->slabs[slab]->copy_macroscopic_variables_to_host(this->density_array_1 + this->slab_first_node[slab], this->vectors1 + this->slab_first_node[slab]);
+            this->slabs[slab]->copy_macroscopic_variables_to_host(this->density_array_2 + this->slab_first_node[slab], this->vectors2 + this->slab_first_node[slab]);
+        }
+
+        wait();
+
+        this->density_array.store(density_array_1);
+        this->vector_array.store(vectors1);
+    }
+
+    ~MultiDeviceSimulation()
+    {
+        for (SimulationSlab<lattice, layout, storage> * slab : this->slabs)
+        {
+            delete slab;
+        }
+
+        delete[] this->density_array_1;
+        delete[] this->density_array_2;
+        delete[] this->vectors1;
+        delete[] this->vectors2;
+    }
+
+    MultiDeviceSimulation(const MultiDeviceSimulation &) = delete;
+    MultiDeviceSimulation & operator=(const MultiDeviceSimulation &) = delete;
+
+    /**
+     * calculate the next state of the simulation,
+     * the same step as Simulation::next_frame, with the halos exchanged while the slab interiors compute
+     */
+    void next_frame()
+    {
+        int slab_count = this->slabs.size();
+
+        // the layers that only need the slab's own populations
+        for (int slab = 0; slab < slab_count; slab++)
+        {
+            this->slabs[slab]->submit_interior();
+        }
+
+        // exchange the halos, each slab sends its last layer up and its first layer down,
+        // the simulation wraps around along z so the first and last slab are neighbours
+        for (int slab = 0; slab < slab_count; slab++)
+        {
+            this->slabs[slab]->read_send_layers(this->sent_below[slab].data(), this->sent_above[slab].data());
+        }
+
+        for (int slab = 0; slab < slab_count; slab++)
+        {
+            int slab_below = (slab + slab_count - 1) % slab_count;
+            int slab_above = (slab + 1) % slab_count;
+
+            this->slabs[slab]->write_halo_layers(this->sent_above[slab_below].data(), this->sent_below[slab_above].data());
+        }
+
+        // the first and last layers, now that the halos are in place
+        for (int slab = 0; slab < slab_count; slab++)
+        {
+            this->slabs[slab]->submit_boundary();
+            this->slabs[slab]->finish_step();
+        }
+
+        // copy the macroscopic variables to the host side arrays that aren't currently public
+        float * next_density_array = which_vectors_array ? density_array_1 : density_array_2;
+        sycl::float4 * next_vector_array = which_vectors_array ? vectors1 : vectors2;
+
+        for (int slab = 0; slab < slab_count; slab++)
+        {
+            this->slabs[slab]->copy_macroscopic_variables_to_host(next_density_array + this->slab_first_node[slab], next_vector_array + this->slab_first_node[slab]);
+        }
+
+        wait();
+
+        this->density_array.store(next_density_array);
+        this->vector_array.store(next_vector_array);
+        this->which_vectors_array = !this->which_vectors_array;
+    }
+
+    // copies the populations of every node to the host as floats, in node order, possible_velocities_number per node
+    void copy_populations_to_host(float * populations)
+    {
+        for (size_t slab = 0; slab < this->slabs.size(); slab++)
+        {
+            this->slabs[slab]->copy_populations_to_host(populations + this->slab_first_node[slab] * possible_velocities_number);
+        }
+    }
+
+    // copies the node types (the changeable_buffer values) of every node to the host, in node order
+    void copy_node_types_to_host(uint8_t * node_types)
+    {
+        for (size_t slab = 0; slab < this->slabs.size(); slab++)
+        {
+            this->slabs[slab]->copy_node_types_to_host(node_types + this->slab_first_node[slab]);
+        }
+    }
+
+    // returns the number of slabs the simulation is split into
+    int get_slab_count()
+    {
+        return this->slabs.size();
+    }
+
+    // returns a copy of the dimensions of this simulation as a 3 dimensional sycl::range object
+    sycl::range<3> get_dimensions()
+    {
+        return sycl::range<3>(this->width, this->height, this->depth);
+    }
+
+    // returns the number of nodes in this simulation
+    int get_node_count()
+    {
+        return this->width * this->height * this->depth;
+    }
+
+    private:
+
+    // waits for every slab's queue
+    void wait()
+    {
+        for (SimulationSlab<lattice, layout, storage> * slab : this->slabs)
+        {
+            slab->wait();
+        }
+    }
+};
@@ -0,0 +1,84 @@
+/*
+    name: population_layouts.hpp
+
+    usecase:
+        the memory layouts the discrete density buffers can use,
+        passed to the Simulation class as a template parameter so the index math is resolved at compile time
+
+        each layout provides:
+            index(node_index, i, node_count, count) -> where population i of the node with index node_index is stored
+            buffer_length(node_count, count)         -> how many floats a discrete density buffer needs
+
+        where count is the number of discrete velocities per node
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+
+/**
+ * array of structures, all the populations of a node are next to each other
+ *
+ * index = node_index * count + i
+ *
+ * what the simulation has always used,
+ * a node's populations share a cache line, but streaming reads one population from each neighbour with a stride of count floats
+ */
+struct aos_layout
+{
+    static inline uint64_t index(uint64_t node_index, uint64_t i, uint64_t node_count, uint64_t count)
+    {
+        return node_index * count + i;
+    }
+
+    static inline uint64_t buffer_length(uint64_t node_count, uint64_t count)
+    {
+        return node_count * count;
+    }
+};
+
+/**
+ * structure of arrays, each velocity has its own array of node_count populations
+ *
+ * index = i * node_count + node_index
+ *
+ * neighbouring work items read neighbouring floats when streaming, which vectorizes and coalesces
+ */
+struct soa_layout
+{
+    static inline uint64_t index(uint64_t node_index, uint64_t i, uint64_t node_count, uint64_t count)
+    {
+        return i * node_count + node_index;
+    }
+
+    static inline uint64_t buffer_length(uint64_t node_count, uint64_t count)
+    {
+        return node_count * count;
+    }
+};
+
+/**
+ * array of structures of arrays, the nodes are split into blocks of block_size nodes,
+ * each block stores a structure of arrays of its own
+ *
+ * index = (node_index / block_size) * block_size * count + i * block_size + node_index % block_size
+ *
+ * keeps the contiguous per velocity reads of soa_layout within a block (block_size should be a multiple of the simd/sub-group width),
+ * while all the populations of a node stay within count * block_size floats of each other
+ *
+ * the last block is padded, so the buffer can be slightly longer than node_count * count
+ */
+template <uint64_t block_size = 16>
+struct aosoa_layout
+{
+    static_assert(block_size > 0, "aosoa_layout needs at least one node per block");
+
+    static inline uint64_t index(uint64_t node_index, uint64_t i, uint64_t node_count, uint64_t count)
+    {
+        return (node_index / block_size) * block_size * count + i * block_size + node_index % block_size;
+    }
+
+    static inline uint64_t buffer_length(uint64_t node_count, uint64_t count)
+    {
+        return ((node_count + block_size - 1) / block_size) * block_size * count;
+    }
+};
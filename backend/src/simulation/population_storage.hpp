@@ -0,0 +1,107 @@
+/*
+    name: population_storage.hpp
+
+    usecase:
+        the number formats the discrete density buffers can be stored in,
+        passed to the Simulation class as a template parameter
+
+        all the math is still done with 32 bit floats, only the values kept in memory between steps change,
+        each storage type provides:
+            type                    -> what the discrete density buffers hold
+            store(value, weight)    -> converts a population to the stored type
+            load(stored, weight)    -> converts a stored population back to a float
+
+        where weight is the weight of the population's velocity
+
+        the 16 bit formats store the deviation of the population from its weight (f - w_i), not the population itself,
+        populations stay close to their weights, so the deviations are small and keep far more of their precision,
+        see: Lehmann et al., "Accuracy and performance of the lattice Boltzmann method with 64-bit, 32-bit, and customized 16-bit number formats"
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+/**
+ * 32 bit floats, stored as is
+ */
+struct fp32_storage
+{
+    using type = float;
+
+    static inline type store(float value, float weight)
+    {
+        return value;
+    }
+
+    static inline float load(type stored, float weight)
+    {
+        return stored;
+    }
+};
+
+/**
+ * IEEE 16 bit (half precision) floats, storing f - w_i
+ * 10 bits of mantissa, range of about +-65504
+ */
+struct fp16_storage
+{
+    using type = sycl::half;
+
+    static inline type store(float value, float weight)
+    {
+        return type(value - weight);
+    }
+
+    static inline float load(type stored, float weight)
+    {
+        return static_cast<float>(stored) + weight;
+    }
+};
+
+/**
+ * brain floats (the upper 16 bits of a 32 bit float), storing f - w_i
+ * 7 bits of mantissa, the same range as a 32 bit float
+ */
+struct bf16_storage
+{
+    using type = sycl::ext::oneapi::bfloat16;
+
+    static inline type store(float value, float weight)
+    {
+        return type(value - weight);
+    }
+
+    static inline float load(type stored, float weight)
+    {
+        return static_cast<float>(stored) + weight;
+    }
+};
+
+/**
+ * 16 bit signed fixed point numbers, storing f - w_i with fraction_bits bits after the binary point
+ *
+ * the default of 13 fraction bits gives a resolution of about 0.00012 and a range of -4 to 4,
+ * deviations outside of the range are clamped
+ */
+template <int fraction_bits = 13>
+struct fixed16_storage
+{
+    static_assert(fraction_bits > 0 && fraction_bits < 16, "fixed16_storage needs between 1 and 15 fraction bits");
+
+    using type = int16_t;
+
+    static constexpr float scale = float(1 << fraction_bits);
+
+    static inline type store(float value, float weight)
+    {
+        float scaled = sycl::clamp((value - weight) * scale, -32768.0f, 32767.0f);
+        return type(scaled + (scaled < 0.0f ? -0.5f : 0.5f)); // round to the nearest step
+    }
+
+    static inline float load(type stored, float weight)
+    {
+        return stored / scale + weight;
+    }
+};
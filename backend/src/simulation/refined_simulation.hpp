@@ -0,0 +1,1140 @@
+/*
+    name: refined_simulation.hpp
+
+    usecase:
+        the same simulation as the Simulation class (simulation_class.hpp) on a coarse grid,
+        with one block of it refined to half the node spacing (2:1), so the nodes near the cylinder can be resolved finer
+        without refining the whole simulation
+
+        the block is either given as a box of coarse nodes, or found around the reflective nodes (changeable_buffer value of 1),
+        every coarse node within refinement_margin nodes of one is inside it,
+        along an axis where it spans the whole simulation (the cylinder along y for example) the refined block wraps around the same as the coarse grid
+
+        the refined block takes two steps of half the time for every step of the coarse grid (local time stepping),
+        the two grids are coupled the Dupuis-Chopard way:
+            the nodes on the faces of the block take the coarse populations, interpolated in space and time,
+            and the coarse nodes inside of the block take the populations of the refined node at the same position after its second step,
+            in both directions the equilibrium is kept and the non equilibrium part is rescaled to the relaxation time of the other grid
+
+        the public macroscopic arrays (vector_array, density_array) hold the coarse grid, the same as the Simulation class,
+        resample writes both grids to one uniform grid, at the spacing of either grid
+*/
+#pragma once
+
+#include <iostream> // used for debugging via std out
+#include <atomic> // the host side macroscopic arrays, the same as the Simulation class
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <utility> // std::swap, used to swap the population buffers
+#include <algorithm> // std::min, std::max
+#include <cstdlib> // rand, for the starting noise
+#include <stdexcept> // std::invalid_argument, thrown for blocks that don't fit in the simulation
+
+#include "simulation_class.hpp" // the per node helpers the kernels share with the Simulation class
+#include "initial_geometry.hpp" // initial_node_type, evaluated at the spacing of each grid
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+/**
+ * the number of refined nodes per coarse node spacing along the given axis (0 = x, 1 = y, 2 = z),
+ * 2 along the axes the lattice moves along and 1 along the others, D2Q9 for example is never refined along y
+ */
+template <typename lattice>
+constexpr int refinement_scale(int axis)
+{
+    return lattice_moves_along<lattice>(axis) ? 2 : 1;
+}
+
+/**
+ * the block of coarse nodes that is refined, from low to high along each axis, both included
+ */
+struct refinement_box
+{
+    int low[3];
+    int high[3];
+};
+
+/**
+ * returns true if the block spans the whole simulation along the axis, 
+ * the refined block then wraps around along it the same as the coarse grid, and has no faces along it
+ */
+inline bool box_spans_axis(const refinement_box & box, int axis, const sycl::range<3> & dims)
+{
+    return box.low[axis] == 0 && box.high[axis] == (int) dims.get(axis) - 1;
+}
+
+template <typename lattice = D3Q27, typename layout = aos_layout, typename storage = fp32_storage>
+class RefinedSimulation
+{
+    private:
+        int width;  // simulation width in number of coarse nodes
+        int height; // simulation height in number of coarse nodes
+        int depth;  // simulation depth in number of coarse nodes
+
+        sycl::queue q;
+
+        // the number of discrete velocities per node, see lattices.hpp
+        static constexpr uint8_t possible_velocities_number = lattice::count;
+
+        // the adimentional speed of sound in the lattice, the same as the Simulation class
+        static constexpr float speed_of_sound = 1.0f / 1.73205080757f;
+
+        // the relaxation rates of the coarse grid and the refined block,
+        // the viscosity is the same on both grids when (1 / fine_tau - 0.5) is twice (1 / tau - 0.5)
+        float tau;
+        float fine_tau;
+
+        const float flow_vec_x = 0.0f;
+        const float flow_vec_y = 0.0f;
+        const float flow_vec_z = 1.0f;
+
+        //////////////////
+        // coarse grid  //
+        //////////////////
+
+        sycl::range<3> * dims;
+        sycl::range<1> * node_count;
+
+        lattice_strides<lattice> * strides;
+
+        // the boundary type of each coarse node, the same values as the changeable_buffer of the Simulation class
+        sycl::buffer<uint8_t, 1> * changeable_buffer;
+
+        // index = layout::index(node_index, i, node_count, possible_velocities_number)
+        sycl::buffer<typename storage::type, 1> * discrete_density_buffer_1; // the values to read from
+        sycl::buffer<typename storage::type, 1> * discrete_density_buffer_2; // the values to write to
+
+        sycl::buffer<float, 1> * macro_density_buffer;
+        sycl::buffer<sycl::float4, 1> * vectors;
+
+        //////////////////////////
+        // the refined block    //
+        //////////////////////////
+
+        refinement_box box;
+
+        // 1 along the axes the block has faces along (the refined axes it doesn't span), 0 along the others
+        int face_width[3];
+
+        // the number of coarse nodes in the block along each axis, and in total
+        sycl::range<3> * box_dims;
+
+        // the number of refined nodes along each axis, refinement_scale * (box_dims - 1) + 1 along the axes with faces, 
+        // where the first and last refined node sit on the faces of the block, on top of coarse nodes,
+        // and refinement_scale * box_dims along the others, which wrap around
+        sycl::range<3> * fine_dims;
+        sycl::range<1> * fine_node_count;
+
+        lattice_strides<lattice> * fine_strides;
+
+        sycl::buffer<uint8_t, 1> * fine_changeable_buffer;
+
+        // index = layout::index(fine_node_index, i, fine_node_count, possible_velocities_number)
+        sycl::buffer<typename storage::type, 1> * fine_discrete_density_buffer_1;
+        sycl::buffer<typename storage::type, 1> * fine_discrete_density_buffer_2;
+
+        sycl::buffer<float, 1> * fine_macro_density_buffer;
+        sycl::buffer<sycl::float4, 1> * fine_vectors;
+
+        // the populations of the coarse nodes in the block, rescaled for the refined block, at the start and the end of the current coarse step
+        // index = box_node_index * possible_velocities_number + i
+        sycl::buffer<float, 1> * coarse_to_fine_old;
+        sycl::buffer<float, 1> * coarse_to_fine_new;
+
+        //////////////////////////
+        // host side arrays     //
+        //////////////////////////
+
+        // two copies of each coarse macroscopic array, one is public while the other one is written by copy_macroscopic_variables_to_host
+        float * density_array_1;
+        float * density_array_2;
+        sycl::float4 * vectors1;
+        sycl::float4 * vectors2;
+
+        // false means vectors1 and density_array_1 are pointed to by vector_array and density_array,
+        // true means vectors2 and density_array_2 are
+        bool which_vectors_array = false;
+
+    public:
+        // a value containing a pointer to the macroscopic velocity array of the coarse grid, with the density of each node in w
+        std::atomic<sycl::float4*> vector_array;
+        // a value containing a pointer to the macroscopic density array of the coarse grid
+        std::atomic<float*> density_array;
+
+    // the same arguments as the Simulation class,
+    // refinement_margin: how many coarse nodes around the reflective nodes are refined,
+    // throws std::invalid_argument when there are no reflective nodes, or the block around them would touch the edges of the simulation
+    RefinedSimulation(int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau, int refinement_margin = 3)
+        : RefinedSimulation(width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau, box_around_reflective_nodes(width, height, depth, cyc_radius, refinement_margin))
+    {
+    }
+
+    // the same arguments as the Simulation class,
+    // box: the coarse nodes to refine,
+    // throws std::invalid_argument when the block touches the edges of the simulation along an axis the lattice moves along without spanning it,
+    // or it has no coarse node inside of its faces
+    RefinedSimulation(int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau, refinement_box box)
+    {
+        this->width = width;
+        this->height = height;
+        this->depth = depth;
+
+        this->q = sycl::queue(simulation_device());
+
+        int coarse_dims[3] = {width, height, depth};
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if(!lattice_moves_along<lattice>(axis))
+            {
+                // never refined along this axis, the block spans it
+                box.low[axis] = 0;
+                box.high[axis] = coarse_dims[axis] - 1;
+            }
+
+            this->face_width[axis] = box.low[axis] == 0 && box.high[axis] == coarse_dims[axis] - 1 ? 0 : 1;
+
+            if(this->face_width[axis] == 1 && (box.low[axis] < 1 || box.high[axis] > coarse_dims[axis] - 2 || box.high[axis] < box.low[axis] + 2))
+            {
+                throw std::invalid_argument("RefinedSimulation: the refined block has to be at least 3 nodes wide and can only touch the edges of the simulation by spanning it");
+            }
+        }
+        this->box = box;
+
+        this->tau = tau;
+        this->fine_tau = 1.0f / (2.0f * (1.0f / tau - 0.5f) + 0.5f);
+
+        std::cout << "running simulation on -> " << q.get_device().get_info<sycl::info::device::name>() << std::endl;
+
+        this->dims = new sycl::range<3>(width, height, depth);
+        this->node_count = new sycl::range<1>(width * height * depth);
+        this->strides = new lattice_strides<lattice>(width, height);
+
+        this->box_dims = new sycl::range<3>(box.high[0] - box.low[0] + 1, box.high[1] - box.low[1] + 1, box.high[2] - box.low[2] + 1);
+
+        this->fine_dims = new sycl::range<3>(refinement_scale<lattice>(0) * (this->box_dims->get(0) - this->face_width[0]) + this->face_width[0],
+                                             refinement_scale<lattice>(1) * (this->box_dims->get(1) - this->face_width[1]) + this->face_width[1],
+                                             refinement_scale<lattice>(2) * (this->box_dims->get(2) - this->face_width[2]) + this->face_width[2]);
+        this->fine_node_count = new sycl::range<1>(this->fine_dims->size());
+        this->fine_strides = new lattice_strides<lattice>(this->fine_dims->get(0), this->fine_dims->get(1));
+
+        uint64_t uniform_fine_node_count = (uint64_t) width * refinement_scale<lattice>(0) * height * refinement_scale<lattice>(1) * depth * refinement_scale<lattice>(2);
+        std::cout << "refined block: " << this->fine_dims->get(0) << " x " << this->fine_dims->get(1) << " x " << this->fine_dims->get(2) << " nodes, "
+                  << this->node_count->get(0) + this->fine_node_count->get(0) << " nodes in total, against " << uniform_fine_node_count << " refining every node" << std::endl;
+
+        // the node types of both grids, from the same geometry at the spacing of each
+        this->changeable_buffer = new sycl::buffer<uint8_t, 1>(*this->node_count);
+        this->fine_changeable_buffer = new sycl::buffer<uint8_t, 1>(*this->fine_node_count);
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::write> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> i)
+            {
+                int64_t index = i.get(0) + i.get(1) * width + i.get(2) * width * height;
+
+                device_accessor_changeable_buffer[index] = initial_node_type(i.get(0), i.get(1), i.get(2), width, height, depth, cyc_radius);
+            });
+        });
+
+        sycl::range<3> local_fine_dims = *this->fine_dims;
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::write> device_accessor_fine_changeable_buffer(*this->fine_changeable_buffer, h);
+
+            h.parallel_for(*this->fine_dims, [=](sycl::id<3> i)
+            {
+                int64_t index = i.get(0) + i.get(1) * local_fine_dims.get(0) + i.get(2) * local_fine_dims.get(0) * local_fine_dims.get(1);
+
+                // the position of the node on a grid refined everywhere
+                device_accessor_fine_changeable_buffer[index] = initial_node_type
+                (
+                    refinement_scale<lattice>(0) * box.low[0] + i.get(0),
+                    refinement_scale<lattice>(1) * box.low[1] + i.get(1),
+                    refinement_scale<lattice>(2) * box.low[2] + i.get(2),
+                    refinement_scale<lattice>(0) * width, refinement_scale<lattice>(1) * height, refinement_scale<lattice>(2) * depth,
+                    2.0f * cyc_radius
+                );
+            });
+        });
+
+        sycl::range<1> population_length(layout::buffer_length(this->node_count->get(0), possible_velocities_number));
+        sycl::range<1> fine_population_length(layout::buffer_length(this->fine_node_count->get(0), possible_velocities_number));
+
+        this->discrete_density_buffer_1 = new sycl::buffer<typename storage::type, 1>(population_length);
+        this->discrete_density_buffer_2 = new sycl::buffer<typename storage::type, 1>(population_length);
+        this->fine_discrete_density_buffer_1 = new sycl::buffer<typename storage::type, 1>(fine_population_length);
+        this->fine_discrete_density_buffer_2 = new sycl::buffer<typename storage::type, 1>(fine_population_length);
+
+        this->macro_density_buffer = new sycl::buffer<float, 1>(*this->node_count);
+        this->vectors = new sycl::buffer<sycl::float4, 1>(*this->node_count);
+        this->fine_macro_density_buffer = new sycl::buffer<float, 1>(*this->fine_node_count);
+        this->fine_vectors = new sycl::buffer<sycl::float4, 1>(*this->fine_node_count);
+
+        this->coarse_to_fine_old = new sycl::buffer<float, 1>(sycl::range<1>(this->box_dims->size() * possible_velocities_number));
+        this->coarse_to_fine_new = new sycl::buffer<float, 1>(sycl::range<1>(this->box_dims->size() * possible_velocities_number));
+
+        // the coarse grid starts the same as the Simulation class, at the weights plus a bit of random noise in node order
+        {
+            auto accessor = this->discrete_density_buffer_1->get_host_access();
+            for (uint64_t i = 0; i < this->node_count->get(0) * possible_velocities_number; i++)
+            {
+                float weight = lattice::velocities_weights[i % possible_velocities_number];
+                float noise = (rand() % 100) / 1000.0f; // + 0.00, 0.01, 0.02, to 0.99f
+
+                accessor[layout::index(i / possible_velocities_number, i % possible_velocities_number, this->node_count->get(0), possible_velocities_number)] = storage::store(weight + noise, weight);
+            }
+        }
+
+        // the macroscopic variables of the starting populations
+        uint64_t local_node_count = this->node_count->get(0);
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_density(*this->macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_vectors(*this->vectors, h);
+
+            h.parallel_for(*this->node_count, [=](sycl::id<1> node_id)
+            {
+                uint64_t node_index = node_id[0];
+
+                float populations[possible_velocities_number];
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                }
+
+                float node_density;
+                float macro_velocity_x;
+                float macro_velocity_y;
+                float macro_velocity_z;
+
+                node_macroscopic_variables<lattice>(populations, speed_of_sound, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z);
+
+                device_accessor_macro_density[node_index] = node_density;
+                device_accessor_vectors[node_index] = sycl::float4(macro_velocity_x, macro_velocity_y, macro_velocity_z, node_density);
+            });
+        });
+
+        // the refined block starts from the coarse populations, rescaled and interpolated onto every refined node
+        start_coarse_to_fine();
+        fill_fine_nodes(*this->fine_dims, -1, 0.0f);
+
+        this->density_array_1 = new float[this->node_count->get(0)];
+        this->density_array_2 = new float[this->node_count->get(0)];
+        this->vectors1 = new sycl::float4[this->node_count->get(0)];
+        this->vectors2 = new sycl::float4[this->node_count->get(0)];
+
+        this->density_array.store(this->density_array_1);
+        this->vector_array.store(this->vectors1);
+
+        copy_macroscopic_variables_to_host();
+    }
+
+    ~RefinedSimulation()
+    {
+        this->q.wait();
+
+        delete this->dims;
+        delete this->node_count;
+        delete this->strides;
+        delete this->changeable_buffer;
+        delete this->discrete_density_buffer_1;
+        delete this->discrete_density_buffer_2;
+        delete this->macro_density_buffer;
+        delete this->vectors;
+
+        delete this->box_dims;
+        delete this->fine_dims;
+        delete this->fine_node_count;
+        delete this->fine_strides;
+        delete this->fine_changeable_buffer;
+        delete this->fine_discrete_density_buffer_1;
+        delete this->fine_discrete_density_buffer_2;
+        delete this->fine_macro_density_buffer;
+        delete this->fine_vectors;
+        delete this->coarse_to_fine_old;
+        delete this->coarse_to_fine_new;
+
+        delete[] this->density_array_1;
+        delete[] this->density_array_2;
+        delete[] this->vectors1;
+        delete[] this->vectors2;
+    }
+
+    RefinedSimulation(const RefinedSimulation &) = delete;
+    RefinedSimulation & operator=(const RefinedSimulation &) = delete;
+
+    /**
+     * calculate the next state of the simulation, one coarse step and two steps of the refined block
+     */
+    void next_frame()
+    {
+        // the populations at the end of the last step become the ones at the start of this one
+        std::swap(this->coarse_to_fine_old, this->coarse_to_fine_new);
+
+        next_frame_coarse();
+
+        // the faces of the block at the start of the coarse step, then half way through it
+        fill_fine_nodes_on_faces(0.0f);
+        next_frame_fine(false);
+
+        fill_fine_nodes_on_faces(0.5f);
+        next_frame_fine(true);
+
+        copy_macroscopic_variables_to_host();
+    }
+
+    /**
+     * returns the dimensions of the uniform grid resample writes,
+     * resolution is 1 for the node spacing of the coarse grid, or 2 for the node spacing of the refined block
+     */
+    sycl::range<3> get_uniform_dimensions(int resolution)
+    {
+        return sycl::range<3>(this->width  * (refinement_scale<lattice>(0) == 2 ? resolution : 1),
+                              this->height * (refinement_scale<lattice>(1) == 2 ? resolution : 1),
+                              this->depth  * (refinement_scale<lattice>(2) == 2 ? resolution : 1));
+    }
+
+    /**
+     * writes both grids to one uniform grid of get_uniform_dimensions(resolution) nodes, in node order,
+     * resolution is 1 for the node spacing of the coarse grid, or 2 for the node spacing of the refined block,
+     * throws std::invalid_argument for any other resolution
+     *
+     * the nodes inside of the block take the refined node at their position,
+     * the others are interpolated from the coarse nodes around them (or take the node type of the coarse node below them)
+     *
+     * velocity has the density of each node in w, the same as vector_array
+     *
+     * populations (possible_velocities_number floats per node) can be nullptr, they are read as stored on the grid they come from
+     */
+    void resample(int resolution, uint8_t * node_types, float * density, sycl::float4 * velocity, float * populations)
+    {
+        if(resolution != 1 && resolution != 2)
+        {
+            throw std::invalid_argument("RefinedSimulation: resample takes a resolution of 1 or 2");
+        }
+
+        sycl::range<3> uniform_dims = get_uniform_dimensions(resolution);
+        uint64_t uniform_node_count = uniform_dims.size();
+
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        sycl::range<3> local_fine_dims = *this->fine_dims;
+        uint64_t local_fine_node_count = this->fine_node_count->get(0);
+        refinement_box local_box = this->box;
+
+        bool write_populations = populations != nullptr;
+
+        {
+            sycl::buffer<uint8_t, 1> uniform_node_types(sycl::range<1>{uniform_node_count});
+            sycl::buffer<float, 1> uniform_density(sycl::range<1>{uniform_node_count});
+            sycl::buffer<sycl::float4, 1> uniform_velocity(sycl::range<1>{uniform_node_count});
+
+            // a buffer of one element when the populations aren't wanted
+            sycl::buffer<float, 1> uniform_populations(sycl::range<1>{write_populations ? uniform_node_count * possible_velocities_number : 1});
+
+            this->q.submit([&](sycl::handler& h)
+            {
+                sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+                sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_macro_density(*this->macro_density_buffer, h);
+                sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_vectors(*this->vectors, h);
+
+                sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_fine_changeable_buffer(*this->fine_changeable_buffer, h);
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_fine_discrete_density_buffer_1(*this->fine_discrete_density_buffer_1, h);
+                sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_fine_macro_density(*this->fine_macro_density_buffer, h);
+                sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_fine_vectors(*this->fine_vectors, h);
+
+                sycl::accessor<uint8_t, 1, sycl::access_mode::write> device_accessor_uniform_node_types(uniform_node_types, h);
+                sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_uniform_density(uniform_density, h);
+                sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_uniform_velocity(uniform_velocity, h);
+                sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_uniform_populations(uniform_populations, h);
+
+                h.parallel_for(uniform_dims, [=](sycl::id<3> uniform_position)
+                {
+                    uint64_t uniform_index = uniform_position.get(0)
+                                           + uniform_position.get(1) * uniform_dims.get(0)
+                                           + uniform_position.get(2) * uniform_dims.get(0) * uniform_dims.get(1);
+
+                    // the uniform nodes per coarse node spacing along each axis
+                    int scale[3];
+                    bool inside_box = true;
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        scale[axis] = uniform_dims.get(axis) / local_dims.get(axis);
+
+                        // at or between the coarse nodes of the block
+                        int position = uniform_position.get(axis);
+                        inside_box = inside_box && (box_spans_axis(local_box, axis, local_dims) || (position >= scale[axis] * local_box.low[axis]
+                                                                                                 && position <= scale[axis] * local_box.high[axis]));
+                    }
+
+                    if(inside_box)
+                    {
+                        uint64_t fine_index = 0;
+                        uint64_t fine_stride = 1;
+                        for (int axis = 0; axis < 3; axis++)
+                        {
+                            // the refined block has refinement_scale nodes per coarse spacing, the uniform grid has scale
+                            fine_index += ((int) uniform_position.get(axis) - scale[axis] * local_box.low[axis]) * refinement_scale<lattice>(axis) / scale[axis] * fine_stride;
+                            fine_stride *= local_fine_dims.get(axis);
+                        }
+
+                        device_accessor_uniform_node_types[uniform_index] = device_accessor_fine_changeable_buffer[fine_index];
+                        device_accessor_uniform_density[uniform_index] = device_accessor_fine_macro_density[fine_index];
+                        device_accessor_uniform_velocity[uniform_index] = device_accessor_fine_vectors[fine_index];
+
+                        if(write_populations)
+                        {
+                            for (uint8_t i = 0; i < possible_velocities_number; i++)
+                            {
+                                device_accessor_uniform_populations[uniform_index * possible_velocities_number + i] =
+                                    storage::load(device_accessor_fine_discrete_density_buffer_1[layout::index(fine_index, i, local_fine_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                            }
+                        }
+                        return;
+                    }
+
+                    // the coarse node at or below the uniform node, and if the uniform node is half way to the next one along each axis
+                    int coarse_position[3];
+                    bool between[3];
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        coarse_position[axis] = uniform_position.get(axis) / scale[axis];
+                        between[axis] = uniform_position.get(axis) % scale[axis] != 0;
+                    }
+
+                    device_accessor_uniform_node_types[uniform_index] = device_accessor_changeable_buffer[coarse_position[0] + coarse_position[1] * local_dims.get(0) + coarse_position[2] * local_dims.get(0) * local_dims.get(1)];
+
+                    float uniform_node_density = 0.0f;
+                    float uniform_node_velocity_x = 0.0f;
+                    float uniform_node_velocity_y = 0.0f;
+                    float uniform_node_velocity_z = 0.0f;
+                    float uniform_node_populations[possible_velocities_number] = {};
+
+                    // the average of the 1, 2, 4 or 8 coarse nodes around it, wrapping around the edges
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        int offset[3] = {corner & 1, (corner >> 1) & 1, (corner >> 2) & 1};
+                        if((offset[0] && !between[0]) || (offset[1] && !between[1]) || (offset[2] && !between[2]))
+                        {
+                            continue;
+                        }
+
+                        float weight = (between[0] ? 0.5f : 1.0f) * (between[1] ? 0.5f : 1.0f) * (between[2] ? 0.5f : 1.0f);
+
+                        uint64_t node_index = wrap_coordinate(coarse_position[0] + offset[0], local_dims.get(0))
+                                            + wrap_coordinate(coarse_position[1] + offset[1], local_dims.get(1)) * local_dims.get(0)
+                                            + wrap_coordinate(coarse_position[2] + offset[2], local_dims.get(2)) * local_dims.get(0) * local_dims.get(1);
+
+                        uniform_node_density += weight * device_accessor_macro_density[node_index];
+                        sycl::float4 node_velocity = device_accessor_vectors[node_index];
+                        uniform_node_velocity_x += weight * node_velocity.x();
+                        uniform_node_velocity_y += weight * node_velocity.y();
+                        uniform_node_velocity_z += weight * node_velocity.z();
+
+                        for (uint8_t i = 0; i < possible_velocities_number; i++)
+                        {
+                            uniform_node_populations[i] += weight * storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                        }
+                    }
+
+                    device_accessor_uniform_density[uniform_index] = uniform_node_density;
+                    device_accessor_uniform_velocity[uniform_index] = sycl::float4(uniform_node_velocity_x, uniform_node_velocity_y, uniform_node_velocity_z, uniform_node_density);
+
+                    if(write_populations)
+                    {
+                        for (uint8_t i = 0; i < possible_velocities_number; i++)
+                        {
+                            device_accessor_uniform_populations[uniform_index * possible_velocities_number + i] = uniform_node_populations[i];
+                        }
+                    }
+                });
+            });
+
+            this->q.submit([&](sycl::handler& h)
+            {
+                sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_uniform_node_types(uniform_node_types, h);
+
+                h.copy(device_accessor_uniform_node_types, node_types);
+            });
+
+            this->q.submit([&](sycl::handler& h)
+            {
+                sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_uniform_density(uniform_density, h);
+
+                h.copy(device_accessor_uniform_density, density);
+            });
+
+            this->q.submit([&](sycl::handler& h)
+            {
+                sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_uniform_velocity(uniform_velocity, h);
+
+                h.copy(device_accessor_uniform_velocity, velocity);
+            });
+
+            if(write_populations)
+            {
+                this->q.submit([&](sycl::handler& h)
+                {
+                    sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_uniform_populations(uniform_populations, h);
+
+                    h.copy(device_accessor_uniform_populations, populations);
+                });
+            }
+
+            this->q.wait();
+        }
+    }
+
+    // returns the coarse nodes that are refined
+    refinement_box get_refinement_box()
+    {
+        return this->box;
+    }
+
+    // returns a copy of the dimensions of the refined block in refined nodes as a 3 dimensional sycl::range object
+    sycl::range<3> get_fine_dimensions()
+    {
+        return *this->fine_dims;
+    }
+
+    // returns the number of nodes in the refined block
+    int get_fine_node_count()
+    {
+        return this->fine_node_count->get(0);
+    }
+
+    // returns a copy of the dimensions of the coarse grid as a 3 dimensional sycl::range object
+    sycl::range<3> get_dimensions()
+    {
+        return *this->dims;
+    }
+
+    // returns the number of nodes in the coarse grid
+    int get_node_count()
+    {
+        return this->node_count->get(0);
+    }
+
+    private:
+
+    /**
+     * returns the coarse nodes within margin nodes of a reflective node,
+     * kept one node away from the edges of the simulation, or spanning it along the axes it would reach them, 
+     * and along the axes the lattice doesn't move along
+     */
+    static refinement_box box_around_reflective_nodes(int width, int height, int depth, float cyc_radius, int margin)
+    {
+        int coarse_dims[3] = {width, height, depth};
+
+        int low[3] = {width, height, depth};
+        int high[3] = {-1, -1, -1};
+
+        for (int z = 0; z < depth; z++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    if(initial_node_type(x, y, z, width, height, depth, cyc_radius) != 1)
+                    {
+                        continue;
+                    }
+
+                    int position[3] = {x, y, z};
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        low[axis] = std::min(low[axis], position[axis]);
+                        high[axis] = std::max(high[axis], position[axis]);
+                    }
+                }
+            }
+        }
+
+        if(high[0] < 0)
+        {
+            throw std::invalid_argument("RefinedSimulation: there are no reflective nodes to refine around");
+        }
+
+        refinement_box box;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if(!lattice_moves_along<lattice>(axis))
+            {
+                box.low[axis] = 0;
+                box.high[axis] = coarse_dims[axis] - 1;
+                continue;
+            }
+
+            box.low[axis] = low[axis] - margin;
+            box.high[axis] = high[axis] + margin;
+
+            if(box.low[axis] < 1 || box.high[axis] > coarse_dims[axis] - 2)
+            {
+                box.low[axis] = 0;
+                box.high[axis] = coarse_dims[axis] - 1;
+            }
+        }
+        return box;
+    }
+
+    /**
+     * one step of the coarse grid, the fused kernel of the Simulation class,
+     * which also writes the populations of the coarse nodes in the block, rescaled for the refined block, to coarse_to_fine_new
+     *
+     * the coarse nodes inside of the block are stepped as well,
+     * and overwritten by the refined block at the end of the step (see next_frame_fine), so the coarse nodes around them can stream from them
+     */
+    void next_frame_coarse()
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        lattice_strides<lattice> local_strides = *this->strides;
+        sycl::range<3> local_box_dims = *this->box_dims;
+        refinement_box local_box = this->box;
+
+        float local_tau = this->tau;
+
+        // rescales the non equilibrium part of the populations from the coarse relaxation time to the refined one,
+        // and relaxes it at the refined rate, see coarse_to_fine_population
+        float non_equilibrium_scale = (1.0f - this->fine_tau) * this->tau / (2.0f * this->fine_tau);
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_density(*this->macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_vectors(*this->vectors, h);
+
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_coarse_to_fine(*this->coarse_to_fine_new, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> node_position)
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+
+                uint64_t node_index = node_x
+                                    + node_y * local_dims.get(0)
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                float populations[possible_velocities_number];
+
+                if(is_interior_node<lattice>(node_x, node_y, node_z, local_dims))
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index - local_strides.stride[i], i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+                else
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        uint64_t from_node_index = wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, local_dims);
+
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+
+                uint8_t node_type = device_accessor_changeable_buffer[node_index];
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, bgk_collision>(populations, node_type, collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, collision_parameters(),
+                    [&](uint8_t i) { return storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                device_accessor_vectors[node_index] = node_macro_state;
+                device_accessor_macro_density[node_index] = node_macro_state.w();
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+
+                if(node_x < local_box.low[0] || node_x > local_box.high[0]
+                || node_y < local_box.low[1] || node_y > local_box.high[1]
+                || node_z < local_box.low[2] || node_z > local_box.high[2])
+                {
+                    return;
+                }
+
+                uint64_t box_index = (node_x - local_box.low[0])
+                                   + (node_y - local_box.low[1]) * local_box_dims.get(0)
+                                   + (node_z - local_box.low[2]) * local_box_dims.get(0) * local_box_dims.get(1);
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_coarse_to_fine[box_index * possible_velocities_number + i] = node_type == 0
+                        ? rescaled_population(i, populations[i], node_macro_state.w(), node_macro_state.x(), node_macro_state.y(), node_macro_state.z(), non_equilibrium_scale)
+                        : collided[i];
+                }
+            });
+        });
+
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+    }
+
+    /**
+     * one step of the refined nodes inside of the faces of the block, the fused kernel of the Simulation class,
+     * the refined nodes on the faces are filled before each step, see fill_fine_nodes_on_faces
+     *
+     * on the second step of a coarse step (restrict_to_coarse), every refined node on top of a coarse node
+     * also writes its populations, rescaled for the coarse grid, and its macroscopic variables to that coarse node
+     */
+    void next_frame_fine(bool restrict_to_coarse)
+    {
+        sycl::range<3> local_fine_dims = *this->fine_dims;
+        uint64_t local_fine_node_count = this->fine_node_count->get(0);
+        lattice_strides<lattice> local_fine_strides = *this->fine_strides;
+
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        refinement_box local_box = this->box;
+
+        float local_fine_tau = this->fine_tau;
+
+        // the inverse of the rescaling in next_frame_coarse
+        float non_equilibrium_scale = (1.0f - this->tau) * 2.0f * this->fine_tau / this->tau;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        // every refined node but the ones on the faces
+        int local_face_width[3] = {this->face_width[0], this->face_width[1], this->face_width[2]};
+        sycl::range<3> inner_dims(local_fine_dims.get(0) - 2 * local_face_width[0],
+                                  local_fine_dims.get(1) - 2 * local_face_width[1],
+                                  local_fine_dims.get(2) - 2 * local_face_width[2]);
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_fine_changeable_buffer(*this->fine_changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_fine_discrete_density_buffer_1(*this->fine_discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_fine_discrete_density_buffer_2(*this->fine_discrete_density_buffer_2, h);
+
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_fine_macro_density(*this->fine_macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_fine_vectors(*this->fine_vectors, h);
+
+            // the coarse grid is only written to on the second step, the populations of the step that just finished
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read_write> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<float, 1, sycl::access_mode::read_write> device_accessor_macro_density(*this->macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::read_write> device_accessor_vectors(*this->vectors, h);
+
+            h.parallel_for(inner_dims, [=](sycl::id<3> inner_position)
+            {
+                int fine_x = inner_position.get(0) + local_face_width[0];
+                int fine_y = inner_position.get(1) + local_face_width[1];
+                int fine_z = inner_position.get(2) + local_face_width[2];
+
+                uint64_t fine_index = fine_x
+                                    + fine_y * local_fine_dims.get(0)
+                                    + fine_z * local_fine_dims.get(0) * local_fine_dims.get(1);
+
+                // the neighbours on the faces are filled from the coarse grid, 
+                // only the nodes at the ends of the axes the block spans wrap around
+                float populations[possible_velocities_number];
+
+                if(is_interior_node<lattice>(fine_x, fine_y, fine_z, local_fine_dims))
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        populations[i] = storage::load(device_accessor_fine_discrete_density_buffer_1[layout::index(fine_index - local_fine_strides.stride[i], i, local_fine_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+                else
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        uint64_t from_fine_index = wrapped_neighbour_index<lattice>(fine_x, fine_y, fine_z, i, -1, local_fine_dims);
+
+                        populations[i] = storage::load(device_accessor_fine_discrete_density_buffer_1[layout::index(from_fine_index, i, local_fine_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+
+                uint8_t node_type = device_accessor_fine_changeable_buffer[fine_index];
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, bgk_collision>(populations, node_type, collided, speed_of_sound,
+                    local_fine_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, collision_parameters(),
+                    [&](uint8_t i) { return storage::load(device_accessor_fine_discrete_density_buffer_1[layout::index(fine_index, i, local_fine_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                device_accessor_fine_vectors[fine_index] = node_macro_state;
+                device_accessor_fine_macro_density[fine_index] = node_macro_state.w();
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_fine_discrete_density_buffer_2[layout::index(fine_index, i, local_fine_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+
+                if(!restrict_to_coarse
+                || fine_x % refinement_scale<lattice>(0) != 0
+                || fine_y % refinement_scale<lattice>(1) != 0
+                || fine_z % refinement_scale<lattice>(2) != 0)
+                {
+                    return;
+                }
+
+                uint64_t node_index = (local_box.low[0] + fine_x / refinement_scale<lattice>(0))
+                                    + (local_box.low[1] + fine_y / refinement_scale<lattice>(1)) * local_dims.get(0)
+                                    + (local_box.low[2] + fine_z / refinement_scale<lattice>(2)) * local_dims.get(0) * local_dims.get(1);
+
+                device_accessor_vectors[node_index] = node_macro_state;
+                device_accessor_macro_density[node_index] = node_macro_state.w();
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    float coarse_population = node_type == 0
+                        ? rescaled_population(i, populations[i], node_macro_state.w(), node_macro_state.x(), node_macro_state.y(), node_macro_state.z(), non_equilibrium_scale)
+                        : collided[i];
+
+                    device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(coarse_population, lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        std::swap(this->fine_discrete_density_buffer_1, this->fine_discrete_density_buffer_2);
+    }
+
+    /**
+     * returns the post collision population i of a node on the other grid,
+     * from the (streamed) population i of a fluid node and its macroscopic variables,
+     * the equilibrium stays and the non equilibrium part is multiplied by non_equilibrium_scale,
+     *
+     * coarse to refined: (1 - fine_tau) * tau / (2 * fine_tau), refined to coarse: (1 - tau) * 2 * fine_tau / tau
+     * (the relaxation times are 1 / tau and 1 / fine_tau, the non equilibrium part scales with relaxation time times time step)
+     */
+    static inline float rescaled_population(uint8_t i, float population, float node_density, float macro_velocity_x, float macro_velocity_y, float macro_velocity_z, float non_equilibrium_scale)
+    {
+        float equlibrium_density = f_eq
+        (
+            lattice::velocities_weights[i], node_density,
+            lattice::possible_velocities[i * 3],
+            lattice::possible_velocities[i * 3 + 1],
+            lattice::possible_velocities[i * 3 + 2],
+            macro_velocity_x, macro_velocity_y, macro_velocity_z
+        );
+
+        return equlibrium_density + non_equilibrium_scale * (population - equlibrium_density);
+    }
+
+    /**
+     * fills coarse_to_fine_old and coarse_to_fine_new from the starting coarse populations,
+     * treating them as streamed populations, so the refined block starts from the same flow as the coarse grid
+     */
+    void start_coarse_to_fine()
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        sycl::range<3> local_box_dims = *this->box_dims;
+        refinement_box local_box = this->box;
+
+        float non_equilibrium_scale = (1.0f - this->fine_tau) * this->tau / (2.0f * this->fine_tau);
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_coarse_to_fine_old(*this->coarse_to_fine_old, h);
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_coarse_to_fine_new(*this->coarse_to_fine_new, h);
+
+            h.parallel_for(local_box_dims, [=](sycl::id<3> box_position)
+            {
+                uint64_t box_index = box_position.get(0)
+                                   + box_position.get(1) * local_box_dims.get(0)
+                                   + box_position.get(2) * local_box_dims.get(0) * local_box_dims.get(1);
+
+                uint64_t node_index = (local_box.low[0] + box_position.get(0))
+                                    + (local_box.low[1] + box_position.get(1)) * local_dims.get(0)
+                                    + (local_box.low[2] + box_position.get(2)) * local_dims.get(0) * local_dims.get(1);
+
+                float populations[possible_velocities_number];
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                }
+
+                float node_density;
+                float macro_velocity_x;
+                float macro_velocity_y;
+                float macro_velocity_z;
+
+                node_macroscopic_variables<lattice>(populations, speed_of_sound, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z);
+
+                bool fluid = device_accessor_changeable_buffer[node_index] == 0;
+
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    float population = fluid
+                        ? rescaled_population(i, populations[i], node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z, non_equilibrium_scale)
+                        : populations[i];
+
+                    device_accessor_coarse_to_fine_old[box_index * possible_velocities_number + i] = population;
+                    device_accessor_coarse_to_fine_new[box_index * possible_velocities_number + i] = population;
+                }
+            });
+        });
+    }
+
+    /**
+     * fills the refined nodes on the faces of the block in fine_discrete_density_buffer_1 (and their macroscopic variables),
+     * time_fraction of the way through the current coarse step, see fill_fine_nodes
+     */
+    void fill_fine_nodes_on_faces(float time_fraction)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if(this->face_width[axis] == 0)
+            {
+                continue;
+            }
+
+            // the two faces of this axis, the edges and corners are filled by two or three of the kernels with the same values
+            sycl::range<3> face_range = *this->fine_dims;
+            face_range[axis] = 2;
+
+            fill_fine_nodes(face_range, axis, time_fraction);
+        }
+    }
+
+    /**
+     * fills refined nodes in fine_discrete_density_buffer_1 from the coarse populations of the block,
+     * linearly interpolated in time, time_fraction of the way from coarse_to_fine_old to coarse_to_fine_new,
+     * and in space, from the 1, 2, 4 or 8 coarse nodes around the refined node
+     *
+     * fill_range covers the refined nodes to fill,
+     * with a face_axis of -1 it's the whole block, otherwise positions 0 and 1 along face_axis stand for the first and last refined node along it
+     */
+    void fill_fine_nodes(sycl::range<3> fill_range, int face_axis, float time_fraction)
+    {
+        sycl::range<3> local_fine_dims = *this->fine_dims;
+        uint64_t local_fine_node_count = this->fine_node_count->get(0);
+        sycl::range<3> local_box_dims = *this->box_dims;
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_coarse_to_fine_old(*this->coarse_to_fine_old, h);
+            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_coarse_to_fine_new(*this->coarse_to_fine_new, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_fine_discrete_density_buffer_1(*this->fine_discrete_density_buffer_1, h);
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_fine_macro_density(*this->fine_macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_fine_vectors(*this->fine_vectors, h);
+
+            h.parallel_for(fill_range, [=](sycl::id<3> fill_position)
+            {
+                int fine_position[3] = {(int) fill_position.get(0), (int) fill_position.get(1), (int) fill_position.get(2)};
+                if(face_axis >= 0)
+                {
+                    fine_position[face_axis] = fill_position.get(face_axis) == 0 ? 0 : local_fine_dims.get(face_axis) - 1;
+                }
+
+                uint64_t fine_index = fine_position[0]
+                                    + fine_position[1] * local_fine_dims.get(0)
+                                    + fine_position[2] * local_fine_dims.get(0) * local_fine_dims.get(1);
+
+                // the coarse node of the block at or below the refined node, and if the refined node is half way to the next one along each axis
+                int box_position[3];
+                bool between[3];
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    box_position[axis] = fine_position[axis] / refinement_scale<lattice>(axis);
+                    between[axis] = fine_position[axis] % refinement_scale<lattice>(axis) != 0;
+                }
+
+                float populations[possible_velocities_number] = {};
+
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    int offset[3] = {corner & 1, (corner >> 1) & 1, (corner >> 2) & 1};
+                    if((offset[0] && !between[0]) || (offset[1] && !between[1]) || (offset[2] && !between[2]))
+                    {
+                        continue;
+                    }
+
+                    float weight = (between[0] ? 0.5f : 1.0f) * (between[1] ? 0.5f : 1.0f) * (between[2] ? 0.5f : 1.0f);
+
+                    // wrapping around along the axes the block spans
+                    uint64_t box_index = wrap_coordinate(box_position[0] + offset[0], local_box_dims.get(0))
+                                       + wrap_coordinate(box_position[1] + offset[1], local_box_dims.get(1)) * local_box_dims.get(0)
+                                       + wrap_coordinate(box_position[2] + offset[2], local_box_dims.get(2)) * local_box_dims.get(0) * local_box_dims.get(1);
+
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        float old_population = device_accessor_coarse_to_fine_old[box_index * possible_velocities_number + i];
+                        float new_population = device_accessor_coarse_to_fine_new[box_index * possible_velocities_number + i];
+
+                        populations[i] += weight * (old_population + time_fraction * (new_population - old_population));
+                    }
+                }
+
+                // the collision keeps the density and velocity of fluid nodes, so they can be found from the post collision populations
+                float node_density;
+                float macro_velocity_x;
+                float macro_velocity_y;
+                float macro_velocity_z;
+
+                node_macroscopic_variables<lattice>(populations, speed_of_sound, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z);
+
+                device_accessor_fine_vectors[fine_index] = sycl::float4(macro_velocity_x, macro_velocity_y, macro_velocity_z, node_density);
+                device_accessor_fine_macro_density[fine_index] = node_density;
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_fine_discrete_density_buffer_1[layout::index(fine_index, i, local_fine_node_count, possible_velocities_number)] = storage::store(populations[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+    }
+
+    // copies the macroscopic variables of the coarse grid to the host side arrays that aren't public,
+    // then makes them the public ones, so a reader of vector_array and density_array never sees a half written frame
+    void copy_macroscopic_variables_to_host()
+    {
+        sycl::float4 * next_vector_array = this->which_vectors_array ? this->vectors1 : this->vectors2;
+        float * next_density_array = this->which_vectors_array ? this->density_array_1 : this->density_array_2;
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_macro_density(*this->macro_density_buffer, h);
+
+            h.copy(device_accessor_macro_density, next_density_array);
+        });
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_vectors(*this->vectors, h);
+
+            h.copy(device_accessor_vectors, next_vector_array);
+        });
+
+        this->q.wait();
+
+        this->vector_array.store(next_vector_array);
+        this->density_array.store(next_density_array);
+        this->which_vectors_array = !this->which_vectors_array;
+    }
+};
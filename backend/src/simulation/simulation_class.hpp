@@ -12,12 +12,24 @@
         https://medium.com/swlh/create-your-own-lattice-boltzmann-simulation-with-python-8759e8b53b1c
         https://medium.com/@ethan_38158/the-lattice-boltzmann-method-lbm-fluid-simulation-43a4fa248614
 */ 
+#pragma once
+
 #include <iostream> // used for debugging via std out
 #include <atomic> // will use for having two copies of the velocity buffers and having an atomic bool to switch between them
 #include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <utility> // std::swap, used to swap the two discrete density buffers
+#include <algorithm> // std::min for the default tile shape, std::lower_bound for finding stored nodes
+#include <stdexcept> // std::invalid_argument, thrown for settings the simulation or device can't run
+#include <vector> // the host side list of stored nodes of the sparse path
+#include <type_traits> // std::is_same, the reference collision kernel collides bgk_collision one population at a time
 
 #include "float4_helper_functions.hpp" // some helper functions that act on sycl::float4 variables as 3d vectors such as the dot product
 #include "buffer_debug_funcs.hpp" // some helper functions for use in debugging sycl buffers 
+#include "population_layouts.hpp" // the memory layouts the discrete density buffers can use
+#include "lattices.hpp" // the velocity sets the simulation can use
+#include "population_storage.hpp" // the number formats the discrete density buffers can be stored in
+#include "collision_operators.hpp" // the collision operators the fluid nodes can use
+#include "initial_geometry.hpp" // the node types the simulation starts with
 
 #include <sycl/sycl.hpp> // the main library used for parellelism 
 
@@ -36,7 +48,361 @@ inline float f_eq(float weight, float density, float velocity_i_x, float velocit
 }
 
 /**
- * this simulation uses the lattice boltzmann method (LBM) of computational fluid dynamics, currently a d3q27 (3 dimensional, 27 discrete velocities)
+ * which set of kernels next_frame uses to advance the simulation by one step
+ */
+enum class kernel_mode
+{
+    // the original three kernel path: streaming, macroscopic variables, then collision over every population,
+    // kept around as the reference the other modes are checked against
+    reference,
+
+    // one node-centric kernel that pulls the populations from the neighbouring nodes, 
+    // computes the macroscopic variables in registers, collides, and writes the populations once
+    fused,
+
+    // the fused kernel, but streaming in place with the AA-pattern so only discrete_density_buffer_1 is allocated,
+    // even steps pull from the neighbours and push to the neighbours, odd steps read and write the node's own populations,
+    // see: Bailey et al., "Accelerating Lattice Boltzmann Fluid Flow Simulations Using Graphics Processors" 
+    in_place,
+
+    // the fused kernel as an nd_range, each work group loads a tile of nodes plus a one node halo into local memory 
+    // and streams from there, the tile shape is set with set_tile_shape
+    tiled,
+
+    // the fused kernel over a list of the nodes that aren't buried inside of reflective boundaries,
+    // with a precomputed table of where each of their populations streams from, 
+    // only the listed nodes have populations stored so memory and time scale with the fluid volume, 
+    // nodes that aren't listed keep reporting the resting state
+    sparse,
+
+    // the fused kernel with every node colliding as a fluid node, so it never branches on the node type,
+    // followed by a small kernel over precomputed lists of boundary links that overwrites the populations of the boundary nodes,
+    // so the boundaries cost in proportion to their surface instead of the volume, see build_boundary_links
+    split_boundaries,
+
+    // the fused kernel on a grid padded with a shell of ghost nodes, one node thick along every axis the lattice moves along,
+    // small kernels copy the opposite faces into the ghost shell first, so every node streams with the same linear offsets without wrapping around
+    padded,
+
+    // the fused kernel with the populations stored brick by brick (4 by 4 by 4 nodes) instead of row by row, see brick_ordering,
+    // so the neighbours along y and z are mostly in the same few pages as the node instead of a row or a slice away,
+    // the node types and the macroscopic variables stay in row-major order
+    bricked,
+};
+
+/**
+ * wraps a coordinate that is at most one node out of bounds back around to the other side of the simulation,
+ * can't use the modulus operator   
+ */
+inline int wrap_coordinate(int value, int length)
+{
+    value = value < 0 ? length - 1 : value;
+    return value > (length - 1) ? 0 : value;
+}
+
+/**
+ * returns true if any velocity of the lattice moves along the given axis (0 = x, 1 = y, 2 = z),
+ * D2Q9 for example never moves along y, so nodes never need to wrap around in y
+ */
+template <typename lattice>
+constexpr bool lattice_moves_along(int axis)
+{
+    for (int i = 0; i < lattice::count; i++)
+    {
+        if(lattice::possible_velocities[i * 3 + axis] != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * the linear offset between a node and its neighbour along each velocity of the lattice,
+ * precomputed once so the kernels can stream interior nodes without any wrap around checks
+ * 
+ * stride[i] = e_i.x + e_i.y * width + e_i.z * width * height
+ */
+template <typename lattice>
+struct lattice_strides
+{
+    int64_t stride[lattice::count];
+
+    lattice_strides(int64_t width, int64_t height)
+    {
+        for (int i = 0; i < lattice::count; i++)
+        {
+            stride[i] = lattice::possible_velocities[i * 3]
+                      + lattice::possible_velocities[i * 3 + 1] * width
+                      + lattice::possible_velocities[i * 3 + 2] * width * height;
+        }
+    }
+};
+
+/**
+ * returns true if every neighbour of the node lies inside the simulation, 
+ * so its neighbours can be found with the precomputed strides instead of wrapping around
+ */
+template <typename lattice>
+inline bool is_interior_node(int node_x, int node_y, int node_z, const sycl::range<3> & dims)
+{
+    return (!lattice_moves_along<lattice>(0) || (node_x > 0 && node_x < (int) dims.get(0) - 1))
+        && (!lattice_moves_along<lattice>(1) || (node_y > 0 && node_y < (int) dims.get(1) - 1))
+        && (!lattice_moves_along<lattice>(2) || (node_z > 0 && node_z < (int) dims.get(2) - 1));
+}
+
+/**
+ * the number of ghost nodes on each side of the padded grid along the given axis (0 = x, 1 = y, 2 = z),
+ * 1 along the axes the lattice moves along and 0 along the others
+ */
+template <typename lattice>
+constexpr int ghost_width(int axis)
+{
+    return lattice_moves_along<lattice>(axis) ? 1 : 0;
+}
+
+/**
+ * returns the index in the padded grid of the node at the (unpadded) node position, 
+ * padded_dims are the dimensions of the padded grid, including the ghost nodes
+ */
+template <typename lattice>
+inline uint64_t padded_node_index(int node_x, int node_y, int node_z, const sycl::range<3> & padded_dims)
+{
+    return (node_x + ghost_width<lattice>(0))
+         + (node_y + ghost_width<lattice>(1)) * padded_dims.get(0)
+         + (node_z + ghost_width<lattice>(2)) * padded_dims.get(0) * padded_dims.get(1);
+}
+
+/**
+ * the order the bricked path stores the nodes in, 
+ * the simulation is cut into bricks of brick_size nodes along each axis, stored one after the other in row-major order of the bricks,
+ * with the nodes of a brick stored together in row-major order within the brick
+ * 
+ * the bricks on the far edges are cut short when a side isn't a multiple of brick_size, 
+ * so the nodes are stored without any gaps, index is a one to one mapping from the node positions to 0 to node_count - 1
+ */
+struct brick_ordering
+{
+    static constexpr int brick_size = 4;
+
+    int width;
+    int height;
+    int depth;
+
+    brick_ordering(int width, int height, int depth) : width(width), height(height), depth(depth) {}
+
+    // returns the position the node with the given position is stored at
+    inline uint64_t index(int node_x, int node_y, int node_z) const
+    {
+        int brick_x = node_x / brick_size;
+        int brick_y = node_y / brick_size;
+        int brick_z = node_z / brick_size;
+
+        // the size of the brick the node is in, and of the slice and row of bricks it is in
+        int brick_width  = sycl::min(brick_size, width - brick_x * brick_size);
+        int brick_height = sycl::min(brick_size, height - brick_y * brick_size);
+        int brick_depth  = sycl::min(brick_size, depth - brick_z * brick_size);
+
+        // every slice and row of bricks before this one is whole along the axis they are stacked on
+        uint64_t brick_start = (uint64_t) brick_z * brick_size * width * height
+                             + (uint64_t) brick_y * brick_size * width * brick_depth
+                             + (uint64_t) brick_x * brick_size * brick_height * brick_depth;
+
+        return brick_start 
+             + (node_x - brick_x * brick_size) 
+             + (node_y - brick_y * brick_size) * brick_width 
+             + (node_z - brick_z * brick_size) * brick_width * brick_height;
+    }
+
+    // finds the position of the node stored at stored_index, the inverse of index
+    inline void position(uint64_t stored_index, int & node_x, int & node_y, int & node_z) const
+    {
+        uint64_t slice_size = (uint64_t) brick_size * width * height;
+        int brick_z = stored_index / slice_size;
+        stored_index -= brick_z * slice_size;
+        int brick_depth = sycl::min(brick_size, depth - brick_z * brick_size);
+
+        uint64_t row_size = (uint64_t) brick_size * width * brick_depth;
+        int brick_y = stored_index / row_size;
+        stored_index -= brick_y * row_size;
+        int brick_height = sycl::min(brick_size, height - brick_y * brick_size);
+
+        uint64_t brick_node_count = (uint64_t) brick_size * brick_height * brick_depth;
+        int brick_x = stored_index / brick_node_count;
+        stored_index -= brick_x * brick_node_count;
+        int brick_width = sycl::min(brick_size, width - brick_x * brick_size);
+
+        node_x = brick_x * brick_size + stored_index % brick_width;
+        node_y = brick_y * brick_size + (stored_index / brick_width) % brick_height;
+        node_z = brick_z * brick_size + stored_index / (brick_width * brick_height);
+    }
+};
+
+/**
+ * returns the index of the node at the node position plus direction times velocity i, wrapping around the edges,
+ * direction is 1 for the node the velocity points to and -1 for the node it comes from
+ */
+template <typename lattice>
+inline uint64_t wrapped_neighbour_index(int node_x, int node_y, int node_z, uint8_t i, int direction, const sycl::range<3> & dims)
+{
+    return wrap_coordinate(node_x + direction * lattice::possible_velocities[i * 3],     dims.get(0))
+         + wrap_coordinate(node_y + direction * lattice::possible_velocities[i * 3 + 1], dims.get(1)) * dims.get(0)
+         + wrap_coordinate(node_z + direction * lattice::possible_velocities[i * 3 + 2], dims.get(2)) * dims.get(0) * dims.get(1);
+}
+
+/**
+ * computes the macroscopic density and velocity of one node from its (already streamed) populations,
+ * the velocity is clamped to the lattice speed of sound, same as the macroscopic variables kernel
+ */
+template <typename lattice>
+inline void node_macroscopic_variables(const float * populations, float speed_of_sound,
+                                       float & node_density, float & macro_velocity_x, float & macro_velocity_y, float & macro_velocity_z)
+{
+    node_density = 0.0f;
+
+    macro_velocity_x = 0.0f;
+    macro_velocity_y = 0.0f;
+    macro_velocity_z = 0.0f;
+
+    #pragma unroll
+    for (uint8_t i = 0; i < lattice::count; i++)
+    {
+        node_density += sycl::fabs(populations[i]); // absoulute value of density
+
+        macro_velocity_x += populations[i] * lattice::possible_velocities[i * 3];
+        macro_velocity_y += populations[i] * lattice::possible_velocities[i * 3 + 1];
+        macro_velocity_z += populations[i] * lattice::possible_velocities[i * 3 + 2];
+    }
+
+    macro_velocity_x /= node_density;
+    macro_velocity_y /= node_density;
+    macro_velocity_z /= node_density;
+
+    float macro_velocity_len = sycl::sqrt(macro_velocity_x * macro_velocity_x + macro_velocity_y * macro_velocity_y + macro_velocity_z * macro_velocity_z);
+    if(macro_velocity_len > speed_of_sound)
+    {
+        macro_velocity_x = (macro_velocity_x / macro_velocity_len) * speed_of_sound;
+        macro_velocity_y = (macro_velocity_y / macro_velocity_len) * speed_of_sound;
+        macro_velocity_z = (macro_velocity_z / macro_velocity_len) * speed_of_sound;
+    }
+}
+
+/**
+ * collides the (already streamed) populations of one node into collided, using the same rules as the reference collision kernel
+ * 
+ * node_type is the changeable_buffer value of the node,
+ * unknown node types pass their populations through unchanged,
+ * fluid nodes use the collision operator, see collision_operators.hpp,
+ * with the settings of parameters, see collision_parameters
+ */
+template <typename lattice, typename collision = bgk_collision>
+inline void node_collide(uint8_t node_type, const float * populations, float * collided,
+                         float tau, float node_density, float macro_velocity_x, float macro_velocity_y, float macro_velocity_z,
+                         float flow_vec_x, float flow_vec_y, float flow_vec_z, const collision_parameters & parameters = collision_parameters())
+{
+    switch (node_type)
+    {
+    case 0:
+        collision::template collide<lattice>(populations, collided, tau, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z, parameters);
+        break;
+
+    case 1:
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            collided[lattice::relective_index_table[i]] = populations[i];
+        }
+        break;
+
+    case 2:
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            collided[i] = f_eq
+            (
+                lattice::velocities_weights[i], 1.0f,
+                lattice::possible_velocities[i * 3],
+                lattice::possible_velocities[i * 3 + 1],
+                lattice::possible_velocities[i * 3 + 2],
+                flow_vec_x, flow_vec_y, flow_vec_z
+            );
+        }
+        break;
+
+    case 3:
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            collided[i] = lattice::velocities_weights[i];
+        }
+        break;
+
+    default:
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            collided[i] = populations[i];
+        }
+        break;
+    }
+}
+
+/**
+ * the per node step of every fused kernel, from the populations streaming into a node to the ones leaving it, 
+ * each kernel only loads the populations and stores collided with its own addressing
+ * 
+ * returns the macroscopic velocity and density of the node as (x, y, z, density), see node_macroscopic_variables,
+ * and collides the populations into collided by the rules of node_collide,
+ * unknown node types (above 3) aren't collided and keep their own populations of the last step, read through own_population(i), 
+ * same as the reference collision kernel, which doesn't write them
+ */
+template <typename lattice, typename collision, typename own_population_function>
+inline sycl::float4 node_update(const float * populations, uint8_t node_type, float * collided, float speed_of_sound,
+                                float tau, float flow_vec_x, float flow_vec_y, float flow_vec_z, const collision_parameters & parameters,
+                                own_population_function own_population)
+{
+    float node_density;
+
+    float macro_velocity_x;
+    float macro_velocity_y;
+    float macro_velocity_z;
+
+    node_macroscopic_variables<lattice>(populations, speed_of_sound, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z);
+
+    if(node_type > 3)
+    {
+        #pragma unroll
+        for (uint8_t i = 0; i < lattice::count; i++)
+        {
+            collided[i] = own_population(i);
+        }
+    }
+    else
+    {
+        node_collide<lattice, collision>(node_type, populations, collided,
+                                         tau, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z,
+                                         flow_vec_x, flow_vec_y, flow_vec_z, parameters);
+    }
+
+    return sycl::float4(macro_velocity_x, macro_velocity_y, macro_velocity_z, node_density);
+}
+
+/**
+ * returns the device a Simulation runs on, the default gpu, or the default cpu if there is no gpu
+ */
+inline sycl::device simulation_device()
+{
+    try {
+        return sycl::device(sycl::gpu_selector_v);
+    }
+    catch (sycl::exception const &e) {
+        return sycl::device(sycl::cpu_selector_v);
+    }
+}
+
+/**
+ * this simulation uses the lattice boltzmann method (LBM) of computational fluid dynamics, 
+ * with a velocity set chosen by the lattice template parameter, one of D2Q9, D3Q15, D3Q19 or D3Q27 (the default), see lattices.hpp
  * 
  * the simulation is made up of 
  *      a. nodes (points) in 3s space (which make up a rectangular prism)
@@ -53,7 +419,16 @@ inline float f_eq(float weight, float density, float velocity_i_x, float velocit
  * 
  * collision is the process of the previously advected particles colliding at their new positions
  * 
+ * layout is the memory layout of the discrete density buffers, one of aos_layout (the default), soa_layout, or aosoa_layout, 
+ * see population_layouts.hpp
+ * 
+ * storage is the number format of the discrete density buffers, one of fp32_storage (the default), fp16_storage, bf16_storage or fixed16_storage,
+ * the math is always done in 32 bit floats, see population_storage.hpp
+ * 
+ * collision is the collision operator of the fluid nodes, one of bgk_collision (the default), regularized_collision or mrt_collision,
+ * see collision_operators.hpp
  */
+template <typename lattice = D3Q27, typename layout = aos_layout, typename storage = fp32_storage, typename collision = bgk_collision>
 class Simulation
 {
     private:
@@ -63,128 +438,11 @@ class Simulation
 
         sycl::queue q;
 
-        // some senagagins but,
-        // these are the possible velocities the particles can take,
-        // stored in sequential groups of three (x, y, z), sorted from highest weight to lowest weight
-        // 
-        //      vector number * 3     = index of x value 
-        //      vector number * 3 + 1 = index of y value
-        //      vector number * 3 + 2 = index of z value
-        // 
-        // each componenet has a min value of -128, max value of 127
-        const int8_t possible_velocities[81] = {
-// vec #     value         dir      name 
-/* 0 */      0,  0,  0, //          origin
-
-/* 1 */      1,  0,  0, // x+       unit vectors
-/* 2 */      0,  1,  0, //    y+
-/* 3 */      0,  0,  1, //       z+
-/* 4 */     -1,  0,  0, // x-       inverse unit vectors
-/* 5 */      0, -1,  0, //    y- 
-/* 6 */      0,  0, -1, //       z-
-
-/* 7  */     1,  1,  0, // x+ y+    xy plane corners
-/* 8  */    -1,  1,  0, // x- y+ 
-/* 9  */     1, -1,  0, // x+ y- 
-/* 10 */    -1, -1,  0, // x- y- 
-/* 11 */     0,  1,  1, //    y+ z+ yz plane corners
-/* 12 */     0, -1,  1, //    y- z+
-/* 13 */     0,  1, -1, //    y+ z-
-/* 14 */     0, -1, -1, //    y- z-
-/* 15 */     1,  0,  1, // x+    z+ xz plane corners
-/* 16 */    -1,  0,  1, // x-    z+
-/* 17 */     1,  0, -1, // x+    z-
-/* 18 */    -1,  0, -1, // x-    z-
-
-/* 19 */     1,  1,  1, // x+ y+ z+ 3d corners
-/* 20 */     1,  1, -1, // x+ y+ z-
-/* 21 */     1, -1,  1, // x+ y- z+
-/* 22 */     1, -1, -1, // x+ y- z-
-/* 23 */    -1,  1,  1, // x- y+ z+
-/* 24 */    -1,  1, -1, // x- y+ z-
-/* 25 */    -1, -1,  1, // x- y- z+
-/* 26 */    -1, -1, -1, // x- y- z-
-        };
-
-        static const uint8_t possible_velocities_number = 27;
-
-        sycl::buffer<int8_t, 1> * possible_velocities_buffer; 
-
-
-        // these are the weights that each velocity has
-        // the weights add up to 1
-        const float velocities_weights[27] = {
-            8.0f / 27.0f, // for 1, (8 / 27)
-
-            2.0f / 27.0f, // for 6, (2 / 27)
-            2.0f / 27.0f, 
-            2.0f / 27.0f, 
-            2.0f / 27.0f, 
-            2.0f / 27.0f, 
-            2.0f / 27.0f, 
-
-            1.0f / 54.0f, // for 12, (1 / 54)
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-            1.0f / 54.0f, 
-
-            1.0f / 216.0f, // for 8, (1 / 216)
-            1.0f / 216.0f, 
-            1.0f / 216.0f, 
-            1.0f / 216.0f, 
-            1.0f / 216.0f,
-            1.0f / 216.0f,
-            1.0f / 216.0f,
-            1.0f / 216.0f,
-        };
-
-        sycl::buffer<float, 1> * velocities_weights_buffer; 
-
-        // used for collisions where the node is a reflective boundary node,
-        // where the changeable_buffer value of the node is equal to 1
-        const uint8_t relective_index_table_new[27] = {
-// vec #            x   y   z          x   y   z
-/* 0 */     0,  //  0,  0,  0 maps to  0,  0,  0
-
-/* 1 */     4,  //  1,  0,  0 maps to -1,  0,  0
-/* 2 */     5,  //  0,  1,  0 maps to  0, -1,  0
-/* 3 */     6,  //  0,  0,  1 maps to  0,  0, -1
-/* 4 */     1,  // -1,  0,  0 maps to  1,  0,  0
-/* 5 */     2,  //  0, -1,  0 maps to  0,  1,  0
-/* 6 */     3,  //  0,  0, -1 maps to  0,  0,  1
-
-/* 7  */    10, //  1,  1,  0 maps to -1, -1,  0
-/* 8  */    9,  // -1,  1,  0 maps to  1, -1,  0
-/* 9  */    8,  //  1, -1,  0 maps to -1,  1,  0
-/* 10 */    7,  // -1, -1,  0 maps to  1,  1,  0
-/* 11 */    14, //  0,  1,  1 maps to  0, -1, -1
-/* 12 */    13, //  0, -1,  1 maps to  0,  1, -1
-/* 13 */    12, //  0,  1, -1 maps to  0, -1,  1
-/* 14 */    11, //  0, -1, -1 maps to  0,  1,  1
-/* 15 */    18, //  1,  0,  1 maps to -1,  0, -1
-/* 16 */    17, // -1,  0,  1 maps to  1,  0, -1
-/* 17 */    16, //  1,  0, -1 maps to -1,  0,  1
-/* 18 */    15, // -1,  0, -1 maps to  1,  0,  1
-
-/* 19 */    26, //  1,  1,  1 maps to -1, -1, -1
-/* 20 */    25, //  1,  1, -1 maps to -1, -1,  1
-/* 21 */    24, //  1, -1,  1 maps to -1,  1, -1
-/* 22 */    23, //  1, -1, -1 maps to -1,  1,  1
-/* 23 */    22, // -1,  1,  1 maps to  1, -1, -1
-/* 24 */    21, // -1,  1, -1 maps to  1, -1,  1
-/* 25 */    20, // -1, -1,  1 maps to  1,  1, -1
-/* 26 */    19  // -1, -1, -1 maps to  1,  1,  1
-        };
-
-        sycl::buffer<uint8_t, 1> * relective_index_table_new_buffer; 
+        // the number of discrete velocities per node, see lattices.hpp
+        static constexpr uint8_t possible_velocities_number = lattice::count;
+
+        // the lattice tables (possible velocities, weights and reflections) are constexpr, see lattices.hpp,
+        // so the kernels read them directly and the compiler folds them into the unrolled loops
 
 
         const float flow_vec_x = 0.0f;
@@ -212,12 +470,13 @@ class Simulation
         // 3 = sink, set to weight values in the collision step
         sycl::buffer<uint8_t, 1> * changeable_buffer; 
 
-        // densities for each of the (27) velocities per position node. 
+        // densities for each of the (possible_velocities_number) velocities per position node. 
         // flattened into a 1d "array" of floats 
-        // index = x + y * 3 + z * 9 + node_index
-        // node_index = (node.x + node.y * width + node.z * width * height) * 27
-        sycl::buffer<float, 1> * discrete_density_buffer_1; // the old values for f(x, t, e_i) aka the values to read from    
-        sycl::buffer<float, 1> * discrete_density_buffer_2; // the new values for f(x, t, e_i) aka the values to write to
+        // index = layout::index(node_index, i, node_count, possible_velocities_number)
+        // node_index = node.x + node.y * width + node.z * width * height
+        // stored as storage::type, read with storage::load and written with storage::store
+        sycl::buffer<typename storage::type, 1> * discrete_density_buffer_1; // the old values for f(x, t, e_i) aka the values to read from    
+        sycl::buffer<typename storage::type, 1> * discrete_density_buffer_2; // the new values for f(x, t, e_i) aka the values to write to
 
         // the three dimensional dimensions of the simulation, 
         // the real size of one dimension length is the length of that dimension times the ref_len
@@ -228,6 +487,10 @@ class Simulation
         // equal to the width of the sim * the height * the depth
         sycl::range<1> * node_count;
 
+        // the linear offset from a node to its neighbour along each velocity,
+        // used to stream nodes that do not need to wrap around the edges
+        lattice_strides<lattice> * strides;
+
         ///////////////////////////////////////////////////////////////////////////////////////////////
         // these six reference vars allow for an a-dimentioned Lattice Boltzmann Method (LBM) solver //
         // this also allows for the solver to cover more types of fluids, more easily                //
@@ -255,6 +518,73 @@ class Simulation
         // a value above 0, values close to 0 become unstable
         float tau = 2.3f;
 
+        // the constant of the smagorinsky subgrid model, 0 (the default) turns it off, and the rates of mrt_collision, 
+        // see collision_parameters in collision_operators.hpp
+        collision_parameters collision_settings;
+
+        // which set of kernels is used by next_frame, see the kernel_mode enum above
+        kernel_mode mode;
+
+        // the number of nodes along each axis handled by one work group in the tiled kernels, the temporally blocked kernel can use a smaller tile, see fitting_time_block
+        sycl::range<3> * tile_shape;
+
+        // the most steps advance runs in one temporally blocked kernel, 
+        // more steps per block means less traffic to global memory but more nodes computed twice in the overlapping halos
+        int time_block_depth = 4;
+
+        // the steps per block the last call to advance ran, see get_used_time_block_depth
+        int used_time_block_depth = 0;
+
+        // the sparse path only, see build_sparse_nodes
+        //
+        // the number of stored nodes, the discrete density buffers hold one more, the resting node, at index sparse_node_count
+        uint64_t sparse_node_count = 0;
+        // the node index of each stored node, in increasing order
+        sycl::buffer<uint64_t, 1> * sparse_nodes = nullptr;
+        // which stored node each population streams from
+        // index = i * sparse_node_count + sparse_index
+        sycl::buffer<uint32_t, 1> * sparse_neighbours = nullptr;
+        // a host side copy of sparse_nodes, used to find the populations of a node
+        std::vector<uint64_t> sparse_node_indices;
+
+        // the split boundaries path only, see build_boundary_links
+        //
+        // the boundary links, node_index * possible_velocities_number + i, grouped by node type:
+        // the reflective links first, then the in flow links, the sink links, and last the links of unknown node types
+        sycl::buffer<uint64_t, 1> * boundary_links = nullptr;
+        uint64_t reflective_link_count = 0;
+        uint64_t inflow_link_count = 0;
+        uint64_t sink_link_count = 0;
+        uint64_t kept_link_count = 0;
+        // the populations of every in flow node, the equlibrium of the in flow velocity at a density of 1, computed once
+        sycl::buffer<float, 1> * inflow_populations = nullptr;
+
+        // the padded path only, see next_frame_padded
+        //
+        // the dimensions of the padded grid the discrete density buffers hold, the simulation plus the ghost shell,
+        // and the linear offsets between neighbours in it
+        sycl::range<3> * padded_dims = nullptr;
+        lattice_strides<lattice> * padded_strides = nullptr;
+
+        // the number of steps computed (or submitted) so far,
+        // the in place (AA-pattern) kernels alternate between even and odd steps
+        uint64_t time_step = 0;
+
+        // the step the newest host copy of the macroscopic variables was made after,
+        // and the host task that makes it public, see copy_macroscopic_variables_to_host
+        uint64_t host_copy_time_step = 0;
+        sycl::event host_copy_published;
+
+        // the step the macro state buffer were last written after,
+        // steps that nothing reads them after skip writing them, see next_frame
+        uint64_t macroscopic_time_step = 0;
+
+        // next_frame computes the macroscopic variables and copies them to the host every this many steps
+        int macroscopic_variables_interval = 1;
+
+        // makes the next call of next_frame compute the macroscopic variables, set from any thread by request_macroscopic_variables
+        std::atomic<bool> macroscopic_variables_requested{false};
+
         ///////////////////////////////////////////////
         // macroscopic variables                     //
         // Used in the collision operator of the LBM //
@@ -263,18 +593,15 @@ class Simulation
         float * density_array_1; 
         float * density_array_2; 
 
-        sycl::buffer<float, 1> * macro_density_buffer; // the macroscopic density (one per node)
-        sycl::buffer<float, 1> * macro_velocity_x; // the x component of the macroscopic velocity (one per node)
-        sycl::buffer<float, 1> * macro_velocity_y; // the y component of the macroscopic velocity (one per node)
-        sycl::buffer<float, 1> * macro_velocity_z; // the z component of the macroscopic velocity (one per node)
+        // the macroscopic velocity and density of each node packed together as (x, y, z, density), one per node,
+        // read by the collision kernel of the reference path and copied to the host in one piece
+        sycl::buffer<sycl::float4, 1> * macro_state;
 
-        // copy 1 of the vectors data  
+        // copy 1 of the vectors data, the host copy of macro_state
         sycl::float4* vectors1;
-        // copy 2 of the vectors data  
+        // copy 2 of the vectors data, the host copy of macro_state
         sycl::float4* vectors2;
 
-        sycl::buffer<sycl::float4, 1> * vectors;
-
         // which array is currently pointed to by the vector_array pointer
         // false means vectors1 is pointed to by vector_array
         // true means vectors2 is pointed to by vector_array
@@ -285,7 +612,7 @@ class Simulation
         // stable host instances of the macroscopic velocity and density array //
         /////////////////////////////////////////////////////////////////////////
 
-        // a value containing a pointer to the current macroscopic velocity array
+        // a value containing a pointer to the current macroscopic velocity array, with the density of each node in w
         std::atomic<sycl::float4*> vector_array; 
         // a value containing a pointer to the current macroscopic density array
         std::atomic<float*> density_array; 
@@ -297,17 +624,10 @@ class Simulation
     // visocity: the visocity of the fluid being modeled
     // speed_of_sound: the speed of sound of the fluid being modeled in meters per second
     // node_size: the distance between each node in meters
-    Simulation(int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau)
+    // mode: which set of kernels to run each step, the fused kernel by default
+    Simulation(int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau, kernel_mode mode = kernel_mode::fused)
     {
-        sycl::device d;
-        try {
-            d = sycl::device(sycl::gpu_selector_v);
-        }
-        catch (sycl::exception const &e) {
-            d = sycl::device(sycl::cpu_selector_v);
-        }
-
-        this->q = sycl::queue(d);
+        this->q = sycl::queue(simulation_device());
         std::cout << "running simulation on -> " << q.get_device().get_info<sycl::info::device::name>() << std::endl;
 
         this->height = height;
@@ -323,34 +643,70 @@ class Simulation
 
         this->tau = tau;
 
+        this->mode = mode;
+
+        // 4 by 4 by 4 tiles by default, or smaller for simulations thinner than that
+        this->tile_shape = new sycl::range<3>(std::min(width, 4), std::min(height, 4), std::min(depth, 4));
 
         this->dims = new sycl::range<3>(width, height, depth);
-        this->discrete_density_buffer_length = new sycl::range<1>(width * height * depth * possible_velocities_number);
         this->node_count = new sycl::range<1>(width * height * depth);
 
-        // constant values, 
-        // a list of the velocities per node
-        this->possible_velocities_buffer = new sycl::buffer<int8_t, 1>(this->possible_velocities, possible_velocities_number * 3);
-        // the weights asscociated with each velocity
-        this->velocities_weights_buffer  = new sycl::buffer<float, 1>(this->velocities_weights, possible_velocities_number);
-        // the reflected possible velocity index for a given possible velocity index
-        this->relective_index_table_new_buffer = new sycl::buffer<uint8_t, 1>(this->relective_index_table_new, possible_velocities_number);
+        // the linear offset to the neighbouring node along each velocity
+        this->strides = new lattice_strides<lattice>(width, height);
 
 
         // if this node is a boundary node, and which type is it
         this->changeable_buffer         = new sycl::buffer<uint8_t, 1>(*this->node_count);
+
+        // set which nodes are boundary nodes
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::write> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> i) 
+            {
+                int64_t index = i.get(0) + i.get(1) * width + i.get(2) * width * height;
+
+                device_accessor_changeable_buffer[index] = initial_node_type(i.get(0), i.get(1), i.get(2), width, height, depth, cyc_radius);
+            });
+        });
+        
+        // the number of nodes with populations in the discrete density buffers,
+        // every node, the stored nodes plus the resting node when sparse, or every node plus the ghost nodes when padded
+        uint64_t stored_node_count = this->node_count->get(0);
+        if(mode == kernel_mode::sparse)
+        {
+            build_sparse_nodes();
+            stored_node_count = this->sparse_node_count + 1;
+        }
+
+        if(mode == kernel_mode::split_boundaries)
+        {
+            build_boundary_links();
+        }
+
+        if(mode == kernel_mode::padded)
+        {
+            this->padded_dims = new sycl::range<3>(width + 2 * ghost_width<lattice>(0), height + 2 * ghost_width<lattice>(1), depth + 2 * ghost_width<lattice>(2));
+            this->padded_strides = new lattice_strides<lattice>(this->padded_dims->get(0), this->padded_dims->get(1));
+            stored_node_count = this->padded_dims->size();
+        }
+
+        this->discrete_density_buffer_length = new sycl::range<1>(layout::buffer_length(stored_node_count, possible_velocities_number));
+
         // a list of the paricle amounts for each descrete velocity for each node
-        this->discrete_density_buffer_1 = new sycl::buffer<float, 1>(*this->discrete_density_buffer_length);
+        this->discrete_density_buffer_1 = new sycl::buffer<typename storage::type, 1>(*this->discrete_density_buffer_length);
         // the second list of the paricle amounts for each descrete velocity for each nod
-        this->discrete_density_buffer_2 = new sycl::buffer<float, 1>(*this->discrete_density_buffer_length);
+        // not needed when streaming in place
+        this->discrete_density_buffer_2 = nullptr;
+        if(mode != kernel_mode::in_place)
+        {
+            this->discrete_density_buffer_2 = new sycl::buffer<typename storage::type, 1>(*this->discrete_density_buffer_length);
+        }
 
 
         // macrosopic varibles, used in the equlibrium density function defined above this class
-        this->macro_density_buffer = new sycl::buffer<float, 1>(*this->node_count);
-
-        this->macro_velocity_x = new sycl::buffer<float, 1>(*this->node_count);
-        this->macro_velocity_y = new sycl::buffer<float, 1>(*this->node_count);
-        this->macro_velocity_z = new sycl::buffer<float, 1>(*this->node_count);
+        this->macro_state = new sycl::buffer<sycl::float4, 1>(*this->node_count);
 
 
         // host side density arrays
@@ -360,154 +716,206 @@ class Simulation
         // public facing macro density array
         this->density_array.store(density_array_1);
         
-        // public facing macro velocity array
-        this->vectors = new sycl::buffer<sycl::float4, 1>(*this->node_count);
-
         // host side velocity arrays
         this->vectors1 = new sycl::float4[this->node_count->get(0)];
         this->vectors2 = new sycl::float4[this->node_count->get(0)];
 
         this->vector_array = vectors1;
 
+        uint64_t local_node_count = this->node_count->get(0);
+
         // initalize the descrete density buffer at their respective weights
         this->q.submit([&](sycl::handler& h) 
         {
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_velocities_weights(*this->velocities_weights_buffer, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
 
-            h.parallel_for(*this->discrete_density_buffer_length, [=](sycl::id<1> i) 
+            h.parallel_for(sycl::range<1>(stored_node_count * possible_velocities_number), [=](sycl::id<1> i) 
             {
-                device_accessor_discrete_density_buffer_1[i] = device_accessor_velocities_weights[i % 27];
+                float weight = lattice::velocities_weights[i % possible_velocities_number];
+                device_accessor_discrete_density_buffer_1[layout::index(i / possible_velocities_number, i % possible_velocities_number, stored_node_count, possible_velocities_number)] = storage::store(weight, weight);
             });
-        }).wait();
+        });
 
         // add a bit of random noise to it
+        // in node order, so every layout starts from the same populations
+        // (when sparse every node still draws its noise, so the stored nodes start from the same populations as the dense paths)
         {
             auto accessor = discrete_density_buffer_1->get_host_access();
-            for (uint64_t i = 0; i < discrete_density_buffer_length->get(0); i++)
-            {
-                accessor[i] += (rand() % 100) / 1000.0f; // + 0.00, 0.01, 0.02, to 0.99f
-            }  
-        }
-        
-        // set which nodes are boundary nodes
-        this->q.submit([&](sycl::handler& h) 
-        {
-            sycl::accessor<uint8_t, 1, sycl::access_mode::write> device_accessor_changeable_buffer(*this->changeable_buffer, h);
-
-            // currently a cylinder aligned along the y axis with radius r with the center at (width / 2), y, (depth / 6)
-            h.parallel_for(*this->dims, [=](sycl::id<3> i) 
+            for (uint64_t i = 0; i < local_node_count * possible_velocities_number; i++)
             {
-                int64_t index = i.get(0) + i.get(1) * width + i.get(2) * width * height;
-
-                device_accessor_changeable_buffer[index] = 0;
-
-                float r_square = cyc_radius * cyc_radius;
+                float noise = (rand() % 100) / 1000.0f; // + 0.00, 0.01, 0.02, to 0.99f
 
-                float x = i.get(0) - (width / 2.0f);
-                float z = i.get(2) - (depth / 6.0f);
-
-                if( x*x + z*z < r_square )
-                {
-                    device_accessor_changeable_buffer[index] = 1;
-                }
-
-                if(i.get(0) == 0 || i.get(0) == width - 1)
+                uint64_t node_index = i / possible_velocities_number;
+                if(mode == kernel_mode::sparse)
                 {
-                    // device_accessor_changeable_buffer[index] = 1;
+                    auto stored_node = std::lower_bound(this->sparse_node_indices.begin(), this->sparse_node_indices.end(), node_index);
+                    if(stored_node == this->sparse_node_indices.end() || *stored_node != node_index)
+                    {
+                        continue;
+                    }
+                    node_index = stored_node - this->sparse_node_indices.begin();
                 }
-                
-                if(i.get(2) == 0)
+                if(mode == kernel_mode::padded)
                 {
-                    device_accessor_changeable_buffer[index] = 2;
+                    node_index = padded_node_index<lattice>(node_index % width, (node_index / width) % height, node_index / (width * height), *this->padded_dims);
                 }
-                if(i.get(2) == depth - 1)
+                if(mode == kernel_mode::bricked)
                 {
-                    device_accessor_changeable_buffer[index] = 3;
+                    node_index = brick_ordering(width, height, depth).index(node_index % width, (node_index / width) % height, node_index / (width * height));
                 }
-            });
-        }).wait();
-        
-        // set up the vectors buffer with the initial values
-        this->q.submit([&](sycl::handler& h) 
-        {
-            sycl::accessor<int8_t, 1, sycl::access_mode::read> device_accessor_possible_velocities(*this->possible_velocities_buffer, h);
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_velocities_weights(*this->velocities_weights_buffer, h);
 
-            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_vectors(*this->vectors, h);
+                float weight = lattice::velocities_weights[i % possible_velocities_number];
+                uint64_t index = layout::index(node_index, i % possible_velocities_number, stored_node_count, possible_velocities_number);
 
-            h.parallel_for(*this->node_count, [=](sycl::id<1> i) 
-            { 
-                float vec_x = 0.0f;
-                float vec_y = 0.0f;
-                float vec_z = 0.0f;
-                
-                for(uint8_t i; i < possible_velocities_number; ++i)
-                {
-                    vec_x += device_accessor_velocities_weights[i] * device_accessor_possible_velocities[i * 3];
-                    vec_y += device_accessor_velocities_weights[i] * device_accessor_possible_velocities[i * 3 + 1];
-                    vec_z += device_accessor_velocities_weights[i] * device_accessor_possible_velocities[i * 3 + 2];
-                }
-                
-                device_accessor_vectors[i] = sycl::float4(vec_x, vec_y, vec_z, 0.0f);
-            });
-        }).wait();
+                accessor[index] = storage::store(storage::load(accessor[index], weight) + noise, weight);
+            }  
+        }
 
-        // prime the two vectors arrays
-        this->q.submit([&](sycl::handler& h) 
+        // the resting node of the sparse path is read by both buffers but never written, so both start with a copy of it
+        if(mode == kernel_mode::sparse)
         {
-            sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_vectors(*this->vectors, h);
+            this->q.submit([&](sycl::handler& h) 
+            {
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
 
-            h.copy(device_accessor_vectors, vectors1);
-        }).wait();
+                h.copy(device_accessor_discrete_density_buffer_1, device_accessor_discrete_density_buffer_2);
+            });
+        }
+        
+        // the initial velocity of every node, the velocities weighted by the populations at rest
+        float vec_x = 0.0f;
+        float vec_y = 0.0f;
+        float vec_z = 0.0f;
 
-        // prime the second vector array
-        this->q.submit([&](sycl::handler& h) 
+        for(uint8_t j = 0; j < possible_velocities_number; ++j)
         {
-            sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_vectors(*this->vectors, h);
-
-            h.copy(device_accessor_vectors, vectors2);
-        }).wait();
+            vec_x += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3];
+            vec_y += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3 + 1];
+            vec_z += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3 + 2];
+        }
 
-        // initalize the macro density buffer 
-        this->q.submit([&](sycl::handler& h) 
+        // initalize the macro state buffer with the initial velocity and the density of the noisy populations
+        if(mode != kernel_mode::sparse)
         {
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_density_buffer(*this->macro_density_buffer, h);
+            // the populations of a node are at its own index, its index in the padded grid when padded, or its index in brick order when bricked
+            bool padded = mode == kernel_mode::padded;
+            bool bricked = mode == kernel_mode::bricked;
+            sycl::range<3> local_stored_dims = padded ? *this->padded_dims : *this->dims;
+            brick_ordering ordering(width, height, depth);
 
-            h.parallel_for(*this->node_count, [=](sycl::id<1> i) 
+            this->q.submit([&](sycl::handler& h) 
             {
-                float density = 0.0f;
-                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+                sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+                h.parallel_for(*this->dims, [=](sycl::id<3> node_position) 
                 {
-                    density += device_accessor_discrete_density_buffer_1[i * 27 + i];
-                }
+                    uint64_t node_index = node_position.get(0) 
+                                        + node_position.get(1) * width 
+                                        + node_position.get(2) * width * height;
+
+                    uint64_t stored_index = padded ? padded_node_index<lattice>(node_position.get(0), node_position.get(1), node_position.get(2), local_stored_dims) 
+                                          : bricked ? ordering.index(node_position.get(0), node_position.get(1), node_position.get(2)) 
+                                          : node_index;
+
+                    float density = 0.0f;
+                    for (uint8_t j = 0; j < possible_velocities_number; j++)
+                    {
+                        density += storage::load(device_accessor_discrete_density_buffer_1[layout::index(stored_index, j, stored_node_count, possible_velocities_number)], lattice::velocities_weights[j]);
+                    }
+
+                    device_accessor_macro_state[node_index] = sycl::float4(vec_x, vec_y, vec_z, density);
+                });
+            });
+        }
+        else
+        {
+            // nodes that aren't stored are at rest, with a density of 1 (the sum of the weights)
+            this->q.submit([&](sycl::handler& h) 
+            {
+                sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
 
-                device_accessor_macro_density_buffer[i] = density;
+                h.fill(device_accessor_macro_state, sycl::float4(vec_x, vec_y, vec_z, 1.0f));
             });
-        }).wait();
 
-        this->q.submit([&](sycl::handler& h) 
-        {
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_density(*this->macro_density_buffer, h);
+            uint64_t local_stored_node_count = stored_node_count;
+
+            this->q.submit([&](sycl::handler& h) 
+            {
+                sycl::accessor<uint64_t, 1, sycl::access_mode::read> device_accessor_sparse_nodes(*this->sparse_nodes, h);
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+                sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
 
-            h.copy(device_accessor_density, density_array_1);
-        }).wait();
+                h.parallel_for(sycl::range<1>(this->sparse_node_count), [=](sycl::id<1> i) 
+                {
+                    float density = 0.0f;
+                    for (uint8_t j = 0; j < possible_velocities_number; j++)
+                    {
+                        density += storage::load(device_accessor_discrete_density_buffer_1[layout::index(i, j, local_stored_node_count, possible_velocities_number)], lattice::velocities_weights[j]);
+                    }
+
+                    device_accessor_macro_state[device_accessor_sparse_nodes[i]] = sycl::float4(vec_x, vec_y, vec_z, density);
+                });
+            });
+        }
 
+        // prime the two vectors arrays
         this->q.submit([&](sycl::handler& h) 
         {
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_density(*this->macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_macro_state(*this->macro_state, h);
 
-            h.copy(device_accessor_density, density_array_2);
-        }).wait();
+            h.copy(device_accessor_macro_state, vectors1);
+        });
 
         // make sure all jobs are complete
         q.wait();
+
+        // the second copy and the density arrays are unpacked from the first copy
+        for(uint64_t i = 0; i < local_node_count; ++i)
+        {
+            this->vectors2[i] = this->vectors1[i];
+            this->density_array_1[i] = this->vectors1[i].w();
+            this->density_array_2[i] = this->vectors1[i].w();
+        }
+    }
+
+    ~Simulation()
+    {
+        // the host tasks of the host copies use the host side arrays
+        this->q.wait();
+
+        delete this->dims;
+        delete this->node_count;
+        delete this->tile_shape;
+        delete this->strides;
+        delete this->discrete_density_buffer_length;
+
+        delete this->changeable_buffer;
+        delete this->discrete_density_buffer_1;
+        delete this->discrete_density_buffer_2;
+        delete this->macro_state;
+
+        delete this->sparse_nodes;
+        delete this->sparse_neighbours;
+        delete this->boundary_links;
+        delete this->inflow_populations;
+        delete this->padded_dims;
+        delete this->padded_strides;
+
+        delete[] this->density_array_1;
+        delete[] this->density_array_2;
+        delete[] this->vectors1;
+        delete[] this->vectors2;
     }
 
+    Simulation(const Simulation &) = delete;
+    Simulation & operator=(const Simulation &) = delete;
+
     // read-only access to the main density buffer,
     // useful for debugging and/or networking, as it will block any other job on/access to this buffer from running until the accessor is freed
-    sycl::host_accessor<float, 1, sycl::access_mode::read> get_accessor_for_discrete_density_buffer_1()
+    // the values are in the storage format, use read_population to get the populations as floats
+    sycl::host_accessor<typename storage::type, 1, sycl::access_mode::read> get_accessor_for_discrete_density_buffer_1()
     {
         return this->discrete_density_buffer_1->get_host_access();
     }
@@ -522,43 +930,494 @@ class Simulation
     /**
      * calculate the next state of the simulation using the values given
      * moving the sim to the next time with the calculated timestep (new_time = current + ref_time)
+     * 
+     * the macroscopic variables are only computed and copied to the host (vector_array and density_array)
+     * every get_macroscopic_variables_interval steps (every step by default), or after a call to request_macroscopic_variables,
+     * the other steps keep them in registers for the collision and write only the populations
      */
     void next_frame()
     {
-        int local_possible_velocities_count = this->possible_velocities_number;
+        // exchange, so a request made while this step runs is kept for the next one
+        bool requested = this->macroscopic_variables_requested.exchange(false);
+        bool materialize = requested || (this->time_step + 1) % this->macroscopic_variables_interval == 0;
 
-        sycl::range<3> local_dims = *this->dims;
-        sycl::range<1> local_velocity_buffer_length = *this->discrete_density_buffer_length;
-
-        float local_tau = this->tau;
+        sycl::event compute_macroscopic_variables = submit_step(materialize);
 
-        float local_flow_vec_x = this->flow_vec_x;
-        float local_flow_vec_y = this->flow_vec_y;
-        float local_flow_vec_z = this->flow_vec_z;
+        ++this->time_step;
 
-        sycl::event compute_streaming = 
-        this->q.submit([&](sycl::handler& h) 
+        if(materialize)
         {
-            sycl::accessor<int8_t, 1, sycl::access_mode::read> device_accessor_possible_velocities(*this->possible_velocities_buffer, h);
+            copy_macroscopic_variables_to_host(compute_macroscopic_variables);
+        }
 
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+        this->q.wait();
+    }
 
-            h.parallel_for(*this->dims, [=](sycl::id<3> node_position) 
-            {
-                int node_x = node_position.get(0);
-                int node_y = node_position.get(1);
-                int node_z = node_position.get(2);
-                // WARNING -> a 64 bit integer supports up to a cube of ~ 880_748 by 880_748 by 880_748 nodes
-                //                  = x + y * width + z * width * height;
-                uint64_t node_index = (
-                                      node_x                                  
-                                    + node_y * local_dims.get(0) 
-                                    + node_z * local_dims.get(0) * local_dims.get(1)
-                                    ) * 27; 
+    /**
+     * enqueues n_steps steps back to back and returns without waiting for any of them
+     * 
+     * host_copy_interval: copy the macroscopic variables to the host every that many steps, 0 (the default) for never,
+     * each copy is made public (vector_array and density_array) by a host task as soon as it lands, so the host never waits for it,
+     * only the steps that are copied and the last step compute the macroscopic variables
+     * 
+     * returns the event of the last step, or of its host copy if it has one,
+     * call snapshot to wait for every submitted step and make the newest macroscopic variables public
+     */
+    sycl::event submit_steps(int n_steps, int host_copy_interval = 0)
+    {
+        // a default constructed event is already complete
+        sycl::event last_submitted;
 
-                // copy the velocity with value (0, 0, 0)  
-                device_accessor_discrete_density_buffer_2[node_index] = device_accessor_discrete_density_buffer_1[node_index];
+        for (int step = 1; step <= n_steps; step++)
+        {
+            bool host_copy = host_copy_interval > 0 && step % host_copy_interval == 0;
+
+            // the last step always computes them, so snapshot finds the newest ones
+            last_submitted = submit_step(host_copy || step == n_steps);
+
+            ++this->time_step;
+
+            if(host_copy)
+            {
+                last_submitted = copy_macroscopic_variables_to_host(last_submitted);
+            }
+        }
+
+        return last_submitted;
+    }
+
+    /**
+     * waits for every submitted step, 
+     * and makes the newest computed macroscopic variables public (vector_array and density_array), copying them to the host if they aren't yet,
+     * these are of the last step unless next_frame skipped them, see get_macroscopic_variables_time_step
+     */
+    void snapshot()
+    {
+        if(this->host_copy_time_step != this->macroscopic_time_step)
+        {
+            // the copies read the macro state buffer, so they already wait for the last step that wrote them
+            copy_macroscopic_variables_to_host(sycl::event());
+        }
+
+        this->q.wait();
+    }
+
+    /**
+     * calculate the state of the simulation n_steps steps ahead, 
+     * the same steps as calling next_frame n_steps times, 
+     * but only copying the macroscopic variables to the host after the last step
+     * 
+     * the fused and tiled modes advance up to time_block_depth steps at a time with the temporally blocked kernel
+     * (see next_frames_time_blocked), which reads and writes the populations in global memory once per block of steps,
+     * with the deepest block and the biggest tile, no bigger than tile_shape, that fit in the device's local memory (see fitting_time_block),
+     * get_used_time_block_depth returns the depth that was run,
+     * the other modes run their own kernel once per step, the reference mode stays the unfused baseline
+     */
+    void advance(int n_steps)
+    {
+        if(n_steps <= 0)
+        {
+            return;
+        }
+
+        sycl::event compute_macroscopic_variables;
+
+        bool time_blocked = this->mode == kernel_mode::fused || this->mode == kernel_mode::tiled;
+
+        int depth = 1;
+        sycl::range<3> block_tile_shape = *this->tile_shape;
+        if(time_blocked)
+        {
+            fitting_time_block(depth, block_tile_shape);
+        }
+
+        // a single step gains nothing from the blocked kernel
+        this->used_time_block_depth = std::min(depth, n_steps);
+
+        int steps_left = n_steps;
+        while(steps_left > 0)
+        {
+            // no block of 2 steps fits in local memory, or only one step is left
+            if(depth < 2 || steps_left == 1)
+            {
+                compute_macroscopic_variables = submit_step(steps_left == 1);
+
+                ++this->time_step;
+                --steps_left;
+                continue;
+            }
+
+            int steps = std::min(depth, steps_left);
+
+            compute_macroscopic_variables = next_frames_time_blocked(steps, block_tile_shape, steps == steps_left);
+
+            this->time_step += steps;
+            steps_left -= steps;
+        }
+
+        // the blocked kernel of the last block doesn't go through submit_step
+        this->macroscopic_time_step = this->time_step;
+
+        copy_macroscopic_variables_to_host(compute_macroscopic_variables);
+
+        this->q.wait();
+    }
+
+    /**
+     * sets the most steps advance runs in one temporally blocked kernel,
+     * advance shrinks the tile of the block, and then lowers the depth, until the tile plus its halo of depth nodes fits in the device's local memory
+     * 
+     * throws std::invalid_argument if depth is less than 1
+     */
+    void set_time_block_depth(int depth)
+    {
+        if(depth < 1)
+        {
+            throw std::invalid_argument("set_time_block_depth: the depth must be at least 1 step");
+        }
+
+        this->time_block_depth = depth;
+    }
+
+    // returns the most steps advance runs in one temporally blocked kernel
+    int get_time_block_depth()
+    {
+        return this->time_block_depth;
+    }
+
+    // returns the steps per temporally blocked kernel the last call to advance ran, 1 if it ran one kernel per step, 0 before the first call
+    int get_used_time_block_depth()
+    {
+        return this->used_time_block_depth;
+    }
+
+    /**
+     * sets the constant of the smagorinsky subgrid model, which adds the eddy viscosity of the scales the grid can't resolve to the fluid nodes,
+     * so flows with a higher reynolds number than the grid resolves stay stable, 0 turns it off (the default),
+     * values from 0.1 to 0.2 are usual, can be changed between any two frames
+     * 
+     * throws std::invalid_argument if the constant is below 0
+     */
+    void set_smagorinsky_constant(float smagorinsky_constant)
+    {
+        if(smagorinsky_constant < 0.0f)
+        {
+            throw std::invalid_argument("set_smagorinsky_constant: the constant must be at least 0");
+        }
+
+        this->collision_settings.smagorinsky_constant = smagorinsky_constant;
+    }
+
+    // returns the constant of the smagorinsky subgrid model, 0 when it is off
+    float get_smagorinsky_constant()
+    {
+        return this->collision_settings.smagorinsky_constant;
+    }
+
+    /**
+     * sets the relaxation rates of the bulk moments (the trace of the non equilibrium stress) and of the ghost moments of mrt_collision,
+     * a higher bulk rate damps pressure waves faster, the ghost moments don't take part in the flow,
+     * both are 1 by default, the other collision operators ignore them, can be changed between any two frames
+     * 
+     * throws std::invalid_argument if a rate isn't above 0 and below 2, where the relaxation of the moment is stable
+     */
+    void set_mrt_rates(float bulk_rate, float ghost_rate)
+    {
+        if(!(bulk_rate > 0.0f && bulk_rate < 2.0f) || !(ghost_rate > 0.0f && ghost_rate < 2.0f))
+        {
+            throw std::invalid_argument("set_mrt_rates: the rates must be above 0 and below 2");
+        }
+
+        this->collision_settings.bulk_rate = bulk_rate;
+        this->collision_settings.ghost_rate = ghost_rate;
+    }
+
+    // returns the relaxation rate of the bulk moments of mrt_collision
+    float get_mrt_bulk_rate()
+    {
+        return this->collision_settings.bulk_rate;
+    }
+
+    // returns the relaxation rate of the ghost moments of mrt_collision
+    float get_mrt_ghost_rate()
+    {
+        return this->collision_settings.ghost_rate;
+    }
+
+    /**
+     * sets how often next_frame computes the macroscopic variables and copies them to the host (vector_array and density_array),
+     * every step by default, a batch run that looks at every 100th frame can skip the other 99
+     * 
+     * throws std::invalid_argument if interval is less than 1 step
+     */
+    void set_macroscopic_variables_interval(int interval)
+    {
+        if(interval < 1)
+        {
+            throw std::invalid_argument("set_macroscopic_variables_interval: the interval must be at least 1 step");
+        }
+
+        this->macroscopic_variables_interval = interval;
+    }
+
+    // returns how often next_frame computes the macroscopic variables and copies them to the host
+    int get_macroscopic_variables_interval()
+    {
+        return this->macroscopic_variables_interval;
+    }
+
+    /**
+     * makes the next call of next_frame compute the macroscopic variables and copy them to the host, whatever the interval,
+     * safe to call from any thread, for example by a socket server when a client asks for a frame
+     */
+    void request_macroscopic_variables()
+    {
+        this->macroscopic_variables_requested.store(true);
+    }
+
+    // returns the step the newest computed macroscopic variables are of, which snapshot makes public
+    uint64_t get_macroscopic_variables_time_step()
+    {
+        return this->macroscopic_time_step;
+    }
+
+    // returns which set of kernels is used to advance the simulation
+    kernel_mode get_kernel_mode()
+    {
+        return this->mode;
+    }
+
+    /**
+     * sets the number of nodes along each axis handled by one work group of the tiled kernel,
+     * can be changed between any two frames, for example while tuning
+     * 
+     * throws std::invalid_argument if the work group or the tile plus its halo don't fit on the device
+     */
+    void set_tile_shape(sycl::range<3> shape)
+    {
+        if(shape.size() == 0)
+        {
+            throw std::invalid_argument("set_tile_shape: the tile shape must be at least 1 node along each axis");
+        }
+
+        sycl::device device = this->q.get_device();
+
+        if(shape.size() > device.get_info<sycl::info::device::max_work_group_size>())
+        {
+            throw std::invalid_argument("set_tile_shape: the tile has more nodes than the device's max work group size");
+        }
+
+        uint64_t local_memory_needed = tiled_halo_shape(shape).size() * possible_velocities_number * sizeof(float);
+        if(local_memory_needed > device.get_info<sycl::info::device::local_mem_size>())
+        {
+            throw std::invalid_argument("set_tile_shape: the tile plus its halo does not fit in the device's local memory");
+        }
+
+        *this->tile_shape = shape;
+    }
+
+    // returns the number of nodes along each axis handled by one work group of the tiled kernel
+    sycl::range<3> get_tile_shape()
+    {
+        return *this->tile_shape;
+    }
+
+    // returns the number of nodes with populations in the discrete density buffers,
+    // every node, only the nodes that aren't buried inside of reflective boundaries when sparse, or every node plus the ghost nodes when padded
+    uint64_t get_stored_node_count()
+    {
+        if(this->mode == kernel_mode::sparse)
+        {
+            return this->sparse_node_count;
+        }
+        if(this->mode == kernel_mode::padded)
+        {
+            return this->padded_dims->size();
+        }
+        return this->node_count->get(0);
+    }
+
+    // returns the bytes of device memory held by the buffers of this simulation
+    uint64_t get_device_memory_bytes()
+    {
+        // the populations, the node types and the macroscopic state of every node
+        uint64_t bytes = this->discrete_density_buffer_1->byte_size() + this->changeable_buffer->byte_size() + this->macro_state->byte_size();
+
+        // the buffers only some of the kernel modes have
+        if(this->discrete_density_buffer_2 != nullptr) { bytes += this->discrete_density_buffer_2->byte_size(); }
+        if(this->sparse_nodes != nullptr)              { bytes += this->sparse_nodes->byte_size(); }
+        if(this->sparse_neighbours != nullptr)         { bytes += this->sparse_neighbours->byte_size(); }
+        if(this->boundary_links != nullptr)            { bytes += this->boundary_links->byte_size(); }
+        if(this->inflow_populations != nullptr)        { bytes += this->inflow_populations->byte_size(); }
+
+        return bytes;
+    }
+
+    // returns the bytes of host memory held by the two copies of the macroscopic variables (vector_array and density_array)
+    uint64_t get_host_memory_bytes()
+    {
+        return 2 * this->node_count->get(0) * (sizeof(sycl::float4) + sizeof(float));
+    }
+
+    /**
+     * returns the index into discrete_density_buffer_1 of the post collision population of velocity i at the node with index node_index,
+     * the same value the reference path stores at layout::index(node_index, i, node_count, possible_velocities_number)
+     * 
+     * when streaming in place, after an odd number of steps the populations are stored at the node they are about to stream to, 
+     * in the slot of the reflected velocity
+     * 
+     * when sparse, nodes that aren't stored read the populations of the resting node
+     * 
+     * when padded, the populations of a node are at its index in the padded grid
+     * 
+     * when bricked, the populations of a node are at its index in brick order
+     */
+    uint64_t population_index(uint64_t node_index, uint8_t i)
+    {
+        if(this->mode == kernel_mode::sparse)
+        {
+            auto stored_node = std::lower_bound(this->sparse_node_indices.begin(), this->sparse_node_indices.end(), node_index);
+
+            uint64_t sparse_index = this->sparse_node_count;
+            if(stored_node != this->sparse_node_indices.end() && *stored_node == node_index)
+            {
+                sparse_index = stored_node - this->sparse_node_indices.begin();
+            }
+
+            return layout::index(sparse_index, i, this->sparse_node_count + 1, possible_velocities_number);
+        }
+
+        if(this->mode == kernel_mode::padded)
+        {
+            uint64_t stored_index = padded_node_index<lattice>(node_index % this->width, (node_index / this->width) % this->height, node_index / (this->width * this->height), *this->padded_dims);
+
+            return layout::index(stored_index, i, this->padded_dims->size(), possible_velocities_number);
+        }
+
+        if(this->mode == kernel_mode::bricked)
+        {
+            uint64_t stored_index = brick_ordering(this->width, this->height, this->depth).index(node_index % this->width, (node_index / this->width) % this->height, node_index / (this->width * this->height));
+
+            return layout::index(stored_index, i, this->node_count->get(0), possible_velocities_number);
+        }
+
+        if(this->mode != kernel_mode::in_place || this->time_step % 2 == 0)
+        {
+            return layout::index(node_index, i, this->node_count->get(0), possible_velocities_number);
+        }
+
+        int node_x = node_index % this->width;
+        int node_y = (node_index / this->width) % this->height;
+        int node_z = node_index / (this->width * this->height);
+
+        int to_node_x = wrap_coordinate(node_x + lattice::possible_velocities[i * 3],     this->width);
+        int to_node_y = wrap_coordinate(node_y + lattice::possible_velocities[i * 3 + 1], this->height);
+        int to_node_z = wrap_coordinate(node_z + lattice::possible_velocities[i * 3 + 2], this->depth);
+
+        uint64_t to_node_index = to_node_x + to_node_y * this->width + to_node_z * this->width * this->height;
+
+        return layout::index(to_node_index, lattice::relective_index_table[i], this->node_count->get(0), possible_velocities_number);
+    }
+
+    /**
+     * returns the post collision population of velocity i at the node with index node_index as a float,
+     * read through an accessor from get_accessor_for_discrete_density_buffer_1
+     */
+    float read_population(const sycl::host_accessor<typename storage::type, 1, sycl::access_mode::read> & accessor, uint64_t node_index, uint8_t i)
+    {
+        uint64_t index = population_index(node_index, i);
+
+        // when streaming in place the population may sit in the slot of the reflected velocity, the weights of the two are the same
+        return storage::load(accessor[index], lattice::velocities_weights[i]);
+    }
+
+    private:
+
+    /**
+     * submits the kernels of one step of the current mode, 
+     * which write the macro state buffer when write_macroscopic_variables is true,
+     * the reference mode always writes them, its collision kernel reads them
+     * 
+     * returns the event of the kernel that writes the macro state buffer
+     */
+    sycl::event submit_step(bool write_macroscopic_variables)
+    {
+        if(write_macroscopic_variables || this->mode == kernel_mode::reference)
+        {
+            // the callers count the step once it is submitted
+            this->macroscopic_time_step = this->time_step + 1;
+        }
+
+        switch (this->mode)
+        {
+        case kernel_mode::reference:
+            return next_frame_reference();
+
+        case kernel_mode::fused:
+            return next_frame_fused(write_macroscopic_variables);
+
+        case kernel_mode::in_place:
+            return next_frame_in_place(write_macroscopic_variables);
+
+        case kernel_mode::tiled:
+            return next_frame_tiled(write_macroscopic_variables);
+
+        case kernel_mode::sparse:
+            return next_frame_sparse(write_macroscopic_variables);
+
+        case kernel_mode::split_boundaries:
+            return next_frame_split_boundaries(write_macroscopic_variables);
+
+        case kernel_mode::padded:
+            return next_frame_padded(write_macroscopic_variables);
+
+        case kernel_mode::bricked:
+            return next_frame_bricked(write_macroscopic_variables);
+        }
+
+        return sycl::event();
+    }
+
+    /**
+     * the reference path, 
+     * streams from discrete_density_buffer_1 into discrete_density_buffer_2, 
+     * computes the macroscopic variables from discrete_density_buffer_2,
+     * then collides every population back into discrete_density_buffer_1
+     * 
+     * returns the event of the kernel that writes the macro state buffer
+     */
+    sycl::event next_frame_reference()
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        sycl::event compute_streaming = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> node_position) 
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+                // WARNING -> a 64 bit integer supports up to a cube of ~ 880_748 by 880_748 by 880_748 nodes
+                //                  = x + y * width + z * width * height;
+                uint64_t node_index = node_x                                  
+                                    + node_y * local_dims.get(0) 
+                                    + node_z * local_dims.get(0) * local_dims.get(1); 
+
+                // copy the velocity with value (0, 0, 0)  
+                // (a population keeps its velocity when streaming, so the stored value can be copied as is)
+                device_accessor_discrete_density_buffer_2[layout::index(node_index, 0, local_node_count, possible_velocities_number)] = device_accessor_discrete_density_buffer_1[layout::index(node_index, 0, local_node_count, possible_velocities_number)];
 
                 int from_node_x;
                 int from_node_y;
@@ -566,11 +1425,11 @@ class Simulation
 
                 // loop over all the rest of the vectors and grab the particles that will move to the current node,
                 // and assign them to the associated velocity on the current node
-                for (uint8_t i = 1; i < local_possible_velocities_count; i++)
+                for (uint8_t i = 1; i < possible_velocities_number; i++)
                 {
-                    from_node_x = node_x - device_accessor_possible_velocities[i * 3];
-                    from_node_y = node_y - device_accessor_possible_velocities[i * 3 + 1];
-                    from_node_z = node_z - device_accessor_possible_velocities[i * 3 + 2];
+                    from_node_x = node_x - lattice::possible_velocities[i * 3];
+                    from_node_y = node_y - lattice::possible_velocities[i * 3 + 1];
+                    from_node_z = node_z - lattice::possible_velocities[i * 3 + 2];
 
                     // do these checks to make sure the from node is in bounds, 
                     // can't use the modulus operator   
@@ -584,14 +1443,12 @@ class Simulation
 
                     // get where the particles are coming from
                     // if the position to get the particles from is out of bounds it wraps around (the modulo operation)
-                    uint64_t from_node_index = (
-                                               from_node_x
+                    uint64_t from_node_index = from_node_x
                                              + from_node_y * local_dims.get(0) 
-                                             + from_node_z * local_dims.get(0) * local_dims.get(1)
-                                            ) * 27;
+                                             + from_node_z * local_dims.get(0) * local_dims.get(1);
 
                     // move the particles to current node with their velocity 
-                    device_accessor_discrete_density_buffer_2[node_index + i] = device_accessor_discrete_density_buffer_1[from_node_index + i];
+                    device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)];
                 }
             });
         });
@@ -601,17 +1458,9 @@ class Simulation
         {
             h.depends_on(compute_streaming);
             
-            sycl::accessor<int8_t, 1, sycl::access_mode::read> device_accessor_possible_velocities(*this->possible_velocities_buffer, h);
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
-            
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_density(*this->macro_density_buffer, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
             
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_velocity_x(*this->macro_velocity_x, h);
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_velocity_y(*this->macro_velocity_y, h);
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_velocity_z(*this->macro_velocity_z, h);
-
-            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_vectors(*this->vectors, h); // temp-ish copy of the macro velocity
-
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
 
             h.parallel_for(*this->node_count, [=](sycl::id<1> node_index) 
             {
@@ -621,15 +1470,15 @@ class Simulation
                 float macro_velocity_y = 0.0f;
                 float macro_velocity_z = 0.0f;
 
-                for (uint8_t i = 0; i < local_possible_velocities_count; i++)
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
                 {
-                    float density = device_accessor_discrete_density_buffer_2[node_index * local_possible_velocities_count + i];
+                    float density = storage::load(device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
 
                     node_density += sycl::fabs(density); // absoulute value of density
 
-                    macro_velocity_x += density * device_accessor_possible_velocities[i * 3];
-                    macro_velocity_y += density * device_accessor_possible_velocities[i * 3 + 1];
-                    macro_velocity_z += density * device_accessor_possible_velocities[i * 3 + 2];
+                    macro_velocity_x += density * lattice::possible_velocities[i * 3];
+                    macro_velocity_y += density * lattice::possible_velocities[i * 3 + 1];
+                    macro_velocity_z += density * lattice::possible_velocities[i * 3 + 2];
                 }
 
                 macro_velocity_x /= node_density;
@@ -644,13 +1493,7 @@ class Simulation
                     macro_velocity_z = (macro_velocity_z / macro_velocity_len) * speed_of_sound;
                 }
 
-                device_accessor_macro_velocity_x[node_index] = macro_velocity_x;
-                device_accessor_macro_velocity_y[node_index] = macro_velocity_y;
-                device_accessor_macro_velocity_z[node_index] = macro_velocity_z;
-
-                device_accessor_vectors[node_index] = sycl::float4(macro_velocity_x, macro_velocity_y, macro_velocity_z, 0.0f);
-                
-                device_accessor_macro_density[node_index] = node_density;
+                device_accessor_macro_state[node_index] = sycl::float4(macro_velocity_x, macro_velocity_y, macro_velocity_z, node_density);
             });
         });
 
@@ -660,71 +1503,93 @@ class Simulation
         {
             h.depends_on(compute_macroscopic_variables);
 
-            sycl::accessor<int8_t, 1, sycl::access_mode::read> device_accessor_possible_velocities(*this->possible_velocities_buffer, h);
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_velocities_weights(*this->velocities_weights_buffer, h);
-            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_relective_index_table_new(*this->relective_index_table_new_buffer, h);
-            
             sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
 
             // microscopic density 
-            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
 
             // macroscopic variables
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_macro_density(*this->macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_macro_state(*this->macro_state, h);
 
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_macro_velocity_x(*this->macro_velocity_x, h);
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_macro_velocity_y(*this->macro_velocity_y, h);
-            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_macro_velocity_z(*this->macro_velocity_z, h);
-
-            h.parallel_for(*this->discrete_density_buffer_length, [=](sycl::id<1> i) 
+            h.parallel_for(sycl::range<1>(local_node_count * possible_velocities_number), [=](sycl::id<1> population_number) 
             {
-                int local_velocity_index = i % local_possible_velocities_count;
-                int node_index = i / 27;
+                int local_velocity_index = population_number % possible_velocities_number;
+                int node_index = population_number / possible_velocities_number;
+
+                // where the population is stored in the discrete density buffers
+                uint64_t i = layout::index(node_index, local_velocity_index, local_node_count, possible_velocities_number);
 
-                float weight = device_accessor_velocities_weights[local_velocity_index];
+                float weight = lattice::velocities_weights[local_velocity_index];
 
                 float equlibrium_density;
+                float density;
                 uint64_t new_index;
+
+                // velocity x, y, z and density
+                sycl::float4 node_macro_state;
                 
                 switch (device_accessor_changeable_buffer[node_index])
                 {
                 case 0:
-                    equlibrium_density = f_eq
-                    (
-                        weight, device_accessor_macro_density[node_index], // specific velocity, and the node specific density 
-                        device_accessor_possible_velocities[local_velocity_index * 3],     // velocity (e_i) x val
-                        device_accessor_possible_velocities[local_velocity_index * 3 + 1], // velocity (e_i) y val
-                        device_accessor_possible_velocities[local_velocity_index * 3 + 2], // velocity (e_i) z val
-                        device_accessor_macro_velocity_x[node_index], // node specific avg velocity
-                        device_accessor_macro_velocity_y[node_index], // node specific avg velocity
-                        device_accessor_macro_velocity_z[node_index]  // node specific avg velocity
-                    );
-                    device_accessor_discrete_density_buffer_1[i] = device_accessor_discrete_density_buffer_2[i] - (local_tau * (device_accessor_discrete_density_buffer_2[i] - equlibrium_density));
+                    node_macro_state = device_accessor_macro_state[node_index];
+
+                    if (std::is_same<collision, bgk_collision>::value && local_collision_parameters.smagorinsky_constant == 0.0f)
+                    {
+                        equlibrium_density = f_eq
+                        (
+                            weight, node_macro_state.w(), // specific velocity, and the node specific density 
+                            lattice::possible_velocities[local_velocity_index * 3],     // velocity (e_i) x val
+                            lattice::possible_velocities[local_velocity_index * 3 + 1], // velocity (e_i) y val
+                            lattice::possible_velocities[local_velocity_index * 3 + 2], // velocity (e_i) z val
+                            node_macro_state.x(), // node specific avg velocity
+                            node_macro_state.y(), // node specific avg velocity
+                            node_macro_state.z()  // node specific avg velocity
+                        );
+                        density = storage::load(device_accessor_discrete_density_buffer_2[i], weight);
+                        device_accessor_discrete_density_buffer_1[i] = storage::store(density - (local_tau * (density - equlibrium_density)), weight);
+                    }
+                    else
+                    {
+                        // the other collision operators and the smagorinsky subgrid model mix the populations of the node, so each work item reads all of them
+                        float populations[possible_velocities_number];
+                        for (uint8_t j = 0; j < possible_velocities_number; j++)
+                        {
+                            populations[j] = storage::load(device_accessor_discrete_density_buffer_2[layout::index(node_index, j, local_node_count, possible_velocities_number)], lattice::velocities_weights[j]);
+                        }
+
+                        float collided[possible_velocities_number];
+                        collision::template collide<lattice>(populations, collided, local_tau, node_macro_state.w(),
+                                                             node_macro_state.x(), node_macro_state.y(), node_macro_state.z(),
+                                                             local_collision_parameters);
+
+                        device_accessor_discrete_density_buffer_1[i] = storage::store(collided[local_velocity_index], weight);
+                    }
                     break;
                 
                 case 1:
-                    new_index = device_accessor_relective_index_table_new[local_velocity_index] + (node_index * 27);
-                    device_accessor_discrete_density_buffer_1[new_index] = device_accessor_discrete_density_buffer_2[i];
+                    new_index = layout::index(node_index, lattice::relective_index_table[local_velocity_index], local_node_count, possible_velocities_number);
+                    density = storage::load(device_accessor_discrete_density_buffer_2[i], weight);
+                    device_accessor_discrete_density_buffer_1[new_index] = storage::store(density, lattice::velocities_weights[lattice::relective_index_table[local_velocity_index]]);
                     break;
 
                 case 2:
                     equlibrium_density = f_eq
                     (
                         weight, 1.0f, // specific velocity, and the node specific density 
-                        device_accessor_possible_velocities[local_velocity_index * 3],     // velocity (e_i) x val
-                        device_accessor_possible_velocities[local_velocity_index * 3 + 1], // velocity (e_i) y val
-                        device_accessor_possible_velocities[local_velocity_index * 3 + 2], // velocity (e_i) z val
+                        lattice::possible_velocities[local_velocity_index * 3],     // velocity (e_i) x val
+                        lattice::possible_velocities[local_velocity_index * 3 + 1], // velocity (e_i) y val
+                        lattice::possible_velocities[local_velocity_index * 3 + 2], // velocity (e_i) z val
                         local_flow_vec_x, // in / out flow x velocity
                         local_flow_vec_y, // in / out flow y velocity
                         local_flow_vec_z  // in / out flow z velocity
                     );
 
-                    device_accessor_discrete_density_buffer_1[i] = equlibrium_density;
+                    device_accessor_discrete_density_buffer_1[i] = storage::store(equlibrium_density, weight);
                     break;
 
                 case 3:
-                    device_accessor_discrete_density_buffer_1[i] = weight;
+                    device_accessor_discrete_density_buffer_1[i] = storage::store(weight, weight);
                 break;
 
                 default:
@@ -732,62 +1597,1300 @@ class Simulation
                 }
             });
         });
-        
-        // copy the vectors buffer data to one of the vector arrays on the host 
-        if(which_vectors_array)
-        {
-            this->q.submit([&](sycl::handler& h) 
-            {
-                h.depends_on(compute_macroscopic_variables);
 
-                sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_vectors(*this->vectors, h);
-
-                h.copy(device_accessor_vectors, vectors1);
+        return compute_macroscopic_variables;
+    }
 
-                this->vector_array = vectors1;
-                this->which_vectors_array = !this->which_vectors_array;
-            });
-            
-            this->q.submit([&](sycl::handler& h) 
-            {
-                h.depends_on(compute_macroscopic_variables);
+    /**
+     * the fused path, 
+     * one work item per node pulls its populations from discrete_density_buffer_1, 
+     * computes the density and velocity in registers, collides, and writes the result to discrete_density_buffer_2 once,
+     * then the two buffer pointers are swapped so discrete_density_buffer_1 always holds the newest populations
+     * 
+     * each node runs node_update, the same rules as the reference path, 
+     * while reading and writing each population only once per step
+     * 
+     * returns the event of the kernel, which also writes the macro state buffer when write_macroscopic_variables is true
+     */
+    sycl::event next_frame_fused(bool write_macroscopic_variables)
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        lattice_strides<lattice> local_strides = *this->strides;
 
-                sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_density(*this->macro_density_buffer, h);
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
 
-                h.copy(device_accessor_density, density_array_1);
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
 
-                this->density_array.store(density_array_1);
-            });
-        }
-        else
+        sycl::event compute_stream_and_collide = 
+        this->q.submit([&](sycl::handler& h) 
         {
-            this->q.submit([&](sycl::handler& h) 
-            {
-                h.depends_on(compute_macroscopic_variables);
-
-                sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_vectors(*this->vectors, h);
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
 
-                h.copy(device_accessor_vectors, vectors2);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
 
-                this->vector_array = vectors2;
-                this->which_vectors_array = !this->which_vectors_array;
-            });
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
 
-            this->q.submit([&](sycl::handler& h) 
+            h.parallel_for(*this->dims, [=](sycl::id<3> node_position) 
             {
-                h.depends_on(compute_macroscopic_variables);
-
-                sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_density(*this->macro_density_buffer, h);
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+
+                uint64_t node_index = node_x 
+                                    + node_y * local_dims.get(0) 
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                // the populations that stream into this node this step
+                float populations[possible_velocities_number];
+
+                if(is_interior_node<lattice>(node_x, node_y, node_z, local_dims))
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index - local_strides.stride[i], i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+                else
+                {
+                    // wrap around the edges, same as in the reference streaming kernel
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        uint64_t from_node_index = wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, local_dims);
+
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, collision>(populations, device_accessor_changeable_buffer[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, local_collision_parameters,
+                    [&](uint8_t i) { return storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                // only the steps the macroscopic variables are read after write them, see next_frame
+                if(write_macroscopic_variables)
+                {
+                    device_accessor_macro_state[node_index] = node_macro_state;
+                }
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        // the newly written populations become the ones to read from next step
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * the in place path (AA-pattern), only discrete_density_buffer_1 is used
+     * 
+     * even steps start from the reference layout (the post collision populations of a node in the node's own slots),
+     * each node pulls population i from slot i of the node at x - e_i, collides,
+     * and pushes the result for velocity i into the reflected slot of the node at x + e_i
+     * 
+     * odd steps find the populations streamed to a node already in the node's own (reflected) slots, 
+     * so each node reads its reflected slots, collides, and writes back into its own slots, returning to the reference layout
+     * 
+     * in both steps the set of slots a node writes is exactly the set it read, so no two work items touch the same slot.
+     * bounce back (changeable_buffer value of 1) needs no special handling, the reflection happens in registers during the collision
+     * 
+     * returns the event of the kernel, which also writes the macro state buffer when write_macroscopic_variables is true
+     */
+    sycl::event next_frame_in_place(bool write_macroscopic_variables)
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        lattice_strides<lattice> local_strides = *this->strides;
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        bool local_even_step = (this->time_step % 2) == 0;
+
+        sycl::event compute_stream_and_collide = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read_write> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> node_position) 
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+
+                uint64_t node_index = node_x 
+                                    + node_y * local_dims.get(0) 
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                bool interior = is_interior_node<lattice>(node_x, node_y, node_z, local_dims);
+
+                // the populations that stream into this node this step
+                float populations[possible_velocities_number];
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    if(local_even_step)
+                    {
+                        uint64_t from_node_index = interior ? node_index - local_strides.stride[i] : wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, local_dims);
+
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                    else
+                    {
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, lattice::relective_index_table[i], local_node_count, possible_velocities_number)], lattice::velocities_weights[lattice::relective_index_table[i]]);
+                    }
+                }
+
+                float collided[possible_velocities_number];
+
+                // the slots a node read on an even step are written by its neighbours in the same step, 
+                // so unknown node types can't keep their populations where they are, they pass the streamed ones on instead
+                sycl::float4 node_macro_state = node_update<lattice, collision>(populations, device_accessor_changeable_buffer[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, local_collision_parameters,
+                    [&](uint8_t i) { return populations[i]; });
+
+                if(write_macroscopic_variables)
+                {
+                    device_accessor_macro_state[node_index] = node_macro_state;
+                }
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    if(local_even_step)
+                    {
+                        uint64_t to_node_index = interior ? node_index + local_strides.stride[i] : wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, 1, local_dims);
+
+                        device_accessor_discrete_density_buffer_1[layout::index(to_node_index, lattice::relective_index_table[i], local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[lattice::relective_index_table[i]]);
+                    }
+                    else
+                    {
+                        device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                    }
+                }
+            });
+        });
+
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * the tiled path, the fused kernel launched as an nd_range with one work group per tile of nodes
+     * 
+     * each work group first loads its tile plus a one node halo (only along the axes the lattice moves along) into local memory,
+     * every population of the tile and halo is read from global memory once per work group instead of once per neighbouring work item,
+     * then each work item streams its populations from local memory, collides, and writes to discrete_density_buffer_2
+     * 
+     * the global range is rounded up to a multiple of the tile shape, work items outside of the simulation only help load the tile
+     * 
+     * returns the event of the kernel, which also writes the macro state buffer when write_macroscopic_variables is true
+     */
+    sycl::event next_frame_tiled(bool write_macroscopic_variables)
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+
+        sycl::range<3> local_tile_shape = *this->tile_shape;
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        // the halo is only needed along the axes the lattice moves along
+        const int halo_x = lattice_moves_along<lattice>(0) ? 1 : 0;
+        const int halo_y = lattice_moves_along<lattice>(1) ? 1 : 0;
+        const int halo_z = lattice_moves_along<lattice>(2) ? 1 : 0;
+
+        sycl::range<3> halo_tile_shape = tiled_halo_shape(local_tile_shape);
+
+        // round the global range up to a whole number of tiles
+        sycl::range<3> global_range(
+            ((local_dims.get(0) + local_tile_shape.get(0) - 1) / local_tile_shape.get(0)) * local_tile_shape.get(0),
+            ((local_dims.get(1) + local_tile_shape.get(1) - 1) / local_tile_shape.get(1)) * local_tile_shape.get(1),
+            ((local_dims.get(2) + local_tile_shape.get(2) - 1) / local_tile_shape.get(2)) * local_tile_shape.get(2)
+        );
+
+        sycl::event compute_stream_and_collide = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+            // the populations of the tile and its halo, node by node
+            sycl::local_accessor<float, 1> tile(sycl::range<1>(halo_tile_shape.size() * possible_velocities_number), h);
+
+            h.parallel_for(sycl::nd_range<3>(global_range, local_tile_shape), [=](sycl::nd_item<3> item) 
+            {
+                int tile_origin_x = item.get_group(0) * local_tile_shape.get(0);
+                int tile_origin_y = item.get_group(1) * local_tile_shape.get(1);
+                int tile_origin_z = item.get_group(2) * local_tile_shape.get(2);
+
+                // load the tile and its halo, each work item loading every local_size'th node
+                size_t local_id = item.get_local_linear_id();
+                size_t local_size = local_tile_shape.size();
+
+                for (size_t tile_node = local_id; tile_node < halo_tile_shape.size(); tile_node += local_size)
+                {
+                    int tile_x = tile_node % halo_tile_shape.get(0);
+                    int tile_y = (tile_node / halo_tile_shape.get(0)) % halo_tile_shape.get(1);
+                    int tile_z = tile_node / (halo_tile_shape.get(0) * halo_tile_shape.get(1));
+
+                    // wrap around the edges, halo nodes past a partial tile at the far edge wrap to valid (unused) nodes
+                    uint64_t from_node_index = wrap_coordinate(tile_origin_x + tile_x - halo_x, local_dims.get(0))
+                                             + wrap_coordinate(tile_origin_y + tile_y - halo_y, local_dims.get(1)) * local_dims.get(0)
+                                             + wrap_coordinate(tile_origin_z + tile_z - halo_z, local_dims.get(2)) * local_dims.get(0) * local_dims.get(1);
+
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        tile[tile_node * possible_velocities_number + i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+
+                sycl::group_barrier(item.get_group());
+
+                int node_x = item.get_global_id(0);
+                int node_y = item.get_global_id(1);
+                int node_z = item.get_global_id(2);
+
+                // work items past the edge of the simulation only help to load the tile
+                if(node_x >= (int) local_dims.get(0) || node_y >= (int) local_dims.get(1) || node_z >= (int) local_dims.get(2))
+                {
+                    return;
+                }
+
+                uint64_t node_index = node_x 
+                                    + node_y * local_dims.get(0) 
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                // the position of this node in the tile, including the halo
+                int tile_x = item.get_local_id(0) + halo_x;
+                int tile_y = item.get_local_id(1) + halo_y;
+                int tile_z = item.get_local_id(2) + halo_z;
+
+                // the populations that stream into this node this step
+                float populations[possible_velocities_number];
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    size_t from_tile_node = (tile_x - lattice::possible_velocities[i * 3])
+                                          + (tile_y - lattice::possible_velocities[i * 3 + 1]) * halo_tile_shape.get(0)
+                                          + (tile_z - lattice::possible_velocities[i * 3 + 2]) * halo_tile_shape.get(0) * halo_tile_shape.get(1);
+
+                    populations[i] = tile[from_tile_node * possible_velocities_number + i];
+                }
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, collision>(populations, device_accessor_changeable_buffer[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, local_collision_parameters,
+                    [&](uint8_t i) { return storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                if(write_macroscopic_variables)
+                {
+                    device_accessor_macro_state[node_index] = node_macro_state;
+                }
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
 
-                h.copy(device_accessor_density, density_array_2);
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * returns the shape of a tile plus its halo, 
+     * the halo is one node on each side along the axes the lattice moves along
+     */
+    sycl::range<3> tiled_halo_shape(sycl::range<3> tile_shape)
+    {
+        return sycl::range<3>(
+            tile_shape.get(0) + (lattice_moves_along<lattice>(0) ? 2 : 0),
+            tile_shape.get(1) + (lattice_moves_along<lattice>(1) ? 2 : 0),
+            tile_shape.get(2) + (lattice_moves_along<lattice>(2) ? 2 : 0)
+        );
+    }
+
+    /**
+     * the temporally blocked path, advances the simulation by depth steps with one nd_range kernel
+     * 
+     * each work group loads its tile of nodes plus a halo of depth nodes (along the axes the lattice moves along) into local memory,
+     * then runs depth fused steps there, each step computing one node less of the halo on every side,
+     * after the last step only the tile itself is left and is written back to discrete_density_buffer_2,
+     * the halos of neighbouring tiles overlap, so their nodes are computed more than once instead of syncing between work groups
+     * 
+     * every population is read from and written to global memory once per depth steps instead of once per step,
+     * and is rounded to the storage format after each step like between two steps of the fused kernel,
+     * precision_report checks that advance stays within its mode_tolerance of the fused path
+     * 
+     * local_tile_shape is the tile of one work group, see fitting_time_block
+     * 
+     * returns the event of the kernel, which also writes the macro state buffer of the last step when write_macroscopic_variables is true
+     */
+    sycl::event next_frames_time_blocked(int depth, sycl::range<3> local_tile_shape, bool write_macroscopic_variables)
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        // the halo is only needed along the axes the lattice moves along
+        const int halo_x = lattice_moves_along<lattice>(0) ? depth : 0;
+        const int halo_y = lattice_moves_along<lattice>(1) ? depth : 0;
+        const int halo_z = lattice_moves_along<lattice>(2) ? depth : 0;
+
+        sycl::range<3> block_shape = time_block_shape(local_tile_shape, depth);
+
+        // round the global range up to a whole number of tiles
+        sycl::range<3> global_range(
+            ((local_dims.get(0) + local_tile_shape.get(0) - 1) / local_tile_shape.get(0)) * local_tile_shape.get(0),
+            ((local_dims.get(1) + local_tile_shape.get(1) - 1) / local_tile_shape.get(1)) * local_tile_shape.get(1),
+            ((local_dims.get(2) + local_tile_shape.get(2) - 1) / local_tile_shape.get(2)) * local_tile_shape.get(2)
+        );
+
+        sycl::event compute_stream_and_collide = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+            // the populations of the block before and after each step, node by node, and the node types of the block
+            sycl::local_accessor<float, 1> block_populations_1(sycl::range<1>(block_shape.size() * possible_velocities_number), h);
+            sycl::local_accessor<float, 1> block_populations_2(sycl::range<1>(block_shape.size() * possible_velocities_number), h);
+            sycl::local_accessor<uint8_t, 1> block_node_types(sycl::range<1>(block_shape.size()), h);
+
+            h.parallel_for(sycl::nd_range<3>(global_range, local_tile_shape), [=](sycl::nd_item<3> item) 
+            {
+                int block_origin_x = item.get_group(0) * local_tile_shape.get(0) - halo_x;
+                int block_origin_y = item.get_group(1) * local_tile_shape.get(1) - halo_y;
+                int block_origin_z = item.get_group(2) * local_tile_shape.get(2) - halo_z;
+
+                size_t local_id = item.get_local_linear_id();
+                size_t local_size = local_tile_shape.size();
+
+                // the node of the simulation each node of the block is a copy of, 
+                // the halo can reach around the edges more than once on small simulations
+                auto block_node_index = [=](size_t block_node) -> uint64_t
+                {
+                    int block_x = block_node % block_shape.get(0);
+                    int block_y = (block_node / block_shape.get(0)) % block_shape.get(1);
+                    int block_z = block_node / (block_shape.get(0) * block_shape.get(1));
+
+                    int node_x = ((block_origin_x + block_x) % (int) local_dims.get(0) + (int) local_dims.get(0)) % (int) local_dims.get(0);
+                    int node_y = ((block_origin_y + block_y) % (int) local_dims.get(1) + (int) local_dims.get(1)) % (int) local_dims.get(1);
+                    int node_z = ((block_origin_z + block_z) % (int) local_dims.get(2) + (int) local_dims.get(2)) % (int) local_dims.get(2);
+
+                    return node_x + node_y * local_dims.get(0) + node_z * local_dims.get(0) * local_dims.get(1);
+                };
+
+                // load the block, each work item loading every local_size'th node
+                for (size_t block_node = local_id; block_node < block_shape.size(); block_node += local_size)
+                {
+                    uint64_t node_index = block_node_index(block_node);
+
+                    block_node_types[block_node] = device_accessor_changeable_buffer[node_index];
+
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        block_populations_1[block_node * possible_velocities_number + i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
 
-                this->density_array.store(density_array_2);
+                sycl::group_barrier(item.get_group());
+
+                for (int step = 0; step < depth; step++)
+                {
+                    // each step leaves one more node of the halo on every side out, the last step computes only the tile
+                    int margin = step + 1;
+                    bool last_step = step == depth - 1;
+
+                    // step reads from one of the two local arrays and writes the other
+                    const sycl::local_accessor<float, 1> & from_populations = step % 2 == 0 ? block_populations_1 : block_populations_2;
+                    const sycl::local_accessor<float, 1> & to_populations   = step % 2 == 0 ? block_populations_2 : block_populations_1;
+
+                    for (size_t block_node = local_id; block_node < block_shape.size(); block_node += local_size)
+                    {
+                        int block_x = block_node % block_shape.get(0);
+                        int block_y = (block_node / block_shape.get(0)) % block_shape.get(1);
+                        int block_z = block_node / (block_shape.get(0) * block_shape.get(1));
+
+                        if((halo_x > 0 && (block_x < margin || block_x >= (int) block_shape.get(0) - margin)) ||
+                           (halo_y > 0 && (block_y < margin || block_y >= (int) block_shape.get(1) - margin)) ||
+                           (halo_z > 0 && (block_z < margin || block_z >= (int) block_shape.get(2) - margin)))
+                        {
+                            continue;
+                        }
+
+                        // the populations that stream into this node this step
+                        float populations[possible_velocities_number];
+
+                        #pragma unroll
+                        for (uint8_t i = 0; i < possible_velocities_number; i++)
+                        {
+                            size_t from_block_node = (block_x - lattice::possible_velocities[i * 3])
+                                                   + (block_y - lattice::possible_velocities[i * 3 + 1]) * block_shape.get(0)
+                                                   + (block_z - lattice::possible_velocities[i * 3 + 2]) * block_shape.get(0) * block_shape.get(1);
+
+                            populations[i] = from_populations[from_block_node * possible_velocities_number + i];
+                        }
+
+                        float collided[possible_velocities_number];
+
+                        sycl::float4 node_macro_state = node_update<lattice, collision>(populations, block_node_types[block_node], collided, speed_of_sound,
+                            local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, local_collision_parameters,
+                            [&](uint8_t i) { return from_populations[block_node * possible_velocities_number + i]; });
+
+                        if(!last_step)
+                        {
+                            #pragma unroll
+                            for (uint8_t i = 0; i < possible_velocities_number; i++)
+                            {
+                                // rounded to the storage format, same as storing them between steps
+                                to_populations[block_node * possible_velocities_number + i] = storage::load(storage::store(collided[i], lattice::velocities_weights[i]), lattice::velocities_weights[i]);
+                            }
+                            continue;
+                        }
+
+                        // the tile of a work group at the far edge can reach past the end of the simulation
+                        int node_x = block_origin_x + block_x;
+                        int node_y = block_origin_y + block_y;
+                        int node_z = block_origin_z + block_z;
+
+                        if(node_x >= (int) local_dims.get(0) || node_y >= (int) local_dims.get(1) || node_z >= (int) local_dims.get(2))
+                        {
+                            continue;
+                        }
+
+                        uint64_t node_index = node_x 
+                                            + node_y * local_dims.get(0) 
+                                            + node_z * local_dims.get(0) * local_dims.get(1);
+
+                        if(write_macroscopic_variables)
+                        {
+                            device_accessor_macro_state[node_index] = node_macro_state;
+                        }
+
+                        #pragma unroll
+                        for (uint8_t i = 0; i < possible_velocities_number; i++)
+                        {
+                            device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                        }
+                    }
+
+                    sycl::group_barrier(item.get_group());
+                }
             });
+        });
+
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * returns the shape of a tile plus a halo of depth nodes on each side,
+     * along the axes the lattice moves along
+     */
+    sycl::range<3> time_block_shape(sycl::range<3> tile_shape, int depth)
+    {
+        return sycl::range<3>(
+            tile_shape.get(0) + (lattice_moves_along<lattice>(0) ? 2 * depth : 0),
+            tile_shape.get(1) + (lattice_moves_along<lattice>(1) ? 2 * depth : 0),
+            tile_shape.get(2) + (lattice_moves_along<lattice>(2) ? 2 * depth : 0)
+        );
+    }
+
+    /**
+     * picks the most steps, up to time_block_depth, one temporally blocked kernel can run, and the tile of its work groups,
+     * so that the tile plus its halo fits in the device's local memory
+     * 
+     * for each depth, from time_block_depth down, the longest axis of tile_shape is halved until the block fits,
+     * keeping the tile at least depth nodes wide along the axes the lattice moves along, 
+     * a thinner tile would compute more halo nodes than it keeps,
+     * depth is set to 1 if no block of 2 or more steps fits
+     */
+    void fitting_time_block(int & depth, sycl::range<3> & block_tile_shape)
+    {
+        uint64_t local_memory_size = this->q.get_device().template get_info<sycl::info::device::local_mem_size>();
+
+        for (depth = this->time_block_depth; depth > 1; depth--)
+        {
+            block_tile_shape = *this->tile_shape;
+
+            while(true)
+            {
+                // two copies of the populations and the node types
+                uint64_t local_memory_needed = time_block_shape(block_tile_shape, depth).size() * (2 * possible_velocities_number * sizeof(float) + sizeof(uint8_t));
+                if(local_memory_needed <= local_memory_size)
+                {
+                    return;
+                }
+
+                // the longest axis that can still be halved
+                int longest_axis = -1;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    size_t halved = block_tile_shape.get(axis) / 2;
+                    if(halved < 1 || (lattice_moves_along<lattice>(axis) && halved < (size_t) depth))
+                    {
+                        continue;
+                    }
+
+                    if(longest_axis == -1 || block_tile_shape.get(axis) > block_tile_shape.get(longest_axis))
+                    {
+                        longest_axis = axis;
+                    }
+                }
+
+                if(longest_axis == -1)
+                {
+                    break;
+                }
+
+                block_tile_shape[longest_axis] = block_tile_shape.get(longest_axis) / 2;
+            }
         }
 
-        this->q.wait();
+        depth = 1;
+        block_tile_shape = *this->tile_shape;
+    }
+
+    /**
+     * the sparse path, the fused kernel run over the list of stored nodes instead of over every node of the simulation
+     * 
+     * one work item per stored node pulls its populations through the neighbour table, 
+     * so no wrap around math is needed, computes the density and velocity in registers, collides, 
+     * and writes the result to discrete_density_buffer_2, then the two buffer pointers are swapped
+     * 
+     * returns the event of the kernel, which also writes the macro state buffer of the stored nodes when write_macroscopic_variables is true
+     */
+    sycl::event next_frame_sparse(bool write_macroscopic_variables)
+    {
+        uint64_t local_sparse_node_count = this->sparse_node_count;
+
+        // the stored nodes plus the resting node at the end
+        uint64_t local_stored_node_count = this->sparse_node_count + 1;
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        sycl::event compute_stream_and_collide = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<uint64_t, 1, sycl::access_mode::read> device_accessor_sparse_nodes(*this->sparse_nodes, h);
+            sycl::accessor<uint32_t, 1, sycl::access_mode::read> device_accessor_sparse_neighbours(*this->sparse_neighbours, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+            h.parallel_for(sycl::range<1>(local_sparse_node_count), [=](sycl::id<1> sparse_index) 
+            {
+                uint64_t node_index = device_accessor_sparse_nodes[sparse_index];
+
+                // the populations that stream into this node this step
+                float populations[possible_velocities_number];
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    uint64_t from_sparse_index = device_accessor_sparse_neighbours[i * local_sparse_node_count + sparse_index];
+
+                    populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_sparse_index, i, local_stored_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                }
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, collision>(populations, device_accessor_changeable_buffer[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, local_collision_parameters,
+                    [&](uint8_t i) { return storage::load(device_accessor_discrete_density_buffer_1[layout::index(sparse_index, i, local_stored_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                if(write_macroscopic_variables)
+                {
+                    device_accessor_macro_state[node_index] = node_macro_state;
+                }
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_discrete_density_buffer_2[layout::index(sparse_index, i, local_stored_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * builds the list of stored nodes and the neighbour table of the sparse path from changeable_buffer
+     * 
+     * a node is stored unless it is a reflective node (type 1) whose neighbours are all reflective nodes too,
+     * the populations of such nodes only ever bounce between each other and never reach a fluid node, 
+     * so the fluid nodes give the same result as the dense paths 
+     * 
+     * neighbours that are not stored point to the resting node, stored at index sparse_node_count, which holds the weights
+     */
+    void build_sparse_nodes()
+    {
+        uint64_t local_node_count = this->node_count->get(0);
+
+        // the index of each node in the list of stored nodes, or -1 if it isn't stored,
+        // only kept while building the table
+        std::vector<int64_t> sparse_index_of_node(local_node_count, -1);
+
+        this->sparse_node_indices.clear();
+
+        {
+            auto changeable = this->changeable_buffer->get_host_access();
+
+            for (uint64_t node_index = 0; node_index < local_node_count; node_index++)
+            {
+                int node_x = node_index % this->width;
+                int node_y = (node_index / this->width) % this->height;
+                int node_z = node_index / (this->width * this->height);
+
+                bool stored = changeable[node_index] != 1;
+
+                for (uint8_t i = 1; i < possible_velocities_number && !stored; i++)
+                {
+                    stored = changeable[wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, 1, *this->dims)] != 1;
+                }
+
+                if(stored)
+                {
+                    sparse_index_of_node[node_index] = this->sparse_node_indices.size();
+                    this->sparse_node_indices.push_back(node_index);
+                }
+            }
+        }
+
+        this->sparse_node_count = this->sparse_node_indices.size();
+
+        if(this->sparse_node_count + 1 > UINT32_MAX)
+        {
+            throw std::invalid_argument("Simulation: too many stored nodes for the 32 bit neighbour table of the sparse path");
+        }
+
+        // at least one element each, sycl buffers can't be empty
+        this->sparse_nodes = new sycl::buffer<uint64_t, 1>(sycl::range<1>(std::max<uint64_t>(this->sparse_node_count, 1)));
+        this->sparse_neighbours = new sycl::buffer<uint32_t, 1>(sycl::range<1>(std::max<uint64_t>(this->sparse_node_count * possible_velocities_number, 1)));
+
+        auto nodes = this->sparse_nodes->get_host_access();
+        auto neighbours = this->sparse_neighbours->get_host_access();
+
+        for (uint64_t sparse_index = 0; sparse_index < this->sparse_node_count; sparse_index++)
+        {
+            uint64_t node_index = this->sparse_node_indices[sparse_index];
+
+            int node_x = node_index % this->width;
+            int node_y = (node_index / this->width) % this->height;
+            int node_z = node_index / (this->width * this->height);
+
+            nodes[sparse_index] = node_index;
+
+            for (uint8_t i = 0; i < possible_velocities_number; i++)
+            {
+                int64_t from_sparse_index = sparse_index_of_node[wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, *this->dims)];
+
+                neighbours[i * this->sparse_node_count + sparse_index] = from_sparse_index < 0 ? this->sparse_node_count : from_sparse_index;
+            }
+        }
+    }
+
+    /**
+     * the split boundaries path, 
+     * the bulk kernel is the fused kernel with every node colliding as a fluid node, so no work item branches on its node type,
+     * then the boundary kernel overwrites the populations the bulk kernel wrote for the boundary nodes, one work item per boundary link:
+     *      reflective links  -> the population streaming in along velocity i goes out along the reflected velocity
+     *      in flow links     -> population i of the precomputed in flow equlibrium
+     *      sink links        -> the weight of velocity i
+     *      unknown node type -> the node's own population i, unchanged
+     * 
+     * the macroscopic variables the bulk kernel computes don't depend on the node type, so it writes them for every node
+     * 
+     * runs the same per node step (node_update) as the fused path on every node that isn't a reflective node,
+     * precision_report checks that the two stay within its mode_tolerance off the reflective nodes,
+     * the reflective nodes buried inside of other reflective nodes aren't in the lists and collide as fluid nodes,
+     * which changes the populations bouncing between reflective nodes, but those never reach a non reflective node (see build_boundary_links)
+     * 
+     * returns the event of the bulk kernel, which writes the macro state buffer when write_macroscopic_variables is true
+     */
+    sycl::event next_frame_split_boundaries(bool write_macroscopic_variables)
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        lattice_strides<lattice> local_strides = *this->strides;
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        sycl::event compute_bulk = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> node_position) 
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+
+                uint64_t node_index = node_x 
+                                    + node_y * local_dims.get(0) 
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                // the populations that stream into this node this step
+                float populations[possible_velocities_number];
+
+                if(is_interior_node<lattice>(node_x, node_y, node_z, local_dims))
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index - local_strides.stride[i], i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+                else
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        uint64_t from_node_index = wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, local_dims);
+
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+
+                float collided[possible_velocities_number];
+
+                // the node type is known at compile time, so only the fluid collision is left
+                sycl::float4 node_macro_state = node_update<lattice, collision>(populations, 0, collided, speed_of_sound,
+                    local_tau, 0.0f, 0.0f, 0.0f, local_collision_parameters,
+                    [&](uint8_t i) { return populations[i]; });
+
+                if(write_macroscopic_variables)
+                {
+                    device_accessor_macro_state[node_index] = node_macro_state;
+                }
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        uint64_t reflective_end = this->reflective_link_count;
+        uint64_t inflow_end = reflective_end + this->inflow_link_count;
+        uint64_t sink_end = inflow_end + this->sink_link_count;
+        uint64_t link_count = sink_end + this->kept_link_count;
+
+        if(link_count > 0)
+        {
+            // writes the same buffer as the bulk kernel, so the runtime runs it after
+            this->q.submit([&](sycl::handler& h) 
+            {
+                sycl::accessor<uint64_t, 1, sycl::access_mode::read> device_accessor_boundary_links(*this->boundary_links, h);
+                sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_inflow_populations(*this->inflow_populations, h);
+
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+                h.parallel_for(sycl::range<1>(link_count), [=](sycl::id<1> link_id) 
+                {
+                    uint64_t link_number = link_id[0];
+                    uint64_t link = device_accessor_boundary_links[link_number];
+
+                    uint64_t node_index = link / possible_velocities_number;
+                    uint8_t i = link % possible_velocities_number;
+
+                    float weight = lattice::velocities_weights[i];
+
+                    // the lists are grouped by type, so work items only diverge where two groups meet
+                    if(link_number < reflective_end)
+                    {
+                        int node_x = node_index % local_dims.get(0);
+                        int node_y = (node_index / local_dims.get(0)) % local_dims.get(1);
+                        int node_z = node_index / (local_dims.get(0) * local_dims.get(1));
+
+                        uint64_t from_node_index = wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, local_dims);
+                        uint8_t reflected_i = lattice::relective_index_table[i];
+
+                        float population = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], weight);
+
+                        device_accessor_discrete_density_buffer_2[layout::index(node_index, reflected_i, local_node_count, possible_velocities_number)] = storage::store(population, lattice::velocities_weights[reflected_i]);
+                    }
+                    else if(link_number < inflow_end)
+                    {
+                        device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(device_accessor_inflow_populations[i], weight);
+                    }
+                    else if(link_number < sink_end)
+                    {
+                        device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(weight, weight);
+                    }
+                    else
+                    {
+                        device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)];
+                    }
+                });
+            });
+        }
+
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+
+        return compute_bulk;
+    }
+
+    /**
+     * builds the boundary link lists and the in flow populations of the split boundaries path from changeable_buffer
+     * 
+     * every velocity of every boundary node is one link, grouped by node type,
+     * reflective nodes whose neighbours are all reflective nodes too are left out, 
+     * their populations only ever bounce between reflective nodes and never reach a non reflective node, the same as the sparse path,
+     * so the lists grow with the surface of the boundaries
+     */
+    void build_boundary_links()
+    {
+        uint64_t local_node_count = this->node_count->get(0);
+
+        std::vector<uint64_t> reflective_links;
+        std::vector<uint64_t> inflow_links;
+        std::vector<uint64_t> sink_links;
+        std::vector<uint64_t> kept_links;
+
+        {
+            auto changeable = this->changeable_buffer->get_host_access();
+
+            for (uint64_t node_index = 0; node_index < local_node_count; node_index++)
+            {
+                uint8_t node_type = changeable[node_index];
+
+                std::vector<uint64_t> * links = &kept_links;
+                switch (node_type)
+                {
+                case 0:
+                    continue;
+
+                case 1:
+                {
+                    int node_x = node_index % this->width;
+                    int node_y = (node_index / this->width) % this->height;
+                    int node_z = node_index / (this->width * this->height);
+
+                    bool buried = true;
+                    for (uint8_t i = 1; i < possible_velocities_number && buried; i++)
+                    {
+                        buried = changeable[wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, 1, *this->dims)] == 1;
+                    }
+
+                    if(buried)
+                    {
+                        continue;
+                    }
+
+                    links = &reflective_links;
+                    break;
+                }
+
+                case 2:
+                    links = &inflow_links;
+                    break;
+
+                case 3:
+                    links = &sink_links;
+                    break;
+                }
+
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    links->push_back(node_index * possible_velocities_number + i);
+                }
+            }
+        }
+
+        this->reflective_link_count = reflective_links.size();
+        this->inflow_link_count = inflow_links.size();
+        this->sink_link_count = sink_links.size();
+        this->kept_link_count = kept_links.size();
+
+        uint64_t link_count = this->reflective_link_count + this->inflow_link_count + this->sink_link_count + this->kept_link_count;
+
+        // at least one element, sycl buffers can't be empty
+        this->boundary_links = new sycl::buffer<uint64_t, 1>(sycl::range<1>(std::max<uint64_t>(link_count, 1)));
+        {
+            auto links = this->boundary_links->get_host_access();
+
+            uint64_t link_number = 0;
+            for (const std::vector<uint64_t> * group : {&reflective_links, &inflow_links, &sink_links, &kept_links})
+            {
+                for (uint64_t link : *group)
+                {
+                    links[link_number++] = link;
+                }
+            }
+        }
+
+        this->inflow_populations = new sycl::buffer<float, 1>(sycl::range<1>(possible_velocities_number));
+        {
+            auto inflow = this->inflow_populations->get_host_access();
+
+            for (uint8_t i = 0; i < possible_velocities_number; i++)
+            {
+                inflow[i] = f_eq
+                (
+                    lattice::velocities_weights[i], 1.0f,
+                    lattice::possible_velocities[i * 3],
+                    lattice::possible_velocities[i * 3 + 1],
+                    lattice::possible_velocities[i * 3 + 2],
+                    this->flow_vec_x, this->flow_vec_y, this->flow_vec_z
+                );
+            }
+        }
+    }
+
+    /**
+     * the padded path, 
+     * the discrete density buffers hold a grid one ghost node larger on each side along the axes the lattice moves along
+     * 
+     * first the ghost shell of discrete_density_buffer_1 is filled with copies of the nodes on the opposite faces (see fill_ghost_nodes), 
+     * which makes the edges wrap around, then the fused kernel runs on every (non ghost) node, 
+     * pulling every population from node_index - padded_strides.stride[i] without checking if it's on an edge
+     * 
+     * the in flow and sink nodes are nodes of the simulation itself, so they collide as in the fused path and don't touch the ghost nodes
+     * 
+     * runs the same per node step (node_update) as the fused path, precision_report checks that the two stay within its mode_tolerance
+     * 
+     * returns the event of the stream and collide kernel, which also writes the macro state buffer when write_macroscopic_variables is true
+     */
+    sycl::event next_frame_padded(bool write_macroscopic_variables)
+    {
+        fill_ghost_nodes();
+
+        sycl::range<3> local_dims = *this->dims;
+        sycl::range<3> local_padded_dims = *this->padded_dims;
+        uint64_t local_stored_node_count = local_padded_dims.size();
+        lattice_strides<lattice> local_strides = *this->padded_strides;
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        sycl::event compute_stream_and_collide = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> node_position) 
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+
+                uint64_t node_index = node_x 
+                                    + node_y * local_dims.get(0) 
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                uint64_t stored_index = padded_node_index<lattice>(node_x, node_y, node_z, local_padded_dims);
+
+                // the populations that stream into this node this step, the ghost shell makes every node an interior node
+                float populations[possible_velocities_number];
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(stored_index - local_strides.stride[i], i, local_stored_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                }
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, collision>(populations, device_accessor_changeable_buffer[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, local_collision_parameters,
+                    [&](uint8_t i) { return storage::load(device_accessor_discrete_density_buffer_1[layout::index(stored_index, i, local_stored_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                if(write_macroscopic_variables)
+                {
+                    device_accessor_macro_state[node_index] = node_macro_state;
+                }
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_discrete_density_buffer_2[layout::index(stored_index, i, local_stored_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        // the ghost shell of the newly written populations is filled at the start of the next step
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * the bricked path, the fused kernel with the populations stored in brick order (see brick_ordering)
+     * 
+     * each work item handles the node stored at its own index, so the work items of a work group write the populations of one brick,
+     * and the populations streaming into the brick mostly come from inside it, or from the bricks next to it
+     * 
+     * the node types and the macro state buffer are indexed in row-major order, the same as every other path,
+     * so the output and the host side arrays don't change
+     * 
+     * runs the same per node step (node_update) as the fused path, precision_report checks that the two stay within its mode_tolerance
+     * 
+     * returns the event of the kernel, which also writes the macro state buffer when write_macroscopic_variables is true
+     */
+    sycl::event next_frame_bricked(bool write_macroscopic_variables)
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count->get(0);
+        brick_ordering ordering(this->width, this->height, this->depth);
+
+        float local_tau = this->tau;
+        collision_parameters local_collision_parameters = this->collision_settings;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        sycl::event compute_stream_and_collide = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_macro_state(*this->macro_state, h);
+
+            h.parallel_for(*this->node_count, [=](sycl::id<1> stored_index) 
+            {
+                int node_x;
+                int node_y;
+                int node_z;
+
+                ordering.position(stored_index, node_x, node_y, node_z);
+
+                // the index of the node in row-major order, for the node types and the macroscopic variables
+                uint64_t node_index = node_x 
+                                    + node_y * local_dims.get(0) 
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                // the populations that stream into this node this step, wrapping around the edges same as the reference streaming kernel
+                float populations[possible_velocities_number];
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    uint64_t from_stored_index = ordering.index
+                    (
+                        wrap_coordinate(node_x - lattice::possible_velocities[i * 3],     local_dims.get(0)),
+                        wrap_coordinate(node_y - lattice::possible_velocities[i * 3 + 1], local_dims.get(1)),
+                        wrap_coordinate(node_z - lattice::possible_velocities[i * 3 + 2], local_dims.get(2))
+                    );
+
+                    populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_stored_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                }
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, collision>(populations, device_accessor_changeable_buffer[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, local_collision_parameters,
+                    [&](uint8_t i) { return storage::load(device_accessor_discrete_density_buffer_1[layout::index(stored_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                if(write_macroscopic_variables)
+                {
+                    device_accessor_macro_state[node_index] = node_macro_state;
+                }
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    device_accessor_discrete_density_buffer_2[layout::index(stored_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * fills the ghost shell of discrete_density_buffer_1 for the padded path, 
+     * every ghost node gets the populations of the node it stands in for on the opposite face (the periodic boundaries)
+     * 
+     * one kernel per padded axis, each covering the two ghost faces of that axis across the whole padded grid of the other two axes, 
+     * so the edges and corners get filled too, they read the wrapped position directly and never another ghost node, so the kernels don't depend on each other
+     */
+    void fill_ghost_nodes()
+    {
+        sycl::range<3> local_dims = *this->dims;
+        sycl::range<3> local_padded_dims = *this->padded_dims;
+        uint64_t local_stored_node_count = local_padded_dims.size();
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if(ghost_width<lattice>(axis) == 0)
+            {
+                continue;
+            }
+
+            // the ghost faces of this axis, at padded position 0 and the last padded position
+            sycl::range<3> face_range = local_padded_dims;
+            face_range[axis] = 2;
+
+            this->q.submit([&](sycl::handler& h) 
+            {
+                sycl::accessor<typename storage::type, 1, sycl::access_mode::read_write> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+
+                h.parallel_for(face_range, [=](sycl::id<3> face_position) 
+                {
+                    int padded_position[3] = {(int) face_position.get(0), (int) face_position.get(1), (int) face_position.get(2)};
+                    padded_position[axis] = face_position.get(axis) == 0 ? 0 : local_padded_dims.get(axis) - 1;
+
+                    // the node the ghost node stands in for, in unpadded positions
+                    int source_x = wrap_coordinate(padded_position[0] - ghost_width<lattice>(0), local_dims.get(0));
+                    int source_y = wrap_coordinate(padded_position[1] - ghost_width<lattice>(1), local_dims.get(1));
+                    int source_z = wrap_coordinate(padded_position[2] - ghost_width<lattice>(2), local_dims.get(2));
+
+                    uint64_t ghost_index = padded_position[0] 
+                                         + padded_position[1] * local_padded_dims.get(0) 
+                                         + padded_position[2] * local_padded_dims.get(0) * local_padded_dims.get(1);
+                    uint64_t source_index = padded_node_index<lattice>(source_x, source_y, source_z, local_padded_dims);
+
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        device_accessor_discrete_density_buffer_1[layout::index(ghost_index, i, local_stored_node_count, possible_velocities_number)] = device_accessor_discrete_density_buffer_1[layout::index(source_index, i, local_stored_node_count, possible_velocities_number)];
+                    }
+                });
+            });
+        }
     }
 
+    /**
+     * copies the macro state buffer to the host side arrays not currently pointed to by vector_array and density_array
+     * once compute_macroscopic_variables and the previous host task are done, in one copy into the vectors array,
+     * then a host task unpacks the densities into the density array and swaps which arrays are pointed to,
+     * the swaps run in the order the copies were submitted
+     * 
+     * returns the event of the host task
+     */
+    sycl::event copy_macroscopic_variables_to_host(sycl::event compute_macroscopic_variables)
+    {
+        // the arrays that aren't public, vectors1 and density_array_1 when vectors2 is public
+        sycl::float4 * next_vector_array = this->which_vectors_array ? this->vectors1 : this->vectors2;
+        float * next_density_array = this->which_vectors_array ? this->density_array_1 : this->density_array_2;
+
+        this->which_vectors_array = !this->which_vectors_array;
+
+        uint64_t local_node_count = this->node_count->get(0);
+
+        sycl::event previous_host_copy = this->host_copy_published;
+
+        sycl::event copy_macro_state = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            // the array was last filled two copies ago, the host task of that copy (which the previous host task waits on)
+            // must be done reading it before it is overwritten
+            h.depends_on({compute_macroscopic_variables, previous_host_copy});
+
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_macro_state(*this->macro_state, h);
+
+            h.copy(device_accessor_macro_state, next_vector_array);
+        });
+
+        this->host_copy_published = 
+        this->q.submit([&](sycl::handler& h) 
+        {
+            h.depends_on({copy_macro_state, previous_host_copy});
+
+            h.host_task([=]()
+            {
+                for(uint64_t i = 0; i < local_node_count; ++i)
+                {
+                    next_density_array[i] = next_vector_array[i].w();
+                }
+
+                this->vector_array.store(next_vector_array);
+                this->density_array.store(next_density_array);
+            });
+        });
+
+        this->host_copy_time_step = this->macroscopic_time_step;
+
+        return this->host_copy_published;
+    }
+
+    public:
+
     // returns a copy of the dimensions of this simulation as a 3 dimensional sycl::range object
     sycl::range<3> get_dimensions()
     {
@@ -0,0 +1,490 @@
+/*
+    name: simulation_slab.hpp
+
+    usecase:
+        one z-slab of a simulation that is split along z between several queues (devices) or processes,
+        the building block of MultiDeviceSimulation (multi_device_simulation.hpp)
+
+        a slab owns the layers first_z to first_z + depth - 1 of the full simulation, with every node of those layers,
+        it streams and collides them the same way as the fused kernel of the Simulation class (simulation_class.hpp)
+
+        the only populations that cross between two slabs are the ones moving along z out of the first or last layer,
+        after each step a slab has them packed in its send layers,
+        and before the next step it needs the ones of its neighbours written to its halo layers:
+
+            send_below -> the populations moving down (e_i.z = -1) out of the first layer, the halo_above of the slab below
+            send_above -> the populations moving up   (e_i.z = +1) out of the last layer,  the halo_below of the slab above
+
+        each step is split in two kernels so the halo exchange can happen while the slab is busy:
+            submit_interior  -> every layer that doesn't touch a halo, doesn't access the halo or send buffers
+            submit_boundary  -> the first and last layer, reads the halo layers and writes the send layers
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <utility> // std::swap, used to swap the two discrete density buffers
+#include <algorithm> // std::copy, used to move the halo and send layers to and from the host, and std::min
+
+#include "simulation_class.hpp" // the per node streaming and collision helpers, and kernel_mode
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+/**
+ * returns the number of velocities of the lattice that move along z in the given direction (1 = up, -1 = down),
+ * the number of populations per node in a halo or send layer
+ */
+template <typename lattice>
+constexpr uint8_t z_crossing_count(int direction)
+{
+    uint8_t count = 0;
+    for (int i = 0; i < lattice::count; i++)
+    {
+        count += lattice::possible_velocities[i * 3 + 2] == direction ? 1 : 0;
+    }
+    return count;
+}
+
+/**
+ * returns where, among the populations of a node in a halo or send layer, the population of velocity i is stored,
+ * velocity i must move along z in the given direction
+ */
+template <typename lattice>
+constexpr uint8_t z_crossing_slot(uint8_t i, int direction)
+{
+    uint8_t slot = 0;
+    for (int j = 0; j < i; j++)
+    {
+        slot += lattice::possible_velocities[j * 3 + 2] == direction ? 1 : 0;
+    }
+    return slot;
+}
+
+/**
+ * returns the number of layers of slab number slab when depth layers are split into slab_count slabs,
+ * as evenly as possible, the first slabs get one more layer if they don't divide evenly
+ */
+inline int slab_depth(int slab, int slab_count, int depth)
+{
+    return depth / slab_count + (slab < depth % slab_count ? 1 : 0);
+}
+
+// returns the first layer of slab number slab when depth layers are split into slab_count slabs
+inline int slab_first_layer(int slab, int slab_count, int depth)
+{
+    return slab * (depth / slab_count) + std::min(slab, depth % slab_count);
+}
+
+template <typename lattice = D3Q27, typename layout = aos_layout, typename storage = fp32_storage>
+class SimulationSlab
+{
+    private:
+        sycl::queue q;
+
+        // the number of discrete velocities per node, see lattices.hpp
+        static constexpr uint8_t possible_velocities_number = lattice::count;
+
+        // the number of populations per node that move up or down out of the slab
+        static constexpr uint8_t up_count = z_crossing_count<lattice>(1);
+        static constexpr uint8_t down_count = z_crossing_count<lattice>(-1);
+
+        const float flow_vec_x = 0.0f;
+        const float flow_vec_y = 0.0f;
+        const float flow_vec_z = 1.0f;
+
+        // the adimentional speed of sound in the lattice
+        static constexpr float speed_of_sound = 1.0f / 1.73205080757f;
+
+        float tau;
+
+        // the first layer of the full simulation owned by this slab
+        int first_z;
+
+        // the dimensions of the slab, the width and height of the full simulation and the number of layers owned
+        sycl::range<3> * dims;
+
+        // the number of nodes in the slab, and in one layer of it
+        uint64_t node_count;
+        uint64_t layer_node_count;
+
+        // the node types of the slab, see Simulation::changeable_buffer
+        sycl::buffer<uint8_t, 1> * changeable_buffer;
+
+        // the populations of the slab,
+        // index = layout::index(node_index, i, node_count, possible_velocities_number), with node_index relative to the slab
+        sycl::buffer<typename storage::type, 1> * discrete_density_buffer_1; // the values to read from
+        sycl::buffer<typename storage::type, 1> * discrete_density_buffer_2; // the values to write to
+
+        // the populations streaming into the slab from the neighbouring slabs,
+        // index = layer_node_index * up_count (or down_count) + z_crossing_slot<lattice>(i, direction)
+        sycl::buffer<typename storage::type, 1> * halo_below; // moving up into the first layer
+        sycl::buffer<typename storage::type, 1> * halo_above; // moving down into the last layer
+
+        // the populations streaming out of the slab into the neighbouring slabs, same indexing as the halos
+        sycl::buffer<typename storage::type, 1> * send_below; // moving down out of the first layer
+        sycl::buffer<typename storage::type, 1> * send_above; // moving up out of the last layer
+
+        // the macroscopic variables of the slab's nodes
+        sycl::buffer<float, 1> * macro_density_buffer;
+        sycl::buffer<sycl::float4, 1> * vectors;
+
+    public:
+
+    // q: the queue (device or sub-device) the slab runs on
+    // width, height, depth: the dimensions of the full simulation, in number of nodes
+    // first_z, slab_depth: the layers of the full simulation owned by this slab
+    // initial_populations: the starting populations of the slab's nodes, in node order, possible_velocities_number per node
+    SimulationSlab(sycl::queue q, int width, int height, int depth, int first_z, int slab_depth, float cyc_radius, float tau, const float * initial_populations)
+    {
+        this->q = q;
+        this->tau = tau;
+        this->first_z = first_z;
+
+        this->dims = new sycl::range<3>(width, height, slab_depth);
+        this->layer_node_count = width * height;
+        this->node_count = this->layer_node_count * slab_depth;
+
+        uint64_t discrete_density_buffer_length = layout::buffer_length(this->node_count, possible_velocities_number);
+
+        this->changeable_buffer = new sycl::buffer<uint8_t, 1>(sycl::range<1>(this->node_count));
+
+        this->discrete_density_buffer_1 = new sycl::buffer<typename storage::type, 1>(sycl::range<1>(discrete_density_buffer_length));
+        this->discrete_density_buffer_2 = new sycl::buffer<typename storage::type, 1>(sycl::range<1>(discrete_density_buffer_length));
+
+        // every lattice moves along z, so the layers are never empty
+        this->halo_below = new sycl::buffer<typename storage::type, 1>(sycl::range<1>(this->layer_node_count * up_count));
+        this->halo_above = new sycl::buffer<typename storage::type, 1>(sycl::range<1>(this->layer_node_count * down_count));
+        this->send_below = new sycl::buffer<typename storage::type, 1>(sycl::range<1>(this->layer_node_count * down_count));
+        this->send_above = new sycl::buffer<typename storage::type, 1>(sycl::range<1>(this->layer_node_count * up_count));
+
+        this->macro_density_buffer = new sycl::buffer<float, 1>(sycl::range<1>(this->node_count));
+        this->vectors = new sycl::buffer<sycl::float4, 1>(sycl::range<1>(this->node_count));
+
+        uint64_t local_node_count = this->node_count;
+        uint64_t local_layer_node_count = this->layer_node_count;
+
+        // the starting populations, and their send layers so the first exchange has something to send
+        {
+            auto populations = this->discrete_density_buffer_1->get_host_access();
+            auto below = this->send_below->get_host_access();
+            auto above = this->send_above->get_host_access();
+
+            for (uint64_t node_index = 0; node_index < local_node_count; node_index++)
+            {
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    float weight = lattice::velocities_weights[i];
+                    typename storage::type value = storage::store(initial_populations[node_index * possible_velocities_number + i], weight);
+
+                    populations[layout::index(node_index, i, local_node_count, possible_velocities_number)] = value;
+
+                    if(node_index < local_layer_node_count && lattice::possible_velocities[i * 3 + 2] == -1)
+                    {
+                        below[node_index * down_count + z_crossing_slot<lattice>(i, -1)] = value;
+                    }
+                    if(node_index >= local_node_count - local_layer_node_count && lattice::possible_velocities[i * 3 + 2] == 1)
+                    {
+                        above[(node_index - (local_node_count - local_layer_node_count)) * up_count + z_crossing_slot<lattice>(i, 1)] = value;
+                    }
+                }
+            }
+        }
+
+        // set which nodes are boundary nodes, in the coordinates of the full simulation
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::write> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            h.parallel_for(*this->dims, [=](sycl::id<3> i)
+            {
+                int64_t index = i.get(0) + i.get(1) * width + i.get(2) * width * height;
+
+                device_accessor_changeable_buffer[index] = initial_node_type(i.get(0), i.get(1), first_z + i.get(2), width, height, depth, cyc_radius);
+            });
+        }).wait();
+
+        // the starting macroscopic variables, the same as the Simulation class starts with
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_density_buffer(*this->macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_vectors(*this->vectors, h);
+
+            h.parallel_for(sycl::range<1>(local_node_count), [=](sycl::id<1> i)
+            {
+                float density = 0.0f;
+
+                float vec_x = 0.0f;
+                float vec_y = 0.0f;
+                float vec_z = 0.0f;
+
+                for (uint8_t j = 0; j < possible_velocities_number; j++)
+                {
+                    density += storage::load(device_accessor_discrete_density_buffer_1[layout::index(i, j, local_node_count, possible_velocities_number)], lattice::velocities_weights[j]);
+
+                    vec_x += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3];
+                    vec_y += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3 + 1];
+                    vec_z += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3 + 2];
+                }
+
+                device_accessor_macro_density_buffer[i] = density;
+                device_accessor_vectors[i] = sycl::float4(vec_x, vec_y, vec_z, density);
+            });
+        }).wait();
+    }
+
+    ~SimulationSlab()
+    {
+        // the host copies write to arrays of the owner
+        this->q.wait();
+
+        delete this->dims;
+
+        delete this->changeable_buffer;
+        delete this->discrete_density_buffer_1;
+        delete this->discrete_density_buffer_2;
+
+        delete this->halo_below;
+        delete this->halo_above;
+        delete this->send_below;
+        delete this->send_above;
+
+        delete this->macro_density_buffer;
+        delete this->vectors;
+    }
+
+    SimulationSlab(const SimulationSlab &) = delete;
+    SimulationSlab & operator=(const SimulationSlab &) = delete;
+
+    /**
+     * streams and collides every layer that doesn't touch a halo layer,
+     * doesn't access the halo or send layers, so they can be exchanged while it runs
+     */
+    sycl::event submit_interior()
+    {
+        int slab_depth = this->dims->get(2);
+
+        if(slab_depth <= 2)
+        {
+            return sycl::event();
+        }
+
+        return submit_layers<false>(1, slab_depth - 2);
+    }
+
+    /**
+     * streams and collides the first and last layer, pulling from the halo layers, and fills the send layers,
+     * call after the halo layers of this step have been written
+     */
+    sycl::event submit_boundary()
+    {
+        int slab_depth = this->dims->get(2);
+
+        // one layer is both the first and the last
+        if(slab_depth == 1)
+        {
+            return submit_layers<true>(0, 1);
+        }
+
+        return submit_layers<true>(0, 2);
+    }
+
+    /**
+     * ends a step once both kernels have been submitted,
+     * the newly written populations become the ones to read from next step
+     */
+    void finish_step()
+    {
+        std::swap(this->discrete_density_buffer_1, this->discrete_density_buffer_2);
+    }
+
+    // copies the send layers to the host, down_count and up_count populations per node of a layer
+    void read_send_layers(typename storage::type * below, typename storage::type * above)
+    {
+        auto device_below = this->send_below->get_host_access();
+        auto device_above = this->send_above->get_host_access();
+
+        std::copy(&device_below[0], &device_below[0] + this->layer_node_count * down_count, below);
+        std::copy(&device_above[0], &device_above[0] + this->layer_node_count * up_count, above);
+    }
+
+    // copies the send layers of the neighbouring slabs into the halo layers, up_count and down_count populations per node of a layer
+    void write_halo_layers(const typename storage::type * below, const typename storage::type * above)
+    {
+        auto device_below = this->halo_below->get_host_access();
+        auto device_above = this->halo_above->get_host_access();
+
+        std::copy(below, below + this->layer_node_count * up_count, &device_below[0]);
+        std::copy(above, above + this->layer_node_count * down_count, &device_above[0]);
+    }
+
+    // copies the macroscopic density and velocity of the slab's nodes to the host, in node order
+    void copy_macroscopic_variables_to_host(float * density, sycl::float4 * velocity)
+    {
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<float, 1, sycl::access_mode::read> device_accessor_density(*this->macro_density_buffer, h);
+
+            h.copy(device_accessor_density, density);
+        });
+
+        this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::read> device_accessor_vectors(*this->vectors, h);
+
+            h.copy(device_accessor_vectors, velocity);
+        });
+    }
+
+    // copies the populations of the slab's nodes to the host as floats, in node order, possible_velocities_number per node
+    void copy_populations_to_host(float * populations)
+    {
+        auto accessor = this->discrete_density_buffer_1->get_host_access();
+
+        for (uint64_t node_index = 0; node_index < this->node_count; node_index++)
+        {
+            for (uint8_t i = 0; i < possible_velocities_number; i++)
+            {
+                populations[node_index * possible_velocities_number + i] = storage::load(accessor[layout::index(node_index, i, this->node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+            }
+        }
+    }
+
+    // copies the node types of the slab's nodes to the host, in node order
+    void copy_node_types_to_host(uint8_t * node_types)
+    {
+        auto accessor = this->changeable_buffer->get_host_access();
+
+        std::copy(&accessor[0], &accessor[0] + this->node_count, node_types);
+    }
+
+    // waits for everything submitted to the slab's queue
+    void wait()
+    {
+        this->q.wait();
+    }
+
+    // returns the number of nodes in the slab
+    uint64_t get_node_count()
+    {
+        return this->node_count;
+    }
+
+    // returns the number of nodes in one layer of the slab
+    uint64_t get_layer_node_count()
+    {
+        return this->layer_node_count;
+    }
+
+    // returns the number of populations per node of a layer moving up or down
+    static constexpr uint8_t get_up_count() { return up_count; }
+    static constexpr uint8_t get_down_count() { return down_count; }
+
+    private:
+
+    /**
+     * the fused kernel over layer_count layers of the slab, starting at first_layer,
+     * the boundary version streams from the halo layers and fills the send layers for the first and last layer of the slab,
+     * with first_layer 0 and layer_count 2 it runs over exactly those two
+     */
+    template <bool boundary>
+    sycl::event submit_layers(int first_layer, int layer_count)
+    {
+        sycl::range<3> local_dims = *this->dims;
+        uint64_t local_node_count = this->node_count;
+        uint64_t local_layer_node_count = this->layer_node_count;
+
+        float local_tau = this->tau;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        return this->q.submit([&](sycl::handler& h)
+        {
+            sycl::accessor<uint8_t, 1, sycl::access_mode::read> device_accessor_changeable_buffer(*this->changeable_buffer, h);
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_discrete_density_buffer_1(*this->discrete_density_buffer_1, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_discrete_density_buffer_2(*this->discrete_density_buffer_2, h);
+
+            sycl::accessor<float, 1, sycl::access_mode::write> device_accessor_macro_density(*this->macro_density_buffer, h);
+            sycl::accessor<sycl::float4, 1, sycl::access_mode::write> device_accessor_vectors(*this->vectors, h);
+
+            // the interior kernel must not touch the halo and send layers,
+            // otherwise the runtime would make the exchange wait for it
+            sycl::buffer<typename storage::type, 1> & halo_below_buffer = boundary ? *this->halo_below : *this->discrete_density_buffer_1;
+            sycl::buffer<typename storage::type, 1> & halo_above_buffer = boundary ? *this->halo_above : *this->discrete_density_buffer_1;
+            sycl::buffer<typename storage::type, 1> & send_below_buffer = boundary ? *this->send_below : *this->discrete_density_buffer_2;
+            sycl::buffer<typename storage::type, 1> & send_above_buffer = boundary ? *this->send_above : *this->discrete_density_buffer_2;
+
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_halo_below(halo_below_buffer, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::read> device_accessor_halo_above(halo_above_buffer, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_send_below(send_below_buffer, h);
+            sycl::accessor<typename storage::type, 1, sycl::access_mode::write> device_accessor_send_above(send_above_buffer, h);
+
+            h.parallel_for(sycl::range<3>(local_dims.get(0), local_dims.get(1), layer_count), [=](sycl::id<3> node_position)
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+
+                // the boundary kernel runs over the first and the last layer
+                int node_z = boundary && node_position.get(2) == 1 ? local_dims.get(2) - 1 : first_layer + node_position.get(2);
+
+                uint64_t layer_node_index = node_x + node_y * local_dims.get(0);
+                uint64_t node_index = layer_node_index + node_z * local_layer_node_count;
+
+                // the populations that stream into this node this step
+                float populations[possible_velocities_number];
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    uint64_t from_layer_node_index = wrap_coordinate(node_x - lattice::possible_velocities[i * 3],     local_dims.get(0))
+                                                   + wrap_coordinate(node_y - lattice::possible_velocities[i * 3 + 1], local_dims.get(1)) * local_dims.get(0);
+
+                    int from_node_z = node_z - lattice::possible_velocities[i * 3 + 2];
+
+                    if(boundary && from_node_z < 0)
+                    {
+                        populations[i] = storage::load(device_accessor_halo_below[from_layer_node_index * up_count + z_crossing_slot<lattice>(i, 1)], lattice::velocities_weights[i]);
+                    }
+                    else if(boundary && from_node_z >= (int) local_dims.get(2))
+                    {
+                        populations[i] = storage::load(device_accessor_halo_above[from_layer_node_index * down_count + z_crossing_slot<lattice>(i, -1)], lattice::velocities_weights[i]);
+                    }
+                    else
+                    {
+                        uint64_t from_node_index = from_layer_node_index + from_node_z * local_layer_node_count;
+
+                        populations[i] = storage::load(device_accessor_discrete_density_buffer_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, bgk_collision>(populations, device_accessor_changeable_buffer[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, collision_parameters(),
+                    [&](uint8_t i) { return storage::load(device_accessor_discrete_density_buffer_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                device_accessor_vectors[node_index] = node_macro_state;
+                device_accessor_macro_density[node_index] = node_macro_state.w();
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    typename storage::type value = storage::store(collided[i], lattice::velocities_weights[i]);
+
+                    device_accessor_discrete_density_buffer_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = value;
+
+                    if(boundary && node_z == 0 && lattice::possible_velocities[i * 3 + 2] == -1)
+                    {
+                        device_accessor_send_below[layer_node_index * down_count + z_crossing_slot<lattice>(i, -1)] = value;
+                    }
+                    if(boundary && node_z == (int) local_dims.get(2) - 1 && lattice::possible_velocities[i * 3 + 2] == 1)
+                    {
+                        device_accessor_send_above[layer_node_index * up_count + z_crossing_slot<lattice>(i, 1)] = value;
+                    }
+                }
+            });
+        });
+    }
+};
@@ -0,0 +1,789 @@
+/*
+    name: usm_simulation.hpp
+
+    usecase:
+        the same simulation as the Simulation class (simulation_class.hpp), with its state in USM device allocations instead of sycl::buffers
+
+        the Simulation class makes 5 to 12 accessors per step, and the runtime builds the dependencies between the kernels from them every step,
+        here the kernels take plain pointers and depend on the events of the kernels before them,
+        so submitting a step costs the host less, the two population arrays are swapped by swapping the pointers,
+        and everything is freed when the simulation is destroyed
+
+        runs the reference (stream, macroscopic variables, then collision, each its own kernel) and fused kernel modes,
+        with the same per node steps as the Simulation class in the same mode (node_update in the fused mode)
+
+        the public interface (next_frame, submit_steps, snapshot, vector_array, density_array, get_dimensions, get_node_count)
+        is the same as the Simulation class
+
+        the host side macroscopic arrays are USM host allocations, so the device copies straight into them
+
+        with set_graph_replay(true) and the sycl_ext_oneapi_graph extension, each step (its kernels and host copies) is recorded once
+        into a command graph, and replayed with a single launch every step after, see replay_step
+*/
+#pragma once
+
+#include <iostream> // used for debugging via std out
+#include <atomic> // the host side macroscopic arrays are swapped atomically, same as the Simulation class
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <utility> // std::swap, used to swap the two population arrays
+#include <vector>
+#include <cstdlib> // rand, for the starting noise
+#include <stdexcept> // std::invalid_argument, thrown for kernel modes this class doesn't run
+#include <optional> // the recorded command graphs, made the first time they're needed
+
+#include "simulation_class.hpp" // the per node helpers the kernels share with the Simulation class, and kernel_mode
+
+#include <sycl/sycl.hpp> // the main library used for parellelism
+
+template <typename lattice = D3Q27, typename layout = aos_layout, typename storage = fp32_storage>
+class UsmSimulation
+{
+    private:
+        int width;  // simulation width in number of nodes
+        int height; // simulation height in number of nodes
+        int depth;  // simulation depth in number of nodes
+
+        sycl::queue q;
+
+        // the number of discrete velocities per node, see lattices.hpp
+        static constexpr uint8_t possible_velocities_number = lattice::count;
+
+        // the adimentional speed of sound in the lattice, the same as the Simulation class
+        static constexpr float speed_of_sound = 1.0f / 1.73205080757f;
+
+        float tau;
+
+        const float flow_vec_x = 0.0f;
+        const float flow_vec_y = 0.0f;
+        const float flow_vec_z = 1.0f;
+
+        // reference or fused, see kernel_mode in simulation_class.hpp
+        kernel_mode mode;
+
+        sycl::range<3> dims;
+        uint64_t node_count;
+        uint64_t population_count; // the length of each population array, see layout::buffer_length
+
+        lattice_strides<lattice> strides;
+
+        ////////////////////////////////////
+        // device side state (USM device) //
+        ////////////////////////////////////
+
+        // the boundary type of each node, the same values as the changeable_buffer of the Simulation class
+        uint8_t * node_types;
+
+        // the populations, index = layout::index(node_index, i, node_count, possible_velocities_number),
+        // stored as storage::type, read with storage::load and written with storage::store
+        typename storage::type * populations_1; // the values to read from
+        typename storage::type * populations_2; // the values to write to
+
+        float * macro_density;
+        sycl::float4 * vectors;
+
+        // the reference path only, the macroscopic velocity split into its components
+        float * macro_velocity_x = nullptr;
+        float * macro_velocity_y = nullptr;
+        float * macro_velocity_z = nullptr;
+
+        // the events the next step has to wait for, the kernels of the last step and the host copies reading their results
+        std::vector<sycl::event> step_dependencies;
+
+        // the number of steps submitted so far
+        uint64_t time_step = 0;
+
+        // if each step is replayed from a recorded command graph, see replay_step
+        bool graph_replay = false;
+
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+        // one recorded step for every combination of
+        //      which population array it reads (the fused path swaps them every step, the reference path always reads populations_1)
+        //      and which host side arrays it copies the macroscopic variables to (none, the first pair, or the second pair)
+        // index = read_parity * 3 + host_arrays, recorded the first time they're needed
+        std::optional<sycl::ext::oneapi::experimental::command_graph<sycl::ext::oneapi::experimental::graph_state::executable>> step_graphs[6];
+#endif
+
+        // the step the newest host copy of the macroscopic variables was made after,
+        // and the host task that makes it public, see copy_macroscopic_variables_to_host
+        uint64_t host_copy_time_step = 0;
+        sycl::event host_copy_published;
+
+        ////////////////////////////////
+        // host side state (USM host) //
+        ////////////////////////////////
+
+        float * density_array_1;
+        float * density_array_2;
+
+        sycl::float4 * vectors1;
+        sycl::float4 * vectors2;
+
+        // which array is currently pointed to by the vector_array pointer
+        // false means vectors1 is pointed to by vector_array
+        // true means vectors2 is pointed to by vector_array
+        bool which_vectors_array = false;
+
+    public:
+        /////////////////////////////////////////////////////////////////////////
+        // stable host instances of the macroscopic velocity and density array //
+        /////////////////////////////////////////////////////////////////////////
+
+        // a value containing a pointer to the current macroscopic velocity array, with the density of each node in w
+        std::atomic<sycl::float4*> vector_array;
+        // a value containing a pointer to the current macroscopic density array
+        std::atomic<float*> density_array;
+
+    // the same arguments as the Simulation class,
+    // throws std::invalid_argument for any mode other than kernel_mode::reference or kernel_mode::fused
+    UsmSimulation(int width, int height, int depth, float density, float visocity, float speed_of_sound, float node_size, float cyc_radius, float tau, kernel_mode mode = kernel_mode::fused)
+        : dims(width, height, depth), strides(width, height)
+    {
+        if(mode != kernel_mode::reference && mode != kernel_mode::fused)
+        {
+            throw std::invalid_argument("UsmSimulation: only the reference and fused kernel modes are supported");
+        }
+
+        sycl::device d;
+        try {
+            d = sycl::device(sycl::gpu_selector_v);
+        }
+        catch (sycl::exception const &e) {
+            d = sycl::device(sycl::cpu_selector_v);
+        }
+
+        this->q = sycl::queue(d);
+        std::cout << "running simulation on -> " << q.get_device().get_info<sycl::info::device::name>() << std::endl;
+
+        this->width = width;
+        this->height = height;
+        this->depth = depth;
+        this->tau = tau;
+        this->mode = mode;
+
+        this->node_count = (uint64_t) width * height * depth;
+        this->population_count = layout::buffer_length(this->node_count, possible_velocities_number);
+
+        this->node_types = sycl::malloc_device<uint8_t>(this->node_count, this->q);
+
+        this->populations_1 = sycl::malloc_device<typename storage::type>(this->population_count, this->q);
+        this->populations_2 = sycl::malloc_device<typename storage::type>(this->population_count, this->q);
+
+        this->macro_density = sycl::malloc_device<float>(this->node_count, this->q);
+        this->vectors = sycl::malloc_device<sycl::float4>(this->node_count, this->q);
+
+        if(mode == kernel_mode::reference)
+        {
+            this->macro_velocity_x = sycl::malloc_device<float>(this->node_count, this->q);
+            this->macro_velocity_y = sycl::malloc_device<float>(this->node_count, this->q);
+            this->macro_velocity_z = sycl::malloc_device<float>(this->node_count, this->q);
+        }
+
+        this->density_array_1 = sycl::malloc_host<float>(this->node_count, this->q);
+        this->density_array_2 = sycl::malloc_host<float>(this->node_count, this->q);
+
+        this->vectors1 = sycl::malloc_host<sycl::float4>(this->node_count, this->q);
+        this->vectors2 = sycl::malloc_host<sycl::float4>(this->node_count, this->q);
+
+        // set which nodes are boundary nodes
+        uint8_t * local_node_types = this->node_types;
+
+        sycl::event set_node_types =
+        this->q.submit([&](sycl::handler& h)
+        {
+            h.parallel_for(this->dims, [=](sycl::id<3> i)
+            {
+                int64_t index = i.get(0) + i.get(1) * width + i.get(2) * width * height;
+
+                local_node_types[index] = initial_node_type(i.get(0), i.get(1), i.get(2), width, height, depth, cyc_radius);
+            });
+        });
+
+        // the weights plus a bit of random noise, in node order, the same as the Simulation class starts with,
+        // and the density of each node
+        std::vector<typename storage::type> initial_populations(this->population_count);
+        for (uint64_t i = 0; i < this->node_count * possible_velocities_number; i++)
+        {
+            float noise = (rand() % 100) / 1000.0f; // + 0.00, 0.01, 0.02, to 0.99f
+
+            float weight = lattice::velocities_weights[i % possible_velocities_number];
+            uint64_t index = layout::index(i / possible_velocities_number, i % possible_velocities_number, this->node_count, possible_velocities_number);
+
+            initial_populations[index] = storage::store(storage::load(storage::store(weight, weight), weight) + noise, weight);
+        }
+
+        float vec_x = 0.0f;
+        float vec_y = 0.0f;
+        float vec_z = 0.0f;
+        for(uint8_t j = 0; j < possible_velocities_number; ++j)
+        {
+            vec_x += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3];
+            vec_y += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3 + 1];
+            vec_z += lattice::velocities_weights[j] * lattice::possible_velocities[j * 3 + 2];
+        }
+
+        for (uint64_t node_index = 0; node_index < this->node_count; node_index++)
+        {
+            float node_density = 0.0f;
+            for (uint8_t j = 0; j < possible_velocities_number; j++)
+            {
+                node_density += storage::load(initial_populations[layout::index(node_index, j, this->node_count, possible_velocities_number)], lattice::velocities_weights[j]);
+            }
+
+            this->density_array_1[node_index] = node_density;
+            this->density_array_2[node_index] = node_density;
+
+            this->vectors1[node_index] = sycl::float4(vec_x, vec_y, vec_z, node_density);
+            this->vectors2[node_index] = sycl::float4(vec_x, vec_y, vec_z, node_density);
+        }
+
+        this->step_dependencies = {
+            set_node_types,
+            this->q.memcpy(this->populations_1, initial_populations.data(), this->population_count * sizeof(typename storage::type)),
+            this->q.memcpy(this->macro_density, this->density_array_1, this->node_count * sizeof(float)),
+            this->q.memcpy(this->vectors, this->vectors1, this->node_count * sizeof(sycl::float4))
+        };
+
+        this->density_array.store(this->density_array_1);
+        this->vector_array.store(this->vectors1);
+
+        // initial_populations goes out of scope
+        this->q.wait();
+    }
+
+    ~UsmSimulation()
+    {
+        this->q.wait();
+
+        sycl::free(this->node_types, this->q);
+        sycl::free(this->populations_1, this->q);
+        sycl::free(this->populations_2, this->q);
+        sycl::free(this->macro_density, this->q);
+        sycl::free(this->vectors, this->q);
+
+        if(this->macro_velocity_x != nullptr)
+        {
+            sycl::free(this->macro_velocity_x, this->q);
+            sycl::free(this->macro_velocity_y, this->q);
+            sycl::free(this->macro_velocity_z, this->q);
+        }
+
+        sycl::free(this->density_array_1, this->q);
+        sycl::free(this->density_array_2, this->q);
+        sycl::free(this->vectors1, this->q);
+        sycl::free(this->vectors2, this->q);
+    }
+
+    UsmSimulation(const UsmSimulation &) = delete;
+    UsmSimulation & operator=(const UsmSimulation &) = delete;
+
+    /**
+     * calculate the next state of the simulation
+     */
+    void next_frame()
+    {
+        submit_steps(1, 1);
+
+        this->q.wait();
+    }
+
+    /**
+     * enqueues n_steps steps back to back and returns without waiting for any of them, the same as Simulation::submit_steps
+     *
+     * host_copy_interval: copy the macroscopic variables to the host every that many steps, 0 (the default) for never
+     *
+     * returns the event of the last step, or of its host copy if it has one
+     */
+    sycl::event submit_steps(int n_steps, int host_copy_interval = 0)
+    {
+        // a default constructed event is already complete
+        sycl::event last_submitted;
+
+        for (int step = 1; step <= n_steps; step++)
+        {
+            bool host_copy = host_copy_interval > 0 && step % host_copy_interval == 0;
+
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+            if(this->graph_replay)
+            {
+                last_submitted = replay_step(host_copy);
+                continue;
+            }
+#endif
+
+            last_submitted = this->mode == kernel_mode::reference ? next_frame_reference() : next_frame_fused();
+
+            ++this->time_step;
+
+            if(host_copy)
+            {
+                last_submitted = copy_macroscopic_variables_to_host();
+            }
+        }
+
+        return last_submitted;
+    }
+
+    /**
+     * turns replaying recorded command graphs on or off, see replay_step,
+     * without the sycl_ext_oneapi_graph extension the steps are always submitted one command at a time
+     */
+    void set_graph_replay(bool graph_replay)
+    {
+        this->graph_replay = graph_replay;
+    }
+
+    // returns true if steps are replayed from recorded command graphs
+    bool get_graph_replay()
+    {
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+        return this->graph_replay;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * waits for every submitted step,
+     * and makes the macroscopic variables of the last one public (vector_array and density_array), copying them to the host if they aren't yet
+     */
+    void snapshot()
+    {
+        if(this->host_copy_time_step != this->time_step)
+        {
+            copy_macroscopic_variables_to_host();
+        }
+
+        this->q.wait();
+    }
+
+    // copies the populations of every node to the host as floats, in node order, possible_velocities_number per node
+    void copy_populations_to_host(float * populations)
+    {
+        std::vector<typename storage::type> stored(this->population_count);
+
+        this->q.memcpy(stored.data(), this->populations_1, this->population_count * sizeof(typename storage::type), this->step_dependencies).wait();
+
+        for (uint64_t node_index = 0; node_index < this->node_count; node_index++)
+        {
+            for (uint8_t i = 0; i < possible_velocities_number; i++)
+            {
+                populations[node_index * possible_velocities_number + i] = storage::load(stored[layout::index(node_index, i, this->node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+            }
+        }
+    }
+
+    // copies the node types (the changeable_buffer values of the Simulation class) of every node to the host, in node order
+    void copy_node_types_to_host(uint8_t * node_types)
+    {
+        this->q.memcpy(node_types, this->node_types, this->node_count * sizeof(uint8_t), this->step_dependencies).wait();
+    }
+
+    // returns a copy of the dimensions of this simulation as a 3 dimensional sycl::range object
+    sycl::range<3> get_dimensions()
+    {
+        return this->dims;
+    }
+
+    // returns the number of nodes in this simulation
+    int get_node_count()
+    {
+        return this->node_count;
+    }
+
+    private:
+
+    /**
+     * the reference path as three kernels, streaming from populations_1 to populations_2, the macroscopic variables of populations_2,
+     * then the collision from populations_2 back into populations_1, each kernel waits on the event of the one before it
+     *
+     * returns the event of the macroscopic variables kernel
+     */
+    sycl::event next_frame_reference()
+    {
+        sycl::range<3> local_dims = this->dims;
+        uint64_t local_node_count = this->node_count;
+
+        float local_tau = this->tau;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        uint8_t * local_node_types = this->node_types;
+
+        typename storage::type * local_populations_1 = this->populations_1;
+        typename storage::type * local_populations_2 = this->populations_2;
+
+        float * local_macro_density = this->macro_density;
+        float * local_macro_velocity_x = this->macro_velocity_x;
+        float * local_macro_velocity_y = this->macro_velocity_y;
+        float * local_macro_velocity_z = this->macro_velocity_z;
+        sycl::float4 * local_vectors = this->vectors;
+
+        sycl::event compute_streaming =
+        this->q.submit([&](sycl::handler& h)
+        {
+            h.depends_on(this->step_dependencies);
+
+            h.parallel_for(local_dims, [=](sycl::id<3> node_position)
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+
+                uint64_t node_index = node_x
+                                    + node_y * local_dims.get(0)
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                // a population keeps its velocity when streaming, so the stored value can be copied as is
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    uint64_t from_node_index = wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, local_dims);
+
+                    local_populations_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = local_populations_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)];
+                }
+            });
+        });
+
+        sycl::event compute_macroscopic_variables =
+        this->q.submit([&](sycl::handler& h)
+        {
+            h.depends_on(compute_streaming);
+
+            h.parallel_for(sycl::range<1>(local_node_count), [=](sycl::id<1> node_id)
+            {
+                uint64_t node_index = node_id[0];
+
+                float populations[possible_velocities_number];
+
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    populations[i] = storage::load(local_populations_2[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                }
+
+                float node_density;
+
+                float macro_velocity_x;
+                float macro_velocity_y;
+                float macro_velocity_z;
+
+                node_macroscopic_variables<lattice>(populations, speed_of_sound, node_density, macro_velocity_x, macro_velocity_y, macro_velocity_z);
+
+                local_macro_velocity_x[node_index] = macro_velocity_x;
+                local_macro_velocity_y[node_index] = macro_velocity_y;
+                local_macro_velocity_z[node_index] = macro_velocity_z;
+
+                local_vectors[node_index] = sycl::float4(macro_velocity_x, macro_velocity_y, macro_velocity_z, node_density);
+
+                local_macro_density[node_index] = node_density;
+            });
+        });
+
+        sycl::event compute_collision =
+        this->q.submit([&](sycl::handler& h)
+        {
+            h.depends_on(compute_macroscopic_variables);
+
+            h.parallel_for(sycl::range<1>(local_node_count), [=](sycl::id<1> node_id)
+            {
+                uint64_t node_index = node_id[0];
+
+                uint8_t node_type = local_node_types[node_index];
+
+                // unknown node types keep their populations where they are, same as the Simulation class
+                if(node_type > 3)
+                {
+                    return;
+                }
+
+                float populations[possible_velocities_number];
+
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    populations[i] = storage::load(local_populations_2[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                }
+
+                float collided[possible_velocities_number];
+
+                node_collide<lattice>(node_type, populations, collided,
+                                      local_tau, local_macro_density[node_index], local_macro_velocity_x[node_index], local_macro_velocity_y[node_index], local_macro_velocity_z[node_index],
+                                      local_flow_vec_x, local_flow_vec_y, local_flow_vec_z);
+
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    local_populations_1[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        // the collision reads the macroscopic variables, so it finishes after the macroscopic variables kernel
+        this->step_dependencies = {compute_collision};
+
+        return compute_macroscopic_variables;
+    }
+
+    /**
+     * the fused path, the same kernel as Simulation::next_frame_fused, reading populations_1 and writing populations_2,
+     * then swapping the two pointers
+     *
+     * returns the event of the kernel
+     */
+    sycl::event next_frame_fused()
+    {
+        sycl::range<3> local_dims = this->dims;
+        uint64_t local_node_count = this->node_count;
+        lattice_strides<lattice> local_strides = this->strides;
+
+        float local_tau = this->tau;
+
+        float local_flow_vec_x = this->flow_vec_x;
+        float local_flow_vec_y = this->flow_vec_y;
+        float local_flow_vec_z = this->flow_vec_z;
+
+        uint8_t * local_node_types = this->node_types;
+
+        typename storage::type * local_populations_1 = this->populations_1;
+        typename storage::type * local_populations_2 = this->populations_2;
+
+        float * local_macro_density = this->macro_density;
+        sycl::float4 * local_vectors = this->vectors;
+
+        sycl::event compute_stream_and_collide =
+        this->q.submit([&](sycl::handler& h)
+        {
+            h.depends_on(this->step_dependencies);
+
+            h.parallel_for(local_dims, [=](sycl::id<3> node_position)
+            {
+                int node_x = node_position.get(0);
+                int node_y = node_position.get(1);
+                int node_z = node_position.get(2);
+
+                uint64_t node_index = node_x
+                                    + node_y * local_dims.get(0)
+                                    + node_z * local_dims.get(0) * local_dims.get(1);
+
+                // the populations that stream into this node this step
+                float populations[possible_velocities_number];
+
+                if(is_interior_node<lattice>(node_x, node_y, node_z, local_dims))
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        populations[i] = storage::load(local_populations_1[layout::index(node_index - local_strides.stride[i], i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+                else
+                {
+                    #pragma unroll
+                    for (uint8_t i = 0; i < possible_velocities_number; i++)
+                    {
+                        uint64_t from_node_index = wrapped_neighbour_index<lattice>(node_x, node_y, node_z, i, -1, local_dims);
+
+                        populations[i] = storage::load(local_populations_1[layout::index(from_node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]);
+                    }
+                }
+
+                float collided[possible_velocities_number];
+
+                sycl::float4 node_macro_state = node_update<lattice, bgk_collision>(populations, local_node_types[node_index], collided, speed_of_sound,
+                    local_tau, local_flow_vec_x, local_flow_vec_y, local_flow_vec_z, collision_parameters(),
+                    [&](uint8_t i) { return storage::load(local_populations_1[layout::index(node_index, i, local_node_count, possible_velocities_number)], lattice::velocities_weights[i]); });
+
+                local_vectors[node_index] = node_macro_state;
+                local_macro_density[node_index] = node_macro_state.w();
+
+                #pragma unroll
+                for (uint8_t i = 0; i < possible_velocities_number; i++)
+                {
+                    local_populations_2[layout::index(node_index, i, local_node_count, possible_velocities_number)] = storage::store(collided[i], lattice::velocities_weights[i]);
+                }
+            });
+        });
+
+        this->step_dependencies = {compute_stream_and_collide};
+
+        std::swap(this->populations_1, this->populations_2);
+
+        return compute_stream_and_collide;
+    }
+
+    /**
+     * copies the macroscopic variables of the last submitted step to the host side arrays not currently pointed to by vector_array and density_array,
+     * then a host task swaps which arrays are pointed to once the copies land, the same as Simulation::copy_macroscopic_variables_to_host
+     *
+     * the next step waits for the copies before overwriting the macroscopic variables
+     *
+     * returns the event of the host task
+     */
+    sycl::event copy_macroscopic_variables_to_host()
+    {
+        sycl::float4 * next_vector_array = this->which_vectors_array ? this->vectors1 : this->vectors2;
+        float * next_density_array = this->which_vectors_array ? this->density_array_1 : this->density_array_2;
+
+        std::vector<sycl::event> copies = submit_host_copies(next_vector_array, next_density_array);
+
+        return publish_host_arrays(copies, next_vector_array, next_density_array);
+    }
+
+    /**
+     * copies the vectors and macro density of the last submitted step to the given host side arrays,
+     * once the step is done, and adds the copies to the events the next step waits for
+     *
+     * wait_for_publish: also wait for the previous host task, which may still have the arrays public until it swaps them away,
+     * false when recording a graph, which can't depend on events from outside of it (the launch waits instead, see replay_step)
+     *
+     * returns the events of the two copies
+     */
+    std::vector<sycl::event> submit_host_copies(sycl::float4 * next_vector_array, float * next_density_array, bool wait_for_publish = true)
+    {
+        std::vector<sycl::event> copy_dependencies = this->step_dependencies;
+        if(wait_for_publish)
+        {
+            copy_dependencies.push_back(this->host_copy_published);
+        }
+
+        sycl::event copy_vectors = this->q.memcpy(next_vector_array, this->vectors, this->node_count * sizeof(sycl::float4), copy_dependencies);
+        sycl::event copy_density = this->q.memcpy(next_density_array, this->macro_density, this->node_count * sizeof(float), copy_dependencies);
+
+        this->step_dependencies.push_back(copy_vectors);
+        this->step_dependencies.push_back(copy_density);
+
+        return {copy_vectors, copy_density};
+    }
+
+    /**
+     * makes the given host side arrays public (vector_array and density_array) with a host task once copies are done,
+     * in the order the copies were submitted
+     *
+     * returns the event of the host task
+     */
+    sycl::event publish_host_arrays(std::vector<sycl::event> copies, sycl::float4 * next_vector_array, float * next_density_array)
+    {
+        this->which_vectors_array = !this->which_vectors_array;
+
+        copies.push_back(this->host_copy_published);
+
+        this->host_copy_published =
+        this->q.submit([&](sycl::handler& h)
+        {
+            h.depends_on(copies);
+
+            h.host_task([=]()
+            {
+                this->vector_array.store(next_vector_array);
+                this->density_array.store(next_density_array);
+            });
+        });
+
+        this->host_copy_time_step = this->time_step;
+
+        return this->host_copy_published;
+    }
+
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+    /**
+     * submits one step as a single launch of a recorded command graph, 
+     * holding the step's kernels and, if host_copy is true, the copies of its macroscopic variables to the host side arrays that aren't public,
+     * 
+     * the graphs hold the pointers they were recorded with, so there is one graph for each population array the step reads
+     * and each pair of host side arrays it copies to (the ping-pong between vectors1 / density_array_1 and vectors2 / density_array_2),
+     * see step_graphs
+     *
+     * returns the event of the launch, or of the host task making the copies public
+     */
+    sycl::event replay_step(bool host_copy)
+    {
+        int read_parity = this->mode == kernel_mode::fused ? this->time_step % 2 : 0;
+
+        sycl::float4 * next_vector_array = nullptr;
+        float * next_density_array = nullptr;
+
+        int host_arrays = 0;
+        if(host_copy)
+        {
+            next_vector_array = this->which_vectors_array ? this->vectors1 : this->vectors2;
+            next_density_array = this->which_vectors_array ? this->density_array_1 : this->density_array_2;
+
+            host_arrays = this->which_vectors_array ? 1 : 2;
+        }
+
+        std::optional<sycl::ext::oneapi::experimental::command_graph<sycl::ext::oneapi::experimental::graph_state::executable>> & step_graph = this->step_graphs[read_parity * 3 + host_arrays];
+        if(!step_graph)
+        {
+            step_graph = record_step(next_vector_array, next_density_array);
+        }
+
+        sycl::event replayed =
+        this->q.submit([&](sycl::handler& h)
+        {
+            h.depends_on(this->step_dependencies);
+
+            // the graph's copies overwrite the arrays the previous host task may still have public
+            if(host_copy)
+            {
+                h.depends_on(this->host_copy_published);
+            }
+
+            h.ext_oneapi_graph(*step_graph);
+        });
+
+        this->step_dependencies = {replayed};
+
+        // the same swap the recorded fused step made
+        if(this->mode == kernel_mode::fused)
+        {
+            std::swap(this->populations_1, this->populations_2);
+        }
+
+        ++this->time_step;
+
+        if(host_copy)
+        {
+            return publish_host_arrays({replayed}, next_vector_array, next_density_array);
+        }
+
+        return replayed;
+    }
+
+    /**
+     * records the kernels of one step from the current population arrays, 
+     * and the copies of its macroscopic variables to next_vector_array and next_density_array unless they're nullptr,
+     * leaves the state of the simulation as it was
+     */
+    sycl::ext::oneapi::experimental::command_graph<sycl::ext::oneapi::experimental::graph_state::executable> record_step(sycl::float4 * next_vector_array, float * next_density_array)
+    {
+        // a graph can't depend on events from outside of it, the launch waits for them instead
+        std::vector<sycl::event> dependencies;
+        std::swap(dependencies, this->step_dependencies);
+
+        sycl::ext::oneapi::experimental::command_graph graph(this->q.get_context(), this->q.get_device());
+
+        graph.begin_recording(this->q);
+
+        if(this->mode == kernel_mode::reference)
+        {
+            next_frame_reference();
+        }
+        else
+        {
+            next_frame_fused();
+
+            // recording doesn't run the step, so undo its swap
+            std::swap(this->populations_1, this->populations_2);
+        }
+
+        if(next_vector_array != nullptr)
+        {
+            submit_host_copies(next_vector_array, next_density_array, false);
+        }
+
+        graph.end_recording(this->q);
+
+        this->step_dependencies = dependencies;
+
+        return graph.finalize();
+    }
+#endif
+};
@@ -0,0 +1,29 @@
+/*
+    name: simulation_file.hpp
+
+    usecase:
+        the file format the save_to_file executables write, and the frontend reads,
+        shared by save_to_file.cpp and save_to_file_cpu.cpp, so it doesn't include sycl
+
+        the first line holds the width, height and depth, then one line per frame with every node in node order
+*/
+#pragma once
+
+#include <stdint.h> // used for the better defined types such as int8_t and int32_t
+#include <fstream> // write to files
+
+#include "simulation/lattices.hpp" // D3Q27, the lattice the file always holds
+
+// writes one node, its type, density and the populations of the 27 D3Q27 velocities
+inline void write_node_to_file(std::ofstream & file, uint8_t node_type, float density, const float * values)
+{
+    file << (int) node_type << " ";
+
+    file << int(density * 100.0f) / 100.0f << " ";
+
+    for(uint8_t j = 0; j < D3Q27::count; ++j)
+    {
+        float val = int(values[j] * 1000.0f) / 1000.0f;
+        file << val << " ";
+    }
+}
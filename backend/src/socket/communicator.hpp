@@ -53,7 +53,7 @@ template<typename T>
 class CommunicatorConnection: public Poco::Net::TCPServerConnection 
 {
     private:
-        Simulation * sim // a pointer to the simulation;
+        Simulation<> * sim // a pointer to the simulation;
         std::atomic<bool> quit; // a boolean to quit the program
         int number_of_bytes_to_send; // the length of the array in bytes
 
@@ -67,7 +67,7 @@ class CommunicatorConnection: public Poco::Net::TCPServerConnection
         char iter = 'a';
 
     public:
-    CommunicatorConnection(const Poco::Net::StreamSocket& s, Simulation * pointer_to_simulation): TCPServerConnection(s) 
+    CommunicatorConnection(const Poco::Net::StreamSocket& s, Simulation<> * pointer_to_simulation): TCPServerConnection(s) 
     {
         this->sim = pointer_to_simulation;
         
@@ -0,0 +1,188 @@
+/*
+    name: stability_report.cpp
+
+    usecase:
+        runs the cylinder case with each collision operator (see simulation/collision_operators.hpp) over a sweep of tau values,
+        and with bgk_collision plus the smagorinsky subgrid model,
+        and prints if each run stayed stable, and how far its density strayed from 1 at the end
+
+        a tau closer to 2 is a lower viscosity, so a higher reynolds number on the same grid,
+        the highest tau an operator stays stable at is how coarse a grid it can run a given flow on,
+        the reynolds number is found from the diameter of the cylinder and the speed of sound (the speed the macroscopic velocity is clamped to)
+        the viscosity of the smagorinsky runs is the one tau sets, the subgrid model adds its eddy viscosity on top where the flow is turbulent
+*/
+#include "simulation/simulation_class.hpp"
+
+#include <string>
+#include <iostream>
+#include <iomanip> // std::setw, for the table
+#include <vector>
+#include <cmath>
+#include <cstdlib> // srand
+
+////////////
+//  SYCL  //
+////////////
+#include<sycl/sycl.hpp>
+
+
+// how one run ended
+struct run_result
+{
+    int diverged_frame; // the frame the run blew up at, 0 if it didn't
+    float max_density_error; // the largest |density - 1| at the end of a stable run
+};
+
+// the smagorinsky constant of the last column
+const float smagorinsky_constant = 0.15f;
+
+// a run counts as diverged once a density is no longer a number or is this far from 1
+const float diverged_density_error = 100.0f;
+
+template <typename collision>
+run_result run(int number_of_frames, int width, int height, int depth, float tau, float cylinder_radius, float smagorinsky_constant = 0.0f)
+{
+    // every run starts from the same random noise
+    srand(0);
+
+    //                                                                 unused   unused    unused          unused
+    //                                              width, height, depth, density, visocity, speed_of_sound, node_size, cyc_radius, tau
+    Simulation<D3Q27, aos_layout, fp32_storage, collision> sim(width, height, depth, 1.225f, 0.00001f, 343, 0.02f, cylinder_radius, tau);
+    sim.set_smagorinsky_constant(smagorinsky_constant);
+
+    // the density is only looked at every 10 frames, and after the last one
+    sim.set_macroscopic_variables_interval(10);
+
+    run_result result = {0, 0.0f};
+
+    for(int frame = 1; frame <= number_of_frames; ++frame)
+    {
+        if(frame == number_of_frames)
+        {
+            sim.request_macroscopic_variables();
+        }
+
+        sim.next_frame();
+
+        if(frame % 10 != 0 && frame != number_of_frames)
+        {
+            continue;
+        }
+
+        float * density_array = sim.density_array.load();
+
+        result.max_density_error = 0.0f;
+        for(int i = 0; i < sim.get_node_count(); ++i)
+        {
+            float density_error = std::fabs(density_array[i] - 1.0f);
+
+            if(!std::isfinite(density_error) || density_error > diverged_density_error)
+            {
+                result.diverged_frame = frame;
+                return result;
+            }
+
+            result.max_density_error = std::max(result.max_density_error, density_error);
+        }
+    }
+
+    return result;
+}
+
+// prints one cell of the table
+void report(run_result result)
+{
+    if(result.diverged_frame > 0)
+    {
+        std::cout << std::setw(18) << ("diverged @ " + std::to_string(result.diverged_frame));
+    }
+    else
+    {
+        std::cout << std::setw(18) << result.max_density_error;
+    }
+}
+
+// the kinematic viscosity of a tau value in lattice units, c_s^2 * (1 / tau - 1 / 2)
+float viscosity(float tau)
+{
+    return (1.0f / tau - 0.5f) / 3.0f;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc != 1 && argc != 6)
+    {
+        std::cout << "usage: " << argv[0] << " [number_of_frames_to_compute sim_width sim_height sim_depth cylinder_radius]" << std::endl;
+        return 0;
+    }
+
+    int number_of_frames  = argc == 6 ? std::stoi(argv[1]) : 400;
+    int width             = argc == 6 ? std::stoi(argv[2]) : 16;
+    int height            = argc == 6 ? std::stoi(argv[3]) : 4;
+    int depth             = argc == 6 ? std::stoi(argv[4]) : 48;
+    float cylinder_radius = argc == 6 ? std::stof(argv[5]) : 3.0f;
+
+    std::cout << "cylinder case: " << width << " x " << height << " x " << depth << ", radius " << cylinder_radius << ", " << number_of_frames << " frames\n\n";
+
+    const std::vector<float> tau_values = {1.0f, 1.2f, 1.4f, 1.6f, 1.7f, 1.8f, 1.9f, 1.95f, 1.98f, 1.99f};
+
+    // the highest stable tau of each operator, in the order of the table
+    float highest_stable_tau[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    bool stable_so_far[4] = {true, true, true, true};
+
+    std::cout << std::setw(8) << "tau"
+              << std::setw(12) << "viscosity"
+              << std::setw(18) << "bgk max |rho-1|"
+              << std::setw(18) << "regularized"
+              << std::setw(18) << "mrt"
+              << std::setw(18) << "bgk smagorinsky" << "\n";
+
+    for(float tau : tau_values)
+    {
+        run_result results[4] = {
+            run<bgk_collision>(number_of_frames, width, height, depth, tau, cylinder_radius),
+            run<regularized_collision>(number_of_frames, width, height, depth, tau, cylinder_radius),
+            run<mrt_collision>(number_of_frames, width, height, depth, tau, cylinder_radius),
+            run<bgk_collision>(number_of_frames, width, height, depth, tau, cylinder_radius, smagorinsky_constant),
+        };
+
+        std::cout << std::setw(8) << tau << std::setw(12) << viscosity(tau);
+        for(int j = 0; j < 4; ++j)
+        {
+            report(results[j]);
+
+            // the envelope ends at the first tau an operator diverges at
+            stable_so_far[j] = stable_so_far[j] && results[j].diverged_frame == 0;
+            if(stable_so_far[j])
+            {
+                highest_stable_tau[j] = tau;
+            }
+        }
+        std::cout << "\n";
+    }
+
+    const std::string names[4] = {"bgk", "regularized", "mrt", "smagorinsky"};
+
+    std::cout << "\n" << std::setw(12) << "operator"
+              << std::setw(20) << "highest stable tau"
+              << std::setw(12) << "viscosity"
+              << std::setw(16) << "reynolds" << "\n";
+
+    for(int j = 0; j < 4; ++j)
+    {
+        std::cout << std::setw(12) << names[j];
+        if(highest_stable_tau[j] == 0.0f)
+        {
+            std::cout << std::setw(20) << "none" << "\n";
+            continue;
+        }
+
+        float reynolds = (1.0f / std::sqrt(3.0f)) * 2.0f * cylinder_radius / viscosity(highest_stable_tau[j]);
+
+        std::cout << std::setw(20) << highest_stable_tau[j]
+                  << std::setw(12) << viscosity(highest_stable_tau[j])
+                  << std::setw(16) << reynolds << "\n";
+    }
+
+    return 0;
+}
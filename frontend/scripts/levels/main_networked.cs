@@ -44,7 +44,7 @@ public class NetworkedSimulation : ILevel
     {
         Console.WriteLine("Starting network data messengers");
 
-        // velocity
+        // velocity, 16 bytes per node, the last 4 are the density of the node which the density messenger sends as well
         velocity_messenger = new Messenger<Vector3>(4000, 
         arr => {
             Vector3[] temp = new Vector3[arr.Length/16];